@@ -20,6 +20,7 @@
  */
 
 #include "gstomx.h"
+#include "gstomx_trace.h"
 #include "gstomx_dummy.h"
 #include "gstomx_mpeg4dec.h"
 #include "gstomx_h263dec.h"
@@ -125,6 +126,7 @@ plugin_init (GstPlugin *plugin)
     component_role_quark = g_quark_from_static_string ("component-role");
 
     g_omx_init ();
+    g_omx_trace_init ();
 
     {
         guint i;
@@ -147,6 +149,25 @@ plugin_init (GstPlugin *plugin)
         }
     }
 
+    /* optionally get the OMX libraries ready before the first element needs
+     * them:
+     */
+    if (g_getenv ("OMX_PRELOAD"))
+    {
+        GList *library_names = NULL;
+        guint i;
+
+        for (i = 0; element_table[i].name; i++)
+        {
+            const gchar *library_name = element_table[i].library_name;
+
+            if (!g_list_find_custom (library_names, library_name, (GCompareFunc) strcmp))
+                library_names = g_list_append (library_names, (gpointer) library_name);
+        }
+
+        g_omx_preload (library_names);
+    }
+
     return TRUE;
 }
 
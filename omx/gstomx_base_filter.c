@@ -32,6 +32,11 @@ enum
     ARG_USE_TIMESTAMPS,
     ARG_NUM_INPUT_BUFFERS,
     ARG_NUM_OUTPUT_BUFFERS,
+    ARG_COALESCE_LATENCY,
+    ARG_STATE_TIMEOUT,
+    ARG_PRIORITY,
+    ARG_STATS,
+    ARG_AUTO_BUFFERS,
 };
 
 static void init_interfaces (GType type);
@@ -41,6 +46,13 @@ GSTOMX_BOILERPLATE_FULL (GstOmxBaseFilter, gst_omx_base_filter, GstElement, GST_
 static GstFlowReturn push_buffer (GstOmxBaseFilter *self, GstBuffer *buf);
 static GstFlowReturn pad_chain (GstPad *pad, GstBuffer *buf);
 static gboolean pad_event (GstPad *pad, GstEvent *event);
+static gboolean src_query (GstPad *pad, GstQuery *query);
+static void reset_latency (GstOmxBaseFilter *self);
+static void apply_cached_buffers (GstOmxBaseFilter *self);
+static void tune_buffers (GstOmxBaseFilter *self, GOmxPort *port, GstOmxBufferTuning *tuning);
+static void stop_coalescing (GstOmxBaseFilter *self);
+static void join_prepare (GstOmxBaseFilter *self);
+static GstFlowReturn pad_buffer_alloc (GstPad *pad, guint64 offset, guint size, GstCaps *caps, GstBuffer **buf);
 
 
 static void
@@ -52,13 +64,11 @@ setup_ports (GstOmxBaseFilter *self)
 
     G_OMX_PORT_GET_DEFINITION (self->in_port, &param);
     g_omx_port_setup (self->in_port, &param);
-    gst_pad_set_element_private (self->sinkpad, self->in_port);
 
     /* Output port configuration. */
 
     G_OMX_PORT_GET_DEFINITION (self->out_port, &param);
     g_omx_port_setup (self->out_port, &param);
-    gst_pad_set_element_private (self->srcpad, self->out_port);
 
     if (g_getenv ("OMX_ALLOCATE_ON"))
     {
@@ -81,6 +91,19 @@ setup_ports (GstOmxBaseFilter *self)
         self->out_port->share_buffer = FALSE;
     }
 
+    if (!self->out_port->share_buffer && g_getenv ("OMX_ZERO_COPY_OUT_ON"))
+    {
+        GST_DEBUG_OBJECT (self, "OMX_ZERO_COPY_OUT_ON");
+        self->out_port->defer_release = TRUE;
+    }
+
+    if (!self->in_port->share_buffer && g_getenv ("OMX_ZERO_COPY_IN_ON"))
+    {
+        GST_DEBUG_OBJECT (self, "OMX_ZERO_COPY_IN_ON");
+        self->in_port->export_buffers = TRUE;
+        gst_pad_set_bufferalloc_function (self->sinkpad, pad_buffer_alloc);
+    }
+
     GST_DEBUG_OBJECT (self, "in_port->omx_allocate=%d, out_port->omx_allocate=%d",
             self->in_port->omx_allocate, self->out_port->omx_allocate);
     GST_DEBUG_OBJECT (self, "in_port->share_buffer=%d, out_port->share_buffer=%d",
@@ -94,6 +117,7 @@ change_state (GstElement *element,
     GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
     GstOmxBaseFilter *self;
     GOmxCore *core;
+    gboolean prepared;
 
     self = GST_OMX_BASE_FILTER (element);
     core = self->gomx;
@@ -134,20 +158,37 @@ change_state (GstElement *element,
             g_mutex_unlock (self->ready_lock);
             break;
         case GST_STATE_CHANGE_PAUSED_TO_READY:
+            /* the pads are inactive by now, so a preparation still running
+             * only has the resources left to wait for: */
+            join_prepare (self);
             g_mutex_lock (self->ready_lock);
-            if (self->ready)
+            /* the component may be on its way to Idle already, see
+             * sink_caps_notify(): */
+            prepared = self->ready || self->in_port->tunnel ||
+                       core->omx_state != OMX_StateLoaded ||
+                       core->pending_state == OMX_StateIdle;
+            if (prepared)
             {
                 /* unlock */
                 g_omx_port_finish (self->in_port);
                 g_omx_port_finish (self->out_port);
-
+            }
+            /* before the buffers it may be sending to go away: */
+            stop_coalescing (self);
+            if (prepared)
+            {
                 g_omx_core_stop (core);
                 g_omx_core_unload (core);
                 self->ready = FALSE;
             }
+            reset_latency (self);
+            memset (&self->in_tuning, 0, sizeof (self->in_tuning));
+            memset (&self->out_tuning, 0, sizeof (self->out_tuning));
             g_mutex_unlock (self->ready_lock);
+            /* unless a tunnel peer has yet to unload, see g_omx_core_unload() */
             if (core->omx_state != OMX_StateLoaded &&
-                core->omx_state != OMX_StateInvalid)
+                core->omx_state != OMX_StateInvalid &&
+                core->pending_state != OMX_StateLoaded)
             {
                 ret = GST_STATE_CHANGE_FAILURE;
                 goto leave;
@@ -178,6 +219,9 @@ change_state (GstElement *element,
             self->out_port->share_buffer = out_share;
             self->out_port->buffer_alloc = out_alloc;
 
+            gst_pad_set_element_private (self->sinkpad, self->in_port);
+            gst_pad_set_element_private (self->srcpad, self->out_port);
+
             break;
         }
 
@@ -204,6 +248,8 @@ finalize (GObject *obj)
         self->codec_data = NULL;
     }
 
+    join_prepare (self);
+
     g_omx_core_free (self->gomx);
 
     g_free (self->omx_role);
@@ -212,6 +258,10 @@ finalize (GObject *obj)
 
     g_mutex_free (self->ready_lock);
 
+    g_object_unref (self->adapter);
+    g_cond_free (self->coalesce_cond);
+    g_mutex_free (self->coalesce_lock);
+
     G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
 
@@ -258,6 +308,18 @@ set_property (GObject *obj,
                 G_OMX_PORT_SET_DEFINITION (port, &param);
             }
             break;
+        case ARG_COALESCE_LATENCY:
+            self->coalesce_latency = g_value_get_uint64 (value);
+            break;
+        case ARG_STATE_TIMEOUT:
+            self->gomx->state_timeout = g_value_get_uint (value);
+            break;
+        case ARG_PRIORITY:
+            self->gomx->priority = g_value_get_int (value);
+            break;
+        case ARG_AUTO_BUFFERS:
+            self->auto_buffers = g_value_get_boolean (value);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
             break;
@@ -300,6 +362,21 @@ get_property (GObject *obj,
                 g_value_set_uint (value, param.nBufferCountActual);
             }
             break;
+        case ARG_COALESCE_LATENCY:
+            g_value_set_uint64 (value, self->coalesce_latency);
+            break;
+        case ARG_STATE_TIMEOUT:
+            g_value_set_uint (value, self->gomx->state_timeout);
+            break;
+        case ARG_PRIORITY:
+            g_value_set_int (value, self->gomx->priority);
+            break;
+        case ARG_STATS:
+            g_value_take_boxed (value, g_omx_core_get_stats (self->gomx));
+            break;
+        case ARG_AUTO_BUFFERS:
+            g_value_set_boolean (value, self->auto_buffers);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
             break;
@@ -328,6 +405,7 @@ type_class_init (gpointer g_class,
     bclass->push_buffer = push_buffer;
     bclass->pad_chain = pad_chain;
     bclass->pad_event = pad_event;
+    bclass->src_query = src_query;
 
     /* Properties stuff */
     {
@@ -355,18 +433,360 @@ type_class_init (gpointer g_class,
                                                                TRUE, G_PARAM_READWRITE));
 
         /* note: the default values for these are just a guess.. since we wouldn't know
-         * until the OMX component is constructed.  But that is ok, these properties are
-         * only for debugging
+         * until the OMX component is constructed.  Rather than setting these by hand,
+         * auto-buffers can find them.  The max is the same G_OMX_PORT_MAX_BUFFERS
+         * auto-buffers stops at, see g_omx_port_set_num_buffers().
          */
         g_object_class_install_property (gobject_class, ARG_NUM_INPUT_BUFFERS,
                                          g_param_spec_uint ("input-buffers", "Input buffers",
                                                             "The number of OMX input buffers",
-                                                            1, 10, 4, G_PARAM_READWRITE));
+                                                            1, G_OMX_PORT_MAX_BUFFERS, 4, G_PARAM_READWRITE));
         g_object_class_install_property (gobject_class, ARG_NUM_OUTPUT_BUFFERS,
                                          g_param_spec_uint ("output-buffers", "Output buffers",
                                                             "The number of OMX output buffers",
-                                                            1, 10, 4, G_PARAM_READWRITE));
+                                                            1, G_OMX_PORT_MAX_BUFFERS, 4, G_PARAM_READWRITE));
+
+        g_object_class_install_property (gobject_class, ARG_COALESCE_LATENCY,
+                                         g_param_spec_uint64 ("coalesce-latency", "Coalesce latency",
+                                                              "Pack consecutive small input buffers spanning up to this "
+                                                              "much time (in ns) into one OMX buffer, 0 to disable",
+                                                              0, G_MAXUINT64, 0, G_PARAM_READWRITE));
+
+        g_object_class_install_property (gobject_class, ARG_STATE_TIMEOUT,
+                                         g_param_spec_uint ("state-timeout", "State timeout",
+                                                            "How long to wait for the OMX component to change state (in ms)",
+                                                            1, G_MAXUINT, G_OMX_CORE_DEFAULT_STATE_TIMEOUT,
+                                                            G_PARAM_READWRITE));
+
+        g_object_class_install_property (gobject_class, ARG_PRIORITY,
+                                         g_param_spec_int ("priority", "Priority",
+                                                           "Priority for getting hardware resources when they are "
+                                                           "scarce (see OMX_RESOURCE_CAPACITY), higher goes first",
+                                                           G_MININT, G_MAXINT, 0, G_PARAM_READWRITE));
+
+        g_object_class_install_property (gobject_class, ARG_STATS,
+                                         g_param_spec_boxed ("stats", "Statistics",
+                                                             "Counters of the OMX ports",
+                                                             GST_TYPE_STRUCTURE, G_PARAM_READABLE));
+
+        g_object_class_install_property (gobject_class, ARG_AUTO_BUFFERS,
+                                         g_param_spec_boolean ("auto-buffers", "Auto buffers",
+                                                               "Tune the number of input and output buffers while "
+                                                               "streaming, and remember it for the next run "
+                                                               "(see OMX_BUFFER_CACHE)",
+                                                               FALSE, G_PARAM_READWRITE));
+    }
+}
+
+/* NOTE ABOUT AUTO BUFFERS:
+ *
+ * How many buffers a port needs depends on the component, the stream and
+ * the rest of the pipeline, so with auto-buffers on, we measure it for the
+ * first seconds of streaming.  The input port counts the time spent
+ * waiting for a free buffer.  Waiting for a filled output buffer only
+ * means the component (or its input) is the bottleneck, which more output
+ * buffers don't help with, so the output port rather counts how often
+ * downstream holds all the buffers it may (see can_defer_release() in
+ * gstomx_port.c).  A port starved 10% of the time or more gets two more
+ * buffers, and a port never starved gets one less, within what the
+ * component allows and G_OMX_PORT_MAX_BUFFERS.  The result is kept in the
+ * buffer cache (see gstomx_util.c), and once there, it is used as is
+ * rather than tuned again, so it does not creep up run after run.
+ */
+
+#define AUTO_BUFFERS_WINDOW (3 * G_USEC_PER_SEC)
+
+static gchar *
+buffer_cache_key (GstOmxBaseFilter *self)
+{
+    OMX_PARAM_PORTDEFINITIONTYPE param;
+
+    G_OMX_PORT_GET_DEFINITION (self->in_port, &param);
+
+    if (param.eDomain != OMX_PortDomainVideo)
+        return g_strdup (self->omx_component);
+
+    return g_strdup_printf ("%s %lux%lu", self->omx_component,
+                            param.format.video.nFrameWidth,
+                            param.format.video.nFrameHeight);
+}
+
+static void
+apply_cached_buffers (GstOmxBaseFilter *self)
+{
+    guint num_input, num_output;
+    gchar *key;
+
+    key = buffer_cache_key (self);
+
+    if (g_omx_buffer_cache_lookup (key, &num_input, &num_output))
+    {
+        GST_INFO_OBJECT (self, "%s: %u input, %u output buffers", key,
+                         num_input, num_output);
+        g_omx_port_set_num_buffers (self->in_port, num_input);
+        g_omx_port_set_num_buffers (self->out_port, num_output);
+
+        /* already tuned: */
+        self->in_tuning.done = TRUE;
+        self->out_tuning.done = TRUE;
+    }
+
+    g_free (key);
+}
+
+static void
+tune_buffers (GstOmxBaseFilter *self,
+              GOmxPort *port,
+              GstOmxBufferTuning *tuning)
+{
+    guint64 now, starved;
+    guint num_buffers;
+    gchar *key;
+
+    if (G_LIKELY (!self->auto_buffers || tuning->done))
+        return;
+
+    now = g_omx_ppm_now ();
+
+    if (!tuning->start)
+    {
+        tuning->start = now;
+        tuning->blocked = g_omx_port_get_blocked (port);
+        return;
+    }
+
+    if (port->type == GOMX_PORT_OUTPUT)
+    {
+        tuning->samples++;
+        if ((port->defer_release || g_atomic_int_get (&port->n_importers)) &&
+            g_atomic_int_get (&port->n_held) >= (gint) port->num_buffers - 1)
+            tuning->held_full++;
+    }
+
+    if (now - tuning->start < AUTO_BUFFERS_WINDOW)
+        return;
+
+    tuning->done = TRUE;
+
+    /* in percents of the time (or of the buffers): */
+    if (port->type == GOMX_PORT_OUTPUT)
+        starved = (guint64) tuning->held_full * 100 / MAX (tuning->samples, 1);
+    else
+        starved = (g_omx_port_get_blocked (port) - tuning->blocked) * 100 / (now - tuning->start);
+
+    num_buffers = port->num_buffers;
+    if (starved >= 10)
+        num_buffers += 2;
+    else if (starved == 0 && num_buffers > 1)
+        num_buffers--;
+
+    GST_INFO_OBJECT (self, "%s: starved %" G_GUINT64_FORMAT "%% of the time, "
+                     "%u -> %u buffers", port->name, starved,
+                     port->num_buffers, num_buffers);
+
+    g_omx_port_set_num_buffers (port, num_buffers);
+
+    key = buffer_cache_key (self);
+    g_omx_buffer_cache_store (key, self->in_port->num_buffers,
+                              self->out_port->num_buffers);
+    g_free (key);
+}
+
+/* NOTE ABOUT LATENCY:
+ *
+ * The component holds on to some buffers before producing output (frame
+ * reordering, lookahead in encoders, etc), and how many depends on the
+ * component and the stream, so rather than guessing it from the port
+ * definitions we measure it: the time at which each input timestamp went
+ * in is remembered, and the delay until a buffer with the same timestamp
+ * comes out is averaged.  Until there is a measurement, the buffers the
+ * component currently holds times the nominal duration is used.  When
+ * the measurement moves by more than a quarter (and more than a frame),
+ * a latency message is posted so that the pipeline re-queries it.
+ */
+
+static void
+clear_latency_samples (GstOmxBaseFilter *self)
+{
+    guint i;
+
+    GST_OBJECT_LOCK (self);
+    for (i = 0; i < GST_OMX_BASE_FILTER_LATENCY_SAMPLES; i++)
+        self->sample_ts[i] = GST_CLOCK_TIME_NONE;
+    GST_OBJECT_UNLOCK (self);
+}
+
+static void
+reset_latency (GstOmxBaseFilter *self)
+{
+    clear_latency_samples (self);
+
+    GST_OBJECT_LOCK (self);
+    self->latency = GST_CLOCK_TIME_NONE;
+    self->reported_latency = GST_CLOCK_TIME_NONE;
+    GST_OBJECT_UNLOCK (self);
+}
+
+static void
+latency_sample_in (GstOmxBaseFilter *self,
+                   GstClockTime ts)
+{
+    if (!GST_CLOCK_TIME_IS_VALID (ts))
+        return;
+
+    GST_OBJECT_LOCK (self);
+    self->sample_ts[self->sample_pos] = ts;
+    self->sample_time[self->sample_pos] = g_omx_ppm_now ();
+    self->sample_pos = (self->sample_pos + 1) % GST_OMX_BASE_FILTER_LATENCY_SAMPLES;
+    GST_OBJECT_UNLOCK (self);
+}
+
+static void
+latency_sample_out (GstOmxBaseFilter *self,
+                    GstClockTime ts)
+{
+    GstClockTime delay = GST_CLOCK_TIME_NONE;
+    GstClockTime diff, threshold;
+    gboolean post = FALSE;
+    guint i;
+
+    if (!GST_CLOCK_TIME_IS_VALID (ts))
+        return;
+
+    GST_OBJECT_LOCK (self);
+
+    for (i = 0; i < GST_OMX_BASE_FILTER_LATENCY_SAMPLES; i++)
+    {
+        if (self->sample_ts[i] == ts)
+        {
+            delay = (g_omx_ppm_now () - self->sample_time[i]) * GST_USECOND;
+            self->sample_ts[i] = GST_CLOCK_TIME_NONE;
+            break;
+        }
+    }
+
+    if (!GST_CLOCK_TIME_IS_VALID (delay))
+    {
+        GST_OBJECT_UNLOCK (self);
+        return;
+    }
+
+    if (GST_CLOCK_TIME_IS_VALID (self->latency))
+        self->latency = (7 * self->latency + delay) / 8;
+    else
+        self->latency = delay;
+
+    if (GST_CLOCK_TIME_IS_VALID (self->reported_latency))
+    {
+        diff = self->latency > self->reported_latency ?
+                self->latency - self->reported_latency :
+                self->reported_latency - self->latency;
+        threshold = MAX (self->reported_latency / 4,
+                         GST_CLOCK_TIME_IS_VALID (self->duration) ?
+                         self->duration : GST_MSECOND);
+        post = (diff > threshold);
+    }
+    else
+    {
+        post = TRUE;
+    }
+
+    if (post)
+        self->reported_latency = self->latency;
+
+    GST_OBJECT_UNLOCK (self);
+
+    if (post)
+    {
+        GST_INFO_OBJECT (self, "latency now %" GST_TIME_FORMAT,
+                         GST_TIME_ARGS (self->latency));
+        gst_element_post_message (GST_ELEMENT (self),
+                                  gst_message_new_latency (GST_OBJECT (self)));
+    }
+}
+
+/**
+ * Our own contribution to the latency of the pipeline.
+ */
+static void
+get_latency (GstOmxBaseFilter *self,
+             GstClockTime *min,
+             GstClockTime *max)
+{
+    GOmxPort *in_port = self->in_port;
+    GOmxPort *out_port = self->out_port;
+    GstClockTime duration;
+    gint depth;
+
+    GST_OBJECT_LOCK (self);
+    *min = self->latency;
+    duration = self->duration;
+    GST_OBJECT_UNLOCK (self);
+
+    depth = g_atomic_int_get (&in_port->stats.etb) -
+            g_atomic_int_get (&in_port->stats.ebd);
+
+    if (!GST_CLOCK_TIME_IS_VALID (duration))
+    {
+        if (!GST_CLOCK_TIME_IS_VALID (*min))
+            *min = 0;
+        *max = GST_CLOCK_TIME_NONE;
+        return;
     }
+
+    if (!GST_CLOCK_TIME_IS_VALID (*min))
+        *min = MAX (depth, 0) * duration;
+
+    /* at worst, every buffer of both ports holds a frame: */
+    *max = MAX ((in_port->num_buffers + out_port->num_buffers) * duration, *min);
+}
+
+static gboolean
+src_query (GstPad *pad,
+           GstQuery *query)
+{
+    GstOmxBaseFilter *self;
+    gboolean ret;
+
+    self = GST_OMX_BASE_FILTER (GST_PAD_PARENT (pad));
+
+    switch (GST_QUERY_TYPE (query))
+    {
+        case GST_QUERY_LATENCY:
+        {
+            gboolean live;
+            GstClockTime min, max, our_min, our_max;
+
+            ret = gst_pad_peer_query (self->sinkpad, query);
+            if (!ret)
+                break;
+
+            gst_query_parse_latency (query, &live, &min, &max);
+            get_latency (self, &our_min, &our_max);
+
+            GST_DEBUG_OBJECT (self, "our latency: min %" GST_TIME_FORMAT
+                              ", max %" GST_TIME_FORMAT,
+                              GST_TIME_ARGS (our_min), GST_TIME_ARGS (our_max));
+
+            min += our_min;
+            if (GST_CLOCK_TIME_IS_VALID (max))
+            {
+                if (GST_CLOCK_TIME_IS_VALID (our_max))
+                    max += our_max;
+                else
+                    max = GST_CLOCK_TIME_NONE;
+            }
+
+            gst_query_set_latency (query, live, min, max);
+            break;
+        }
+
+        default:
+            ret = gst_pad_query_default (pad, query);
+            break;
+    }
+
+    return ret;
 }
 
 static GstFlowReturn
@@ -413,9 +833,22 @@ output_loop (gpointer data)
 
     out_port = self->out_port;
 
+    /* the component passes the buffers to the peer itself: */
+    if (G_UNLIKELY (out_port->tunnel))
+    {
+        GST_DEBUG_OBJECT (self, "tunneled, nothing to push");
+        gst_pad_pause_task (self->srcpad);
+        gst_object_unref (self);
+        return;
+    }
+
     if (G_LIKELY (out_port->enabled))
     {
-        gpointer obj = g_omx_port_recv (out_port);
+        gpointer obj;
+
+        tune_buffers (self, out_port, &self->out_tuning);
+
+        obj = g_omx_port_recv (out_port);
 
         if (G_UNLIKELY (!obj))
         {
@@ -447,6 +880,13 @@ output_loop (gpointer data)
             else
             {
                 GstBuffer *buf = GST_BUFFER (obj);
+
+                /* zero-copy buffers don't come from pad_alloc */
+                if (G_UNLIKELY (!GST_BUFFER_CAPS (buf)))
+                    gst_buffer_set_caps (buf, GST_PAD_CAPS (self->srcpad));
+
+                latency_sample_out (self, GST_BUFFER_TIMESTAMP (buf));
+
                 ret = bclass->push_buffer (self, buf);
                 GST_DEBUG_OBJECT (self, "ret=%s", gst_flow_get_name (ret));
             }
@@ -483,6 +923,532 @@ leave:
     gst_object_unref (self);
 }
 
+/**
+ * Send @buf to the OMX component, split over several OMX buffers if needed.
+ * Takes ownership of @buf.  Returns FALSE if the buffer could not be sent,
+ * setting @ret if that is an error.
+ */
+static gboolean
+send_buffer (GstOmxBaseFilter *self,
+             GstBuffer *buf,
+             GstFlowReturn *ret)
+{
+    GOmxCore *gomx = self->gomx;
+
+    while (TRUE)
+    {
+        gint sent;
+
+        if (self->last_pad_push_return != GST_FLOW_OK ||
+            !(gomx->omx_state == OMX_StateExecuting ||
+              gomx->omx_state == OMX_StatePause))
+        {
+            GST_DEBUG_OBJECT (self, "last_pad_push_return=%d", self->last_pad_push_return);
+            gst_buffer_unref (buf);
+            return FALSE;
+        }
+
+        sent = g_omx_port_send (self->in_port, buf);
+
+        if (G_UNLIKELY (sent < 0))
+        {
+            *ret = GST_FLOW_WRONG_STATE;
+            gst_buffer_unref (buf);
+            return FALSE;
+        }
+        else if (sent < GST_BUFFER_SIZE (buf))
+        {
+            GstBuffer *subbuf = gst_buffer_create_sub (buf, sent,
+                    GST_BUFFER_SIZE (buf) - sent);
+            gst_buffer_unref (buf);
+            buf = subbuf;
+        }
+        else
+        {
+            gst_buffer_unref (buf);
+            break;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * Take whatever is pending in the coalescing adapter as one buffer, NULL if
+ * nothing is.  Called with coalesce_lock.
+ */
+static GstBuffer *
+take_coalesced (GstOmxBaseFilter *self)
+{
+    guint avail = gst_adapter_available (self->adapter);
+    GstBuffer *buf;
+
+    if (avail == 0)
+        return NULL;
+
+    buf = gst_adapter_take_buffer (self->adapter, avail);
+    buf = gst_buffer_make_metadata_writable (buf);
+    GST_BUFFER_TIMESTAMP (buf) = self->coalesce_ts;
+    GST_BUFFER_DURATION (buf) = GST_CLOCK_TIME_NONE;
+
+    GST_LOG_OBJECT (self, "sending %u coalesced bytes", avail);
+
+    return buf;
+}
+
+/**
+ * Wait for coalesce_loop() to be done sending, so that the chain function
+ * doesn't get ahead of it.  Called with coalesce_lock.
+ */
+static void
+wait_coalesce_sent (GstOmxBaseFilter *self)
+{
+    while (self->coalesce_sending)
+        g_cond_wait (self->coalesce_cond, self->coalesce_lock);
+}
+
+/**
+ * Send whatever is pending in the coalescing adapter as one buffer, from
+ * the chain function.  Called with coalesce_lock.
+ */
+static gboolean
+send_coalesced (GstOmxBaseFilter *self,
+                GstFlowReturn *ret)
+{
+    GstBuffer *buf;
+
+    wait_coalesce_sent (self);
+
+    buf = take_coalesced (self);
+    if (!buf)
+        return TRUE;
+
+    return send_buffer (self, buf, ret);
+}
+
+/**
+ * coalesce_loop() couldn't send the pending data: make sure the chain
+ * function stops, and tell why if there is no flush or shutdown to
+ * explain it, same as pad_chain() does.
+ */
+static void
+coalesce_failed (GstOmxBaseFilter *self,
+                 GstFlowReturn ret)
+{
+    GOmxCore *gomx = self->gomx;
+
+    if (gomx->omx_error)
+    {
+        GST_ELEMENT_ERROR (self, STREAM, FAILED, (NULL),
+                           ("Error from OpenMAX component"));
+        ret = GST_FLOW_ERROR;
+    }
+    else if (gomx->omx_state != OMX_StateExecuting &&
+             gomx->omx_state != OMX_StatePause)
+    {
+        GST_ELEMENT_ERROR (self, STREAM, FAILED, (NULL),
+                           ("OpenMAX component in wrong state"));
+        ret = GST_FLOW_ERROR;
+    }
+
+    if (ret != GST_FLOW_OK)
+        self->last_pad_push_return = ret;
+}
+
+/**
+ * Send the pending data once it has waited for coalesce-latency, in case
+ * the next buffer is late (or never comes).
+ *
+ * g_omx_port_send() blocks until an input buffer is free, so that is done
+ * without coalesce_lock: the chain function can keep coalescing meanwhile,
+ * and only waits if it has something to send itself.
+ */
+static gpointer
+coalesce_loop (gpointer data)
+{
+    GstOmxBaseFilter *self = data;
+
+    g_mutex_lock (self->coalesce_lock);
+
+    while (self->coalesce_running)
+    {
+        GTimeVal now;
+        GstBuffer *buf;
+        GstFlowReturn ret;
+
+        if (gst_adapter_available (self->adapter) == 0)
+        {
+            g_cond_wait (self->coalesce_cond, self->coalesce_lock);
+            continue;
+        }
+
+        g_get_current_time (&now);
+        if ((now.tv_sec - self->coalesce_deadline.tv_sec) * G_USEC_PER_SEC +
+            (now.tv_usec - self->coalesce_deadline.tv_usec) < 0)
+        {
+            g_cond_timed_wait (self->coalesce_cond, self->coalesce_lock,
+                               &self->coalesce_deadline);
+            continue;
+        }
+
+        GST_LOG_OBJECT (self, "coalesce-latency expired");
+        buf = take_coalesced (self);
+        self->coalesce_sending = TRUE;
+        g_mutex_unlock (self->coalesce_lock);
+
+        ret = GST_FLOW_OK;
+        if (!send_buffer (self, buf, &ret))
+            coalesce_failed (self, ret);
+
+        g_mutex_lock (self->coalesce_lock);
+        self->coalesce_sending = FALSE;
+        g_cond_broadcast (self->coalesce_cond);
+    }
+
+    g_mutex_unlock (self->coalesce_lock);
+
+    return NULL;
+}
+
+static void
+stop_coalescing (GstOmxBaseFilter *self)
+{
+    GThread *thread;
+
+    g_mutex_lock (self->coalesce_lock);
+    self->coalesce_running = FALSE;
+    g_cond_broadcast (self->coalesce_cond);
+    thread = self->coalesce_thread;
+    self->coalesce_thread = NULL;
+    g_mutex_unlock (self->coalesce_lock);
+
+    if (thread)
+        g_thread_join (thread);
+
+    gst_adapter_clear (self->adapter);
+}
+
+/**
+ * Voice codecs get lots of tiny buffers.. rather than one ETB/EBD round
+ * trip per buffer, pack consecutive buffers into one OMX buffer, as long as
+ * they fit and don't span more than coalesce-latency, neither in timestamps
+ * nor in the time they wait here.  Takes ownership of @buf.  Called with
+ * coalesce_lock.
+ */
+static gboolean
+coalesce_buffer (GstOmxBaseFilter *self,
+                 GstBuffer *buf,
+                 GstFlowReturn *ret)
+{
+    GOmxPort *in_port = self->in_port;
+    GstClockTime ts = GST_BUFFER_TIMESTAMP (buf);
+    guint max_size;
+    guint avail;
+
+    max_size = in_port->buffers[0]->nAllocLen;
+    avail = gst_adapter_available (self->adapter);
+
+    if (avail > 0)
+    {
+        gboolean flush = FALSE;
+
+        if (avail + GST_BUFFER_SIZE (buf) > max_size)
+            flush = TRUE;
+        else if (GST_BUFFER_IS_DISCONT (buf))
+            flush = TRUE;
+        else if (GST_CLOCK_TIME_IS_VALID (ts) &&
+                 GST_CLOCK_TIME_IS_VALID (self->coalesce_ts) &&
+                 ts >= self->coalesce_ts + self->coalesce_latency)
+            flush = TRUE;
+
+        if (flush && !send_coalesced (self, ret))
+        {
+            gst_buffer_unref (buf);
+            return FALSE;
+        }
+    }
+
+    if (GST_BUFFER_SIZE (buf) >= max_size)
+    {
+        wait_coalesce_sent (self);
+        return send_buffer (self, buf, ret);
+    }
+
+    if (gst_adapter_available (self->adapter) == 0)
+    {
+        self->coalesce_ts = ts;
+        g_get_current_time (&self->coalesce_deadline);
+        g_time_val_add (&self->coalesce_deadline,
+                        self->coalesce_latency / GST_USECOND);
+
+        if (!self->coalesce_thread)
+        {
+            self->coalesce_running = TRUE;
+            self->coalesce_thread = g_thread_create (coalesce_loop, self, TRUE, NULL);
+        }
+
+        g_cond_signal (self->coalesce_cond);
+    }
+
+    gst_adapter_push (self->adapter, buf);
+
+    return TRUE;
+}
+
+/**
+ * With OMX_TUNNEL_ON, connect our output port straight to the input port of
+ * the downstream element, if that is a GstOmx one using the same OpenMAX IL
+ * implementation.  See NOTE ABOUT TUNNELS in gstomx_port.c.
+ */
+static gboolean
+setup_tunnel (GstOmxBaseFilter *self)
+{
+    GstPad *peer;
+    GOmxPort *peer_port;
+    GstCaps *caps;
+    gboolean ret = FALSE;
+
+    peer_port = gst_omx_get_peer_port (self->srcpad);
+    if (!peer_port)
+        return FALSE;
+
+    peer = gst_pad_get_peer (self->srcpad);
+    if (!peer)
+        return FALSE;
+
+    caps = gst_pad_get_negotiated_caps (self->srcpad);
+    if (!caps)
+    {
+        GOmxCore *gomx = self->gomx;
+        if (gomx->settings_changed_cb)
+            gomx->settings_changed_cb (gomx);
+        caps = gst_pad_get_negotiated_caps (self->srcpad);
+    }
+
+    /* the peer sets up its input port from the caps, which it would
+     * otherwise only get with the first buffer, too late for the tunnel:
+     */
+    if (caps)
+    {
+        if (gst_pad_set_caps (peer, caps))
+            ret = g_omx_port_setup_tunnel (self->out_port, peer_port);
+        gst_caps_unref (caps);
+    }
+
+    GST_INFO_OBJECT (self, "tunnel to %" GST_PTR_FORMAT ": %d", peer, ret);
+
+    gst_object_unref (peer);
+
+    return ret;
+}
+
+/**
+ * Push a buffer with no data, just the timing of what went to the component,
+ * to a tunnel peer.
+ */
+static GstFlowReturn
+push_timestamp (GstOmxBaseFilter *self,
+                GstClockTime timestamp,
+                GstClockTime duration)
+{
+    GstBuffer *buf;
+
+    buf = gst_buffer_new ();
+    GST_BUFFER_TIMESTAMP (buf) = timestamp;
+    GST_BUFFER_DURATION (buf) = duration;
+    gst_buffer_set_caps (buf, GST_PAD_CAPS (self->srcpad));
+
+    return gst_pad_push (self->srcpad, buf);
+}
+
+/**
+ * Chain function of a tunneled input port: the data comes straight from
+ * the peer component, the buffers just tell when to change state.  The
+ * first one comes before the peer goes to Idle, which it can only get to
+ * once we are on the way there too, so don't wait for it then.
+ */
+static GstFlowReturn
+tunnel_chain (GstOmxBaseFilter *self,
+              GstBuffer *buf)
+{
+    GOmxCore *gomx = self->gomx;
+    GstFlowReturn ret = GST_FLOW_OK;
+
+    gst_buffer_unref (buf);
+
+    g_mutex_lock (self->ready_lock);
+
+    if (G_UNLIKELY (gomx->omx_state == OMX_StateLoaded &&
+                    gomx->pending_state != OMX_StateIdle))
+    {
+        GST_INFO_OBJECT (self, "omx: prepare (tunneled)");
+
+        if (self->omx_setup)
+            self->omx_setup (self);
+
+        setup_ports (self);
+
+        g_omx_core_prepare_async (gomx, NULL, NULL);
+    }
+    else if (G_UNLIKELY (!self->ready))
+    {
+        if (g_omx_core_wait_for_state (gomx, OMX_StateIdle))
+        {
+            self->ready = TRUE;
+            gst_pad_start_task (self->srcpad, output_loop, self->srcpad);
+        }
+    }
+
+    g_mutex_unlock (self->ready_lock);
+
+    if (G_UNLIKELY (self->ready && gomx->omx_state == OMX_StateIdle))
+    {
+        GST_INFO_OBJECT (self, "omx: play (tunneled)");
+        g_omx_core_start (gomx);
+    }
+
+    if (gomx->omx_error)
+    {
+        GST_ELEMENT_ERROR (self, STREAM, FAILED, (NULL),
+                           ("Error from OpenMAX component"));
+        ret = GST_FLOW_ERROR;
+    }
+
+    return ret;
+}
+
+/**
+ * Set up the ports and start the component on its way to Idle, without
+ * waiting for it to get there.  That can still block, waiting for the
+ * resources or for downstream to allocate the output buffers, so it is
+ * called without ready_lock, by whoever set self->preparing under it.
+ *
+ * Returns TRUE if the output port got tunneled, in which case the caller
+ * has to let the peer start its way to Idle too, with push_timestamp().
+ */
+static gboolean
+start_prepare (GstOmxBaseFilter *self)
+{
+    gboolean tunneled;
+
+    GST_INFO_OBJECT (self, "omx: prepare");
+
+    /** @todo this should probably go after doing preparations. */
+    if (self->omx_setup)
+    {
+        self->omx_setup (self);
+    }
+
+    if (self->auto_buffers)
+        apply_cached_buffers (self);
+
+    setup_ports (self);
+
+    if (self->import)
+    {
+        GOmxPort *peer_port = gst_omx_get_peer_port (self->sinkpad);
+
+        if (peer_port && g_omx_port_import (self->in_port, peer_port))
+            GST_INFO_OBJECT (self, "import buffers from %s", peer_port->name);
+    }
+
+    tunneled = self->tunnel && setup_tunnel (self);
+
+    g_omx_core_prepare_async (self->gomx, NULL, NULL);
+
+    return tunneled;
+}
+
+/**
+ * Claim start_prepare() if the component has yet to start its way to Idle.
+ * Called with ready_lock.
+ */
+static gboolean
+claim_prepare (GstOmxBaseFilter *self)
+{
+    GOmxCore *gomx = self->gomx;
+
+    if (self->preparing ||
+        gomx->omx_state != OMX_StateLoaded ||
+        gomx->pending_state == OMX_StateIdle)
+        return FALSE;
+
+    self->preparing = TRUE;
+
+    return TRUE;
+}
+
+static gpointer
+prepare_func (gpointer data)
+{
+    GstOmxBaseFilter *self = data;
+
+    start_prepare (self);
+
+    g_mutex_lock (self->ready_lock);
+    self->preparing = FALSE;
+    g_mutex_unlock (self->ready_lock);
+
+    return NULL;
+}
+
+/**
+ * Wait for the preparation started by sink_caps_notify(), if any.
+ * Called without ready_lock.
+ */
+static void
+join_prepare (GstOmxBaseFilter *self)
+{
+    GThread *thread;
+
+    g_mutex_lock (self->ready_lock);
+    thread = self->prepare_thread;
+    self->prepare_thread = NULL;
+    g_mutex_unlock (self->ready_lock);
+
+    if (thread)
+        g_thread_join (thread);
+}
+
+/**
+ * The input port is configured from the caps, so that is the first time the
+ * component can start its way to Idle, which it can then do while the first
+ * buffer is on its way.  Unless it has to wait for the peers to set up a
+ * tunnel or share buffers, which is left to the first buffer.
+ *
+ * This runs from setcaps, so the preparation goes to its own thread, for
+ * the first buffer (or the state change) to join: otherwise setcaps would
+ * block as long as the resources take to free up.
+ */
+static void
+sink_caps_notify (GObject *obj,
+                  GParamSpec *pspec,
+                  GstOmxBaseFilter *self)
+{
+    GError *err = NULL;
+
+    if (self->tunnel || self->import || !GST_PAD_CAPS (self->sinkpad))
+        return;
+
+    g_mutex_lock (self->ready_lock);
+
+    if (!self->prepare_thread && claim_prepare (self))
+    {
+        self->prepare_thread = g_thread_create (prepare_func, self, TRUE, &err);
+
+        if (!self->prepare_thread)
+        {
+            /* the first buffer will do it then */
+            GST_WARNING_OBJECT (self, "could not create thread: %s",
+                                err->message);
+            g_error_free (err);
+            self->preparing = FALSE;
+        }
+    }
+
+    g_mutex_unlock (self->ready_lock);
+}
+
 static GstFlowReturn
 pad_chain (GstPad *pad,
            GstBuffer *buf)
@@ -491,6 +1457,8 @@ pad_chain (GstPad *pad,
     GOmxPort *in_port;
     GstOmxBaseFilter *self;
     GstFlowReturn ret = GST_FLOW_OK;
+    GstClockTime timestamp, duration;
+    gboolean stamp, sent;
 
     self = GST_OMX_BASE_FILTER (GST_OBJECT_PARENT (pad));
 
@@ -500,23 +1468,45 @@ pad_chain (GstPad *pad,
 
     GST_LOG_OBJECT (self, "begin: size=%u, state=%d", GST_BUFFER_SIZE (buf), gomx->omx_state);
 
-    if (G_UNLIKELY (gomx->omx_state == OMX_StateLoaded))
+    if (G_UNLIKELY (self->in_port->tunnel))
+        return tunnel_chain (self, buf);
+
+    if (G_UNLIKELY (!self->ready))
     {
-        g_mutex_lock (self->ready_lock);
+        gboolean tunneled = FALSE;
+        gboolean prepare;
+        GstFlowReturn push_ret = GST_FLOW_OK;
 
-        GST_INFO_OBJECT (self, "omx: prepare");
+        join_prepare (self);
 
-        /** @todo this should probably go after doing preparations. */
-        if (self->omx_setup)
+        g_mutex_lock (self->ready_lock);
+        prepare = claim_prepare (self);
+        g_mutex_unlock (self->ready_lock);
+
+        if (prepare)
         {
-            self->omx_setup (self);
+            tunneled = start_prepare (self);
+
+            g_mutex_lock (self->ready_lock);
+            self->preparing = FALSE;
+            g_mutex_unlock (self->ready_lock);
         }
 
-        setup_ports (self);
+        /* let the peer start its way to Idle, without ready_lock: the push
+         * can block downstream (a sink prerolling), and a state change
+         * needs the lock to get us out of here.  If the push didn't make
+         * it, the peer won't get to Idle, nor will we.
+         */
+        if (tunneled)
+        {
+            push_ret = push_timestamp (self, GST_CLOCK_TIME_NONE, GST_CLOCK_TIME_NONE);
+            self->last_pad_push_return = push_ret;
+        }
 
-        g_omx_core_prepare (self->gomx);
+        g_mutex_lock (self->ready_lock);
 
-        if (gomx->omx_state == OMX_StateIdle)
+        if (!self->ready && push_ret == GST_FLOW_OK &&
+            g_omx_core_wait_for_state (gomx, OMX_StateIdle))
         {
             self->ready = TRUE;
             gst_pad_start_task (self->srcpad, output_loop, self->srcpad);
@@ -524,12 +1514,18 @@ pad_chain (GstPad *pad,
 
         g_mutex_unlock (self->ready_lock);
 
-        if (gomx->omx_state != OMX_StateIdle)
+        if (!self->ready)
             goto out_flushing;
     }
 
     in_port = self->in_port;
 
+    /* with a tunnel, only the timing of the data goes through the pad: */
+    timestamp = GST_BUFFER_TIMESTAMP (buf);
+    duration = GST_BUFFER_DURATION (buf);
+    stamp = self->out_port->tunnel &&
+            !GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_IN_CAPS);
+
     if (G_LIKELY (in_port->enabled))
     {
         if (G_UNLIKELY (gomx->omx_state == OMX_StateIdle))
@@ -554,37 +1550,33 @@ pad_chain (GstPad *pad,
             GST_ERROR_OBJECT (self, "Whoa! very wrong");
         }
 
-        while (TRUE)
+        latency_sample_in (self, GST_BUFFER_TIMESTAMP (buf));
+
+        tune_buffers (self, in_port, &self->in_tuning);
+
+        g_mutex_lock (self->coalesce_lock);
+
+        if (self->coalesce_latency && in_port->buffers &&
+            !GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_IN_CAPS))
+        {
+            sent = coalesce_buffer (self, buf, &ret);
+            buf = NULL;
+        }
+        else if ((sent = send_coalesced (self, &ret)))
         {
-            gint sent;
+            sent = send_buffer (self, buf, &ret);
+            buf = NULL;
+        }
 
-            if (self->last_pad_push_return != GST_FLOW_OK ||
-                !(gomx->omx_state == OMX_StateExecuting ||
-                  gomx->omx_state == OMX_StatePause))
-            {
-                GST_DEBUG_OBJECT (self, "last_pad_push_return=%d", self->last_pad_push_return);
-                goto out_flushing;
-            }
+        g_mutex_unlock (self->coalesce_lock);
 
-            sent = g_omx_port_send (in_port, buf);
+        if (!sent)
+            goto out_flushing;
 
-            if (G_UNLIKELY (sent < 0))
-            {
-                ret = GST_FLOW_WRONG_STATE;
-                goto out_flushing;
-            }
-            else if (sent < GST_BUFFER_SIZE (buf))
-            {
-                GstBuffer *subbuf = gst_buffer_create_sub (buf, sent,
-                        GST_BUFFER_SIZE (buf) - sent);
-                gst_buffer_unref (buf);
-                buf = subbuf;
-            }
-            else
-            {
-                gst_buffer_unref (buf);
-                break;
-            }
+        if (stamp)
+        {
+            ret = push_timestamp (self, timestamp, duration);
+            self->last_pad_push_return = ret;
         }
     }
     else
@@ -620,12 +1612,38 @@ out_flushing:
             ret = GST_FLOW_ERROR;
         }
 
-        gst_buffer_unref (buf);
+        if (buf)
+            gst_buffer_unref (buf);
 
         goto leave;
     }
 }
 
+/**
+ * let upstream write directly into the OMX input buffers when possible
+ */
+static GstFlowReturn
+pad_buffer_alloc (GstPad *pad,
+                  guint64 offset,
+                  guint size,
+                  GstCaps *caps,
+                  GstBuffer **buf)
+{
+    GstOmxBaseFilter *self;
+
+    self = GST_OMX_BASE_FILTER (GST_OBJECT_PARENT (pad));
+
+    *buf = g_omx_port_request_input_buffer (self->in_port, size);
+
+    if (!*buf)
+        *buf = gst_buffer_new_and_alloc (size);
+
+    GST_BUFFER_OFFSET (*buf) = offset;
+    gst_buffer_set_caps (*buf, caps);
+
+    return GST_FLOW_OK;
+}
+
 static gboolean
 pad_event (GstPad *pad,
            GstEvent *event)
@@ -642,14 +1660,36 @@ pad_event (GstPad *pad,
     switch (GST_EVENT_TYPE (event))
     {
         case GST_EVENT_EOS:
+            /* the EOS buffer comes through the tunnel, and the output loop
+             * takes care of the event when it comes out */
+            if (self->ready && self->in_port->tunnel)
+            {
+                gst_event_unref (event);
+                break;
+            }
+
             /* if we are init'ed, and there is a running loop; then
              * if we get a buffer to inform it of EOS, let it handle the rest
              * in any other case, we send EOS */
             if (self->ready && self->last_pad_push_return == GST_FLOW_OK)
             {
-                if (g_omx_port_send (self->in_port, event) >= 0)
+                GstFlowReturn flow_ret;
+                gint sent;
+
+                /* don't leave anything behind in the adapter */
+                g_mutex_lock (self->coalesce_lock);
+                send_coalesced (self, &flow_ret);
+                sent = g_omx_port_send (self->in_port, event);
+                g_mutex_unlock (self->coalesce_lock);
+
+                if (sent >= 0)
                 {
-                    gst_event_unref (event);
+                    /* with no output loop to push it, the tunnel peer
+                     * still needs the event to finish the stream */
+                    if (self->out_port->tunnel)
+                        ret = gst_pad_push_event (self->srcpad, event);
+                    else
+                        gst_event_unref (event);
                     break;
                 }
             }
@@ -673,6 +1713,11 @@ pad_event (GstPad *pad,
             gst_pad_push_event (self->srcpad, event);
             self->last_pad_push_return = GST_FLOW_OK;
 
+            g_mutex_lock (self->coalesce_lock);
+            gst_adapter_clear (self->adapter);
+            g_mutex_unlock (self->coalesce_lock);
+            clear_latency_samples (self);
+
             g_omx_core_flush_stop (gomx);
 
             if (self->ready)
@@ -783,6 +1828,31 @@ buffer_alloc (GOmxPort *port, gint len)
     }
 #endif
 
+    /* if downstream does not provide buffers itself, it would just hand us
+     * a freshly malloc'd one, so rather recycle from our own pool:
+     */
+    if (port->pool && port->buffers)
+    {
+        GstPad *peer = gst_pad_get_peer (self->srcpad);
+        gboolean peer_alloc = TRUE;
+
+        if (peer)
+        {
+            peer_alloc = (GST_PAD_BUFFERALLOCFUNC (peer) != NULL);
+            gst_object_unref (peer);
+        }
+
+        if (!peer_alloc)
+        {
+            buf = g_omx_buffer_pool_get (port->pool, len);
+            if (buf)
+            {
+                gst_buffer_set_caps (buf, GST_PAD_CAPS (self->srcpad));
+                return buf;
+            }
+        }
+    }
+
     ret = gst_pad_alloc_buffer_and_set_caps (
             self->srcpad, GST_BUFFER_OFFSET_NONE,
             len, GST_PAD_CAPS (self->srcpad), &buf);
@@ -826,19 +1896,45 @@ type_instance_init (GTypeInstance *instance,
 
     gst_pad_set_chain_function (self->sinkpad, bclass->pad_chain);
     gst_pad_set_event_function (self->sinkpad, bclass->pad_event);
+    g_signal_connect (self->sinkpad, "notify::caps",
+                      G_CALLBACK (sink_caps_notify), self);
 
     self->srcpad =
         gst_pad_new_from_template (gst_element_class_get_pad_template (element_class, "src"), "src");
 
     gst_pad_set_activatepush_function (self->srcpad, activate_push);
+    gst_pad_set_query_function (self->srcpad, bclass->src_query);
 
     gst_pad_use_fixed_caps (self->srcpad);
 
     gst_element_add_pad (GST_ELEMENT (self), self->sinkpad);
     gst_element_add_pad (GST_ELEMENT (self), self->srcpad);
 
+    /* so that a peer can find our ports before we get any data: */
+    gst_pad_set_element_private (self->sinkpad, self->in_port);
+    gst_pad_set_element_private (self->srcpad, self->out_port);
+
+    if (g_getenv ("OMX_TUNNEL_ON"))
+    {
+        GST_DEBUG_OBJECT (self, "OMX_TUNNEL_ON");
+        self->tunnel = TRUE;
+    }
+
+    if (g_getenv ("OMX_IMPORT_ON"))
+    {
+        GST_DEBUG_OBJECT (self, "OMX_IMPORT_ON");
+        self->import = TRUE;
+    }
+
     self->duration = GST_CLOCK_TIME_NONE;
 
+    self->adapter = gst_adapter_new ();
+    self->coalesce_ts = GST_CLOCK_TIME_NONE;
+    self->coalesce_lock = g_mutex_new ();
+    self->coalesce_cond = g_cond_new ();
+
+    reset_latency (self);
+
     GST_LOG_OBJECT (self, "end");
 }
 
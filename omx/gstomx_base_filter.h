@@ -23,6 +23,7 @@
 #define GSTOMX_BASE_FILTER_H
 
 #include <gst/gst.h>
+#include <gst/base/gstadapter.h>
 
 G_BEGIN_DECLS
 
@@ -33,11 +34,25 @@ G_BEGIN_DECLS
 
 typedef struct GstOmxBaseFilter GstOmxBaseFilter;
 typedef struct GstOmxBaseFilterClass GstOmxBaseFilterClass;
+typedef struct GstOmxBufferTuning GstOmxBufferTuning;
 typedef void (*GstOmxBaseFilterCb) (GstOmxBaseFilter *self);
 
+/** number of input timestamps remembered to measure the latency */
+#define GST_OMX_BASE_FILTER_LATENCY_SAMPLES 32
+
 #include "gstomx_util.h"
 #include <async_queue.h>
 
+/** how starved a port is, measured for auto-buffers */
+struct GstOmxBufferTuning
+{
+    guint64 start;      /**< in us, 0 until the port is streaming */
+    guint64 blocked;    /**< stats.blocked of the port at start */
+    guint samples;      /**< output buffers seen since start */
+    guint held_full;    /**< of which came while downstream held all it can */
+    gboolean done;
+};
+
 struct GstOmxBaseFilter
 {
     GstElement element;
@@ -54,11 +69,42 @@ struct GstOmxBaseFilter
     char *omx_library;
     gboolean ready;
     GMutex *ready_lock;
+    gboolean preparing;         /**< in start_prepare(), under ready_lock */
+    GThread *prepare_thread;    /**< started by sink_caps_notify() */
 
     GstOmxBaseFilterCb omx_setup;
     GstFlowReturn last_pad_push_return;
     GstBuffer *codec_data;
     GstClockTime duration;
+
+    /* input coalescing: */
+    guint64 coalesce_latency;   /**< 0 when disabled */
+    GstAdapter *adapter;
+    GstClockTime coalesce_ts;   /**< timestamp of the first pending buffer */
+    GMutex *coalesce_lock;      /**< protects the adapter and the below */
+    GCond *coalesce_cond;
+    GThread *coalesce_thread;   /**< sends what is pending when it is due */
+    gboolean coalesce_running;
+    gboolean coalesce_sending;  /**< coalesce_loop() is sending, unlocked */
+    GTimeVal coalesce_deadline; /**< when the pending data is due */
+
+    /* latency measurement, protected by the object lock: */
+    GstClockTime sample_ts[GST_OMX_BASE_FILTER_LATENCY_SAMPLES];
+    guint64 sample_time[GST_OMX_BASE_FILTER_LATENCY_SAMPLES]; /**< in us */
+    guint sample_pos;
+    GstClockTime latency;           /**< running in->out delay */
+    GstClockTime reported_latency;  /**< as of the last latency message */
+
+    /* tunneling, see NOTE ABOUT TUNNELS in gstomx_port.c: */
+    gboolean tunnel;    /**< try to tunnel to a GstOmx peer */
+    /** use the buffers of an upstream GstOmx peer, see NOTE ABOUT IMPORTED
+     *  BUFFERS in gstomx_port.c */
+    gboolean import;
+
+    /* buffer count autotuning: */
+    gboolean auto_buffers;
+    GstOmxBufferTuning in_tuning;   /**< only touched by the chain function */
+    GstOmxBufferTuning out_tuning;  /**< only touched by the output loop */
 };
 
 struct GstOmxBaseFilterClass
@@ -68,6 +114,7 @@ struct GstOmxBaseFilterClass
     GstFlowReturn (*push_buffer) (GstOmxBaseFilter *self, GstBuffer *buf);
     GstFlowReturn (*pad_chain) (GstPad *pad, GstBuffer *buf);
     gboolean (*pad_event) (GstPad *pad, GstEvent *event);
+    gboolean (*src_query) (GstPad *pad, GstQuery *query);
 };
 
 GType gst_omx_base_filter_get_type (void);
@@ -36,6 +36,8 @@ enum
     ARG_COMPONENT_ROLE,
     ARG_COMPONENT_NAME,
     ARG_LIBRARY_NAME,
+    ARG_STATE_TIMEOUT,
+    ARG_STATS,
 };
 
 static void init_interfaces (GType type);
@@ -80,10 +82,23 @@ change_state (GstElement *element,
                 self->initialized = TRUE;
             }
 
-            g_omx_core_prepare (self->gomx);
+            /* the input port can only be tunneled or import buffers in
+             * Loaded, so wait for the first buffer then, see lazy_start():
+             */
+            if (self->tunnel || self->import)
+                break;
+
+            /* don't wait for the component to get to Idle here, so the rest
+             * of the pipeline can start up meanwhile:
+             */
+            g_omx_core_prepare_async (self->gomx, NULL, NULL);
             break;
 
         case GST_STATE_CHANGE_READY_TO_PAUSED:
+            if (self->tunnel || self->import)
+                break;
+            if (!g_omx_core_wait_for_state (self->gomx, OMX_StateIdle))
+                return GST_STATE_CHANGE_FAILURE;
             g_omx_core_start (self->gomx);
             break;
 
@@ -112,6 +127,7 @@ change_state (GstElement *element,
 
         case GST_STATE_CHANGE_READY_TO_NULL:
             g_omx_core_unload (self->gomx);
+            g_omx_ppm_report (self->gomx->ppm);
             break;
 
         default:
@@ -140,6 +156,48 @@ finalize (GObject *obj)
     G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
 
+/**
+ * With OMX_TUNNEL_ON or OMX_IMPORT_ON, get the component going on the first
+ * buffer, when the buffers of the upstream element can be imported (see
+ * NOTE ABOUT IMPORTED BUFFERS in gstomx_port.c).  If the upstream element
+ * tunneled to us meanwhile, that one just tells us to start the way to
+ * Idle, which the peer has to take at the same time (see NOTE ABOUT
+ * TUNNELS), so don't wait for it then.
+ */
+static gboolean
+lazy_start (GstOmxBaseSink *self)
+{
+    GOmxCore *gomx = self->gomx;
+
+    if (gomx->omx_state == OMX_StateLoaded &&
+        gomx->pending_state != OMX_StateIdle)
+    {
+        if (self->import)
+        {
+            GOmxPort *peer_port = gst_omx_get_peer_port (self->sinkpad);
+
+            if (peer_port && g_omx_port_import (self->in_port, peer_port))
+                GST_INFO_OBJECT (self, "import buffers from %s", peer_port->name);
+        }
+
+        GST_INFO_OBJECT (self, "omx: prepare (tunneled=%d)",
+                         self->in_port->tunnel != NULL);
+        g_omx_core_prepare_async (gomx, NULL, NULL);
+
+        if (self->in_port->tunnel)
+            return (gomx->omx_error == OMX_ErrorNone);
+    }
+
+    if (gomx->omx_state != OMX_StateExecuting)
+    {
+        if (!g_omx_core_wait_for_state (gomx, OMX_StateIdle))
+            return FALSE;
+        g_omx_core_start (gomx);
+    }
+
+    return (gomx->omx_state == OMX_StateExecuting);
+}
+
 static GstFlowReturn
 render (GstBaseSink *gst_base,
         GstBuffer *buf)
@@ -160,6 +218,20 @@ render (GstBaseSink *gst_base,
 
     in_port = self->in_port;
 
+    if (G_UNLIKELY (self->tunnel || self->import))
+    {
+        if (!lazy_start (self))
+        {
+            GST_ELEMENT_ERROR (self, STREAM, FAILED, (NULL),
+                               ("OpenMAX component in wrong state"));
+            return GST_FLOW_ERROR;
+        }
+
+        /* the data comes straight from the peer component: */
+        if (in_port->tunnel)
+            return GST_FLOW_OK;
+    }
+
     if (G_LIKELY (in_port->enabled))
     {
         while (TRUE)
@@ -201,11 +273,9 @@ handle_event (GstBaseSink *gst_base,
 {
     GstOmxBaseSink *self;
     GOmxCore *gomx;
-    GOmxPort *in_port;
 
     self = GST_OMX_BASE_SINK (gst_base);
     gomx = self->gomx;
-    in_port = self->in_port;
 
     GST_LOG_OBJECT (self, "begin");
 
@@ -220,16 +290,12 @@ handle_event (GstBaseSink *gst_base,
 
         case GST_EVENT_FLUSH_START:
             /* unlock loops */
-            g_omx_port_pause (in_port);
-
-            /* flush all buffers */
-            OMX_SendCommand (gomx->omx_handle, OMX_CommandFlush, OMX_ALL, NULL);
+            g_omx_core_flush_start (gomx);
             break;
 
         case GST_EVENT_FLUSH_STOP:
-            g_sem_down (gomx->flush_sem);
-
-            g_omx_port_resume (in_port);
+            /* flush all buffers */
+            g_omx_core_flush_stop (gomx);
             break;
 
         default:
@@ -265,6 +331,9 @@ set_property (GObject *obj,
             g_free (self->omx_library);
             self->omx_library = g_value_dup_string (value);
             break;
+        case ARG_STATE_TIMEOUT:
+            self->gomx->state_timeout = g_value_get_uint (value);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
             break;
@@ -292,6 +361,12 @@ get_property (GObject *obj,
         case ARG_LIBRARY_NAME:
             g_value_set_string (value, self->omx_library);
             break;
+        case ARG_STATE_TIMEOUT:
+            g_value_set_uint (value, self->gomx->state_timeout);
+            break;
+        case ARG_STATS:
+            g_value_take_boxed (value, g_omx_core_get_stats (self->gomx));
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
             break;
@@ -342,6 +417,17 @@ type_class_init (gpointer g_class,
                                          g_param_spec_string ("library-name", "Library name",
                                                               "Name of the OpenMAX IL implementation library to use",
                                                               NULL, G_PARAM_READWRITE));
+
+        g_object_class_install_property (gobject_class, ARG_STATE_TIMEOUT,
+                                         g_param_spec_uint ("state-timeout", "State timeout",
+                                                            "How long to wait for the OMX component to change state (in ms)",
+                                                            1, G_MAXUINT, G_OMX_CORE_DEFAULT_STATE_TIMEOUT,
+                                                            G_PARAM_READWRITE));
+
+        g_object_class_install_property (gobject_class, ARG_STATS,
+                                         g_param_spec_boxed ("stats", "Statistics",
+                                                             "Counters of the OMX ports",
+                                                             GST_TYPE_STRUCTURE, G_PARAM_READABLE));
     }
 }
 
@@ -444,6 +530,18 @@ type_instance_init (GTypeInstance *instance,
         gst_pad_set_link_function (sinkpad, pad_sink_link);
     }
 
+    if (g_getenv ("OMX_TUNNEL_ON"))
+    {
+        GST_DEBUG_OBJECT (self, "OMX_TUNNEL_ON");
+        self->tunnel = TRUE;
+    }
+
+    if (g_getenv ("OMX_IMPORT_ON"))
+    {
+        GST_DEBUG_OBJECT (self, "OMX_IMPORT_ON");
+        self->import = TRUE;
+    }
+
     GST_LOG_OBJECT (self, "end");
 }
 
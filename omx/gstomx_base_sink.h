@@ -53,6 +53,8 @@ struct GstOmxBaseSink
     gboolean ready;
     GstPadActivateModeFunction base_activatepush;
     gboolean initialized;
+    gboolean tunnel;    /**< let a GstOmx peer tunnel to us */
+    gboolean import;    /**< use the buffers of a GstOmx peer */
 };
 
 struct GstOmxBaseSinkClass
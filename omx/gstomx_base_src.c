@@ -31,6 +31,8 @@ enum
     ARG_COMPONENT_NAME,
     ARG_LIBRARY_NAME,
     ARG_NUM_OUTPUT_BUFFERS,
+    ARG_STATE_TIMEOUT,
+    ARG_STATS,
 };
 
 GSTOMX_BOILERPLATE (GstOmxBaseSrc, gst_omx_base_src, GstBaseSrc, GST_TYPE_BASE_SRC);
@@ -283,6 +285,9 @@ set_property (GObject *obj,
                 G_OMX_PORT_SET_DEFINITION (self->out_port, &param);
             }
             break;
+        case ARG_STATE_TIMEOUT:
+            self->gomx->state_timeout = g_value_get_uint (value);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
             break;
@@ -317,6 +322,12 @@ get_property (GObject *obj,
                 g_value_set_uint (value, param.nBufferCountActual);
             }
             break;
+        case ARG_STATE_TIMEOUT:
+            g_value_set_uint (value, self->gomx->state_timeout);
+            break;
+        case ARG_STATS:
+            g_value_take_boxed (value, g_omx_core_get_stats (self->gomx));
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
             break;
@@ -377,6 +388,17 @@ type_class_init (gpointer g_class,
                                          g_param_spec_uint ("output-buffers", "Output buffers",
                                                             "The number of OMX output buffers",
                                                             1, 10, 4, G_PARAM_READWRITE));
+
+        g_object_class_install_property (gobject_class, ARG_STATE_TIMEOUT,
+                                         g_param_spec_uint ("state-timeout", "State timeout",
+                                                            "How long to wait for the OMX component to change state (in ms)",
+                                                            1, G_MAXUINT, G_OMX_CORE_DEFAULT_STATE_TIMEOUT,
+                                                            G_PARAM_READWRITE));
+
+        g_object_class_install_property (gobject_class, ARG_STATS,
+                                         g_param_spec_boxed ("stats", "Statistics",
+                                                             "Counters of the OMX ports",
+                                                             GST_TYPE_STRUCTURE, G_PARAM_READABLE));
     }
 
     omx_base_class->out_port_index = 0;
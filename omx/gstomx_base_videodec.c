@@ -41,15 +41,31 @@ GSTOMX_BOILERPLATE (GstOmxBaseVideoDec, gst_omx_base_videodec, GstOmxBaseFilter,
 #  define GSTOMX_ALL_FORMATS  "{NV12}"
 #endif
 
+#define NATIVE_CAPS \
+        GST_VIDEO_CAPS_YUV_STRIDED (GSTOMX_ALL_FORMATS, "[ 0, max ]")
+
+/* what we can convert the output of the component to, see GOmxConvert: */
+#define CONVERT_CAPS \
+        GST_VIDEO_CAPS_YUV ("{ I420, YUY2, UYVY }") ";" \
+        GST_VIDEO_CAPS_BGRx ";" GST_VIDEO_CAPS_RGBx ";" \
+        GST_VIDEO_CAPS_xRGB ";" GST_VIDEO_CAPS_xBGR ";" \
+        GST_VIDEO_CAPS_BGRA ";" GST_VIDEO_CAPS_RGBA ";" \
+        GST_VIDEO_CAPS_ARGB ";" GST_VIDEO_CAPS_ABGR
+
 static GstStaticPadTemplate src_template =
         GST_STATIC_PAD_TEMPLATE ("src",
                 GST_PAD_SRC,
                 GST_PAD_ALWAYS,
-                GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV_STRIDED (
-                        GSTOMX_ALL_FORMATS, "[ 0, max ]"))
+                GST_STATIC_CAPS (NATIVE_CAPS ";" CONVERT_CAPS)
         );
 
+static GstStaticCaps native_caps = GST_STATIC_CAPS (NATIVE_CAPS);
+static GstStaticCaps convert_caps = GST_STATIC_CAPS (CONVERT_CAPS);
+
 static GstFlowReturn push_buffer (GstOmxBaseFilter *self, GstBuffer *buf);
+static gboolean src_query (GstPad *pad, GstQuery *query);
+static GstFlowReturn pad_chain (GstPad *pad, GstBuffer *buf);
+static gboolean pad_event (GstPad *pad, GstEvent *event);
 
 static void
 type_base_init (gpointer g_class)
@@ -67,6 +83,75 @@ type_class_init (gpointer g_class,
                  gpointer class_data)
 {
     GST_OMX_BASE_FILTER_CLASS (g_class)->push_buffer = push_buffer;
+    GST_OMX_BASE_FILTER_CLASS (g_class)->src_query = src_query;
+    GST_OMX_BASE_FILTER_CLASS (g_class)->pad_chain = pad_chain;
+    GST_OMX_BASE_FILTER_CLASS (g_class)->pad_event = pad_event;
+}
+
+/* NOTE ABOUT QOS:
+ *
+ * When downstream falls behind, it tells us with QoS events when the next
+ * frame would still be in time (earliest_time, in running time).  Decoded
+ * frames that are already late are dropped rather than pushed, and if the
+ * subclass can tell that an input frame is not used as reference for any
+ * other frame, late input frames are not even given to the component.
+ */
+
+static void
+reset_qos (GstOmxBaseVideoDec *self)
+{
+    GST_OBJECT_LOCK (self);
+    gst_segment_init (&self->segment, GST_FORMAT_TIME);
+    self->proportion = 1.0;
+    self->earliest_time = GST_CLOCK_TIME_NONE;
+    GST_OBJECT_UNLOCK (self);
+}
+
+static gboolean
+is_late (GstOmxBaseVideoDec *self,
+         GstClockTime ts)
+{
+    GstClockTime duration = GST_OMX_BASE_FILTER (self)->duration;
+    GstClockTime running_time;
+    gboolean late = FALSE;
+
+    if (!GST_CLOCK_TIME_IS_VALID (ts))
+        return FALSE;
+
+    GST_OBJECT_LOCK (self);
+
+    if (GST_CLOCK_TIME_IS_VALID (self->earliest_time))
+    {
+        running_time = gst_segment_to_running_time (&self->segment,
+                GST_FORMAT_TIME, ts);
+
+        if (GST_CLOCK_TIME_IS_VALID (running_time))
+        {
+            if (GST_CLOCK_TIME_IS_VALID (duration))
+                running_time += duration;
+            late = (running_time <= self->earliest_time);
+        }
+    }
+
+    GST_OBJECT_UNLOCK (self);
+
+    return late;
+}
+
+static void
+drop_buffer (GstOmxBaseVideoDec *self,
+             GstBuffer *buf,
+             const gchar *reason)
+{
+    GST_OBJECT_LOCK (self);
+    self->dropped++;
+    GST_OBJECT_UNLOCK (self);
+
+    GST_DEBUG_OBJECT (self, "dropping late %s frame %" GST_TIME_FORMAT
+                      " (%" G_GUINT64_FORMAT " so far)", reason,
+                      GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buf)), self->dropped);
+
+    gst_buffer_unref (buf);
 }
 
 static GstFlowReturn
@@ -74,6 +159,13 @@ push_buffer (GstOmxBaseFilter *omx_base, GstBuffer *buf)
 {
     GstOmxBaseVideoDec *self = GST_OMX_BASE_VIDEODEC (omx_base);
     guint n_offset = omx_base->out_port->n_offset;
+
+    if (is_late (self, GST_BUFFER_TIMESTAMP (buf)))
+    {
+        drop_buffer (self, buf, "decoded");
+        return GST_FLOW_OK;
+    }
+
     if (n_offset)
     {
         gst_pad_push_event (omx_base->srcpad,
@@ -197,6 +289,13 @@ sink_setcaps (GstPad *pad,
     return gst_pad_set_caps (pad, caps);
 }
 
+/* can the output be converted to other formats than the component's */
+static inline gboolean
+can_convert (GstOmxBaseVideoDec *self)
+{
+    return self->convert && !GST_OMX_BASE_FILTER (self)->out_port->share_buffer;
+}
+
 static GstCaps *
 src_getcaps (GstPad *pad)
 {
@@ -270,7 +369,7 @@ src_getcaps (GstPad *pad)
     else
     {
         /* we don't have valid width/height/etc yet, so just use the template.. */
-        caps = gst_static_pad_template_get_caps (&src_template);
+        caps = gst_caps_make_writable (gst_static_caps_get (&native_caps));
         GST_DEBUG_OBJECT (self, "caps=%"GST_PTR_FORMAT, caps);
     }
 
@@ -278,6 +377,38 @@ src_getcaps (GstPad *pad)
     caps = g_omx_port_set_video_formats (omx_base->out_port, caps);
 #endif
 
+    if (can_convert (self))
+    {
+        GstCaps *extra = gst_caps_make_writable (gst_static_caps_get (&convert_caps));
+
+        if (self->inport_configured)
+        {
+            OMX_PARAM_PORTDEFINITIONTYPE param;
+            guint i;
+
+            G_OMX_PORT_GET_DEFINITION (omx_base->out_port, &param);
+
+            for (i = 0; i < gst_caps_get_size (extra); i++)
+            {
+                GstStructure *struc = gst_caps_get_structure (extra, i);
+
+                gst_structure_set (struc,
+                        "width",  G_TYPE_INT, param.format.video.nFrameWidth,
+                        "height", G_TYPE_INT, param.format.video.nFrameHeight,
+                        NULL);
+
+                if (self->framerate_denom)
+                {
+                    gst_structure_set (struc,
+                            "framerate", GST_TYPE_FRACTION, self->framerate_num, self->framerate_denom,
+                            NULL);
+                }
+            }
+        }
+
+        gst_caps_append (caps, extra);
+    }
+
     GST_DEBUG_OBJECT (self, "caps=%"GST_PTR_FORMAT, caps);
 
     return caps;
@@ -305,20 +436,66 @@ src_setcaps (GstPad *pad, GstCaps *caps)
     {
         /* Output port configuration: */
         OMX_PARAM_PORTDEFINITIONTYPE param;
+        GstVideoFormat omx_format = format;
+        GOmxConvert *convert = NULL;
+        gint out_rowstride = rowstride;
+
+        if (self->convert && format != GST_VIDEO_FORMAT_NV12)
+        {
+            if (!can_convert (self) ||
+                !g_omx_convert_supported (GST_VIDEO_FORMAT_NV12, format))
+            {
+                GST_WARNING_OBJECT (self, "can't convert to %" GST_FOURCC_FORMAT,
+                        GST_FOURCC_ARGS (gst_video_format_to_fourcc (format)));
+                return FALSE;
+            }
+
+            /* the component keeps decoding to NV12, with its own stride: */
+            omx_format = GST_VIDEO_FORMAT_NV12;
+            rowstride = 0;
+        }
 
         G_OMX_PORT_GET_DEFINITION (omx_base->out_port, &param);
 
         if (!rowstride)
-            rowstride = gst_video_format_get_component_width (format, 0, width);
+            rowstride = gst_video_format_get_component_width (omx_format, 0, width);
 
         param.format.video.eColorFormat = g_omx_fourcc_to_colorformat (
-                gst_video_format_to_fourcc (format));
+                gst_video_format_to_fourcc (omx_format));
         param.format.video.nFrameWidth  = width;
         param.format.video.nFrameHeight = height;
         param.format.video.nStride      = self->rowstride = rowstride;
 
         G_OMX_PORT_SET_DEFINITION (omx_base->out_port, &param);
         GST_INFO_OBJECT (omx_base,"G_OMX_PORT_SET_DEFINITION");
+
+        /* the component may have padded the planes (for its 2D buffers, for
+         * instance), then unless the buffers are shared, the picture is
+         * repacked to the stride downstream expects while copying it.  We
+         * may well be called from g_omx_port_recv(), through the pad-alloc
+         * of the frame being copied, which then goes out the new way (see
+         * recv_convert()):
+         */
+        if (!omx_base->out_port->share_buffer)
+        {
+            gint down_rowstride = out_rowstride ? out_rowstride :
+                    gst_video_format_get_row_stride (format, 0, width);
+
+            G_OMX_PORT_GET_DEFINITION (omx_base->out_port, &param);
+
+            if (omx_format != format ||
+                (param.format.video.nStride >= width &&
+                 param.format.video.nStride != down_rowstride))
+            {
+                convert = g_omx_convert_new (omx_format,
+                        param.format.video.nStride, param.format.video.nSliceHeight,
+                        format, out_rowstride, 0, width, height);
+                if (!convert)
+                    return FALSE;
+            }
+        }
+
+        g_omx_port_set_convert (omx_base->out_port, convert);
     }
 
     return TRUE;
@@ -382,12 +559,111 @@ src_query (GstPad *pad, GstQuery *query)
 
         ret = TRUE;
     }
+    else
+    {
+        ret = parent_class->src_query (pad, query);
+    }
 
     GST_DEBUG_OBJECT (self, "end -> %d", ret);
 
     return ret;
 }
 
+static GstFlowReturn
+pad_chain (GstPad *pad,
+           GstBuffer *buf)
+{
+    GstOmxBaseVideoDec *self = GST_OMX_BASE_VIDEODEC (GST_OBJECT_PARENT (pad));
+    GstOmxBaseVideoDecClass *klass = GST_OMX_BASE_VIDEODEC_GET_CLASS (self);
+
+    if (klass->is_droppable &&
+        !GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_IN_CAPS) &&
+        is_late (self, GST_BUFFER_TIMESTAMP (buf)) &&
+        klass->is_droppable (self, buf))
+    {
+        drop_buffer (self, buf, "non-reference");
+        return GST_FLOW_OK;
+    }
+
+    return parent_class->pad_chain (pad, buf);
+}
+
+static gboolean
+pad_event (GstPad *pad,
+           GstEvent *event)
+{
+    GstOmxBaseVideoDec *self = GST_OMX_BASE_VIDEODEC (GST_OBJECT_PARENT (pad));
+
+    switch (GST_EVENT_TYPE (event))
+    {
+        case GST_EVENT_NEWSEGMENT:
+        {
+            gboolean update;
+            gdouble rate, applied_rate;
+            GstFormat format;
+            gint64 start, stop, position;
+
+            gst_event_parse_new_segment_full (event, &update, &rate,
+                    &applied_rate, &format, &start, &stop, &position);
+
+            /* without a time segment, timestamps are taken as running time */
+            if (format == GST_FORMAT_TIME)
+            {
+                GST_OBJECT_LOCK (self);
+                gst_segment_set_newsegment_full (&self->segment, update, rate,
+                        applied_rate, format, start, stop, position);
+                GST_OBJECT_UNLOCK (self);
+            }
+            break;
+        }
+
+        case GST_EVENT_FLUSH_STOP:
+            reset_qos (self);
+            break;
+
+        default:
+            break;
+    }
+
+    return parent_class->pad_event (pad, event);
+}
+
+static gboolean
+src_event (GstPad *pad,
+           GstEvent *event)
+{
+    GstOmxBaseVideoDec *self = GST_OMX_BASE_VIDEODEC (GST_PAD_PARENT (pad));
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_QOS)
+    {
+        gdouble proportion;
+        GstClockTimeDiff diff;
+        GstClockTime timestamp;
+
+        gst_event_parse_qos (event, &proportion, &diff, &timestamp);
+
+        GST_OBJECT_LOCK (self);
+        self->proportion = proportion;
+        if (GST_CLOCK_TIME_IS_VALID (timestamp))
+        {
+            if (diff > 0)
+                self->earliest_time = timestamp + diff;
+            else
+                self->earliest_time = timestamp;
+        }
+        else
+        {
+            self->earliest_time = GST_CLOCK_TIME_NONE;
+        }
+        GST_OBJECT_UNLOCK (self);
+
+        GST_LOG_OBJECT (self, "qos: proportion %f, earliest %" GST_TIME_FORMAT,
+                        proportion, GST_TIME_ARGS (self->earliest_time));
+    }
+
+    return gst_pad_event_default (pad, event);
+}
+
 static void
 omx_setup (GstOmxBaseFilter *omx_base)
 {
@@ -431,6 +707,14 @@ type_instance_init (GTypeInstance *instance,
     omx_base->in_port->share_buffer = FALSE;
     omx_base->out_port->share_buffer = TRUE;
 
+    /* converting means copying, so no sharing of the output buffers: */
+    if (g_getenv ("OMX_CONVERT_ON"))
+    {
+        GST_DEBUG_OBJECT (omx_base, "OMX_CONVERT_ON");
+        GST_OMX_BASE_VIDEODEC (instance)->convert = TRUE;
+        omx_base->out_port->share_buffer = FALSE;
+    }
+
     gst_pad_set_setcaps_function (omx_base->sinkpad,
             GST_DEBUG_FUNCPTR (sink_setcaps));
 
@@ -438,7 +722,9 @@ type_instance_init (GTypeInstance *instance,
             GST_DEBUG_FUNCPTR (src_getcaps));
     gst_pad_set_setcaps_function (omx_base->srcpad,
             GST_DEBUG_FUNCPTR (src_setcaps));
-    gst_pad_set_query_function (omx_base->srcpad,
-            GST_DEBUG_FUNCPTR (src_query));
+    gst_pad_set_event_function (omx_base->srcpad,
+            GST_DEBUG_FUNCPTR (src_event));
+
+    reset_qos (GST_OMX_BASE_VIDEODEC (instance));
 }
 
@@ -29,6 +29,7 @@ G_BEGIN_DECLS
 #define GST_OMX_BASE_VIDEODEC(obj) (GstOmxBaseVideoDec *) (obj)
 #define GST_OMX_BASE_VIDEODEC_TYPE (gst_omx_base_videodec_get_type ())
 #define GST_OMX_BASE_VIDEODEC_CLASS(c) (G_TYPE_CHECK_CLASS_CAST ((c), GST_OMX_BASE_VIDEODEC_TYPE, GstOmxBaseVideoDecClass))
+#define GST_OMX_BASE_VIDEODEC_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_OMX_BASE_VIDEODEC_TYPE, GstOmxBaseVideoDecClass))
 
 typedef struct GstOmxBaseVideoDec GstOmxBaseVideoDec;
 typedef struct GstOmxBaseVideoDecClass GstOmxBaseVideoDecClass;
@@ -46,11 +47,21 @@ struct GstOmxBaseVideoDec
     GstPadSetCapsFunction sink_setcaps;
 
     gint rowstride;     /**< rowstride of output buffer */
+    gboolean convert;   /**< offer other formats than the component's, converting while copying */
+
+    /* QoS, protected by the object lock: */
+    GstSegment segment;
+    gdouble proportion;
+    GstClockTime earliest_time;
+    guint64 dropped;
 };
 
 struct GstOmxBaseVideoDecClass
 {
     GstOmxBaseFilterClass parent_class;
+
+    /** can @buf be skipped without breaking the decoding of other frames */
+    gboolean (*is_droppable) (GstOmxBaseVideoDec *self, GstBuffer *buf);
 };
 
 GType gst_omx_base_videodec_get_type (void);
@@ -160,14 +160,32 @@ sink_setcaps (GstPad *pad,
     {
         /* Output port configuration: */
         OMX_PARAM_PORTDEFINITIONTYPE param;
+        GstVideoFormat omx_format = format;
+        gint omx_rowstride = rowstride;
+        GOmxConvert *convert = NULL;
+
+        if (self->convert && format != GST_VIDEO_FORMAT_NV12 &&
+            !omx_base->in_port->share_buffer)
+        {
+            if (!g_omx_convert_supported (format, GST_VIDEO_FORMAT_NV12))
+            {
+                GST_WARNING_OBJECT (self, "can't convert from %" GST_FOURCC_FORMAT,
+                        GST_FOURCC_ARGS (gst_video_format_to_fourcc (format)));
+                return FALSE;
+            }
+
+            omx_format = GST_VIDEO_FORMAT_NV12;
+            omx_rowstride = gst_video_format_get_row_stride (omx_format, 0, width);
+        }
 
         G_OMX_PORT_GET_DEFINITION (omx_base->in_port, &param);
 
         param.format.video.eColorFormat = g_omx_fourcc_to_colorformat (
-                gst_video_format_to_fourcc (format));
+                gst_video_format_to_fourcc (omx_format));
         param.format.video.nFrameWidth  = width;
         param.format.video.nFrameHeight = height;
-        param.format.video.nStride      = self->rowstride = rowstride;
+        param.format.video.nStride      = omx_rowstride;
+        self->rowstride = rowstride;
 
         if (framerate)
         {
@@ -182,6 +200,37 @@ sink_setcaps (GstPad *pad,
 
         G_OMX_PORT_SET_DEFINITION (omx_base->out_port, &param);
 
+        /* the component may want padded planes (for its 2D buffers, for
+         * instance), then unless the buffers are shared, the picture is
+         * repacked to its stride while copying it:
+         */
+        if (!omx_base->in_port->share_buffer)
+        {
+            gint up_rowstride = rowstride ? rowstride :
+                    gst_video_format_get_row_stride (format, 0, width);
+            gboolean repack = FALSE;
+
+            G_OMX_PORT_GET_DEFINITION (omx_base->in_port, &param);
+
+            if (param.format.video.nStride >= width)
+            {
+                if (param.format.video.nStride != up_rowstride)
+                    repack = TRUE;
+                omx_rowstride = param.format.video.nStride;
+            }
+
+            if (omx_format != format || repack)
+            {
+                convert = g_omx_convert_new (format, rowstride, 0,
+                        omx_format, omx_rowstride, param.format.video.nSliceHeight,
+                        width, height);
+                if (!convert)
+                    return FALSE;
+            }
+        }
+
+        g_omx_port_set_convert (omx_base->in_port, convert);
+
         /* query to find if anyone upstream using these buffers has any
          * minimum requirements:
          */
@@ -336,6 +385,14 @@ type_instance_init (GTypeInstance *instance,
     omx_base->in_port->share_buffer = TRUE;
     omx_base->out_port->share_buffer = FALSE;
 
+    /* converting means copying, so no sharing of the input buffers: */
+    if (g_getenv ("OMX_CONVERT_ON"))
+    {
+        GST_DEBUG_OBJECT (omx_base, "OMX_CONVERT_ON");
+        self->convert = TRUE;
+        omx_base->in_port->share_buffer = FALSE;
+    }
+
     gst_pad_set_setcaps_function (omx_base->sinkpad, sink_setcaps);
 
     self->bitrate = DEFAULT_BITRATE;
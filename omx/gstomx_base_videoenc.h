@@ -45,6 +45,7 @@ struct GstOmxBaseVideoEnc
     GstOmxBaseFilterCb omx_setup;
 
     gint rowstride;     /**< rowstride of input buffer */
+    gboolean convert;   /**< feed the component NV12 whatever the input, converting while copying */
 };
 
 struct GstOmxBaseVideoEncClass
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "gstomx_util.h"
+#include "gstomx_buffer_pool.h"
+#include "gstomx.h"
+
+/*
+ * The buffers of the pool are a GstBuffer subclass which overrides the
+ * finalize method: while the pool is active, instead of freeing the memory
+ * the buffer takes a new reference on itself and goes back to the free
+ * list.  Once the pool is free'd, the buffers are really destroyed as they
+ * come back.
+ */
+
+typedef struct GOmxPoolBuffer GOmxPoolBuffer;
+
+struct GOmxPoolBuffer
+{
+    GstBuffer buffer;
+    GOmxBufferPool *pool;
+};
+
+static GstMiniObjectClass *pool_buffer_parent_class;
+
+static void pool_unref (GOmxBufferPool *pool);
+
+static void
+pool_buffer_finalize (GOmxPoolBuffer *pool_buf)
+{
+    GOmxBufferPool *pool = pool_buf->pool;
+    GstBuffer *buf = GST_BUFFER_CAST (pool_buf);
+
+    g_mutex_lock (pool->lock);
+
+    if (G_LIKELY (pool->active))
+    {
+        /* reset to the state of a fresh buffer: */
+        GST_BUFFER_DATA (buf) = GST_BUFFER_MALLOCDATA (buf);
+        GST_BUFFER_SIZE (buf) = pool->size;
+        GST_BUFFER_TIMESTAMP (buf) = GST_CLOCK_TIME_NONE;
+        GST_BUFFER_DURATION (buf) = GST_CLOCK_TIME_NONE;
+        GST_BUFFER_OFFSET (buf) = GST_BUFFER_OFFSET_NONE;
+        GST_BUFFER_OFFSET_END (buf) = GST_BUFFER_OFFSET_NONE;
+        GST_MINI_OBJECT_FLAGS (buf) = 0;
+        gst_caps_replace (&GST_BUFFER_CAPS (buf), NULL);
+
+        /* resurrect, the free list owns this reference.  It can't be full,
+         * since the pool never allocates more than it can hold.
+         */
+        gst_buffer_ref (buf);
+        if (G_UNLIKELY (!ring_queue_push (pool->free, buf)))
+            g_critical ("buffer pool %p overflow", pool);
+
+        g_mutex_unlock (pool->lock);
+        return;
+    }
+
+    g_mutex_unlock (pool->lock);
+
+    g_atomic_int_add (&pool->allocated, -1);
+
+    pool_buffer_parent_class->finalize (GST_MINI_OBJECT_CAST (buf));
+
+    pool_unref (pool);
+}
+
+static void
+pool_buffer_class_init (gpointer g_class,
+                        gpointer class_data)
+{
+    GstMiniObjectClass *mini_object_class = GST_MINI_OBJECT_CLASS (g_class);
+
+    pool_buffer_parent_class = g_type_class_peek_parent (g_class);
+
+    mini_object_class->finalize = (GstMiniObjectFinalizeFunction) pool_buffer_finalize;
+}
+
+static GType
+pool_buffer_get_type (void)
+{
+    static volatile gsize gonce_data = 0;
+
+    if (g_once_init_enter (&gonce_data))
+    {
+        GType _type;
+        GTypeInfo *type_info;
+
+        type_info = g_new0 (GTypeInfo, 1);
+        type_info->class_size = sizeof (GstBufferClass);
+        type_info->class_init = pool_buffer_class_init;
+        type_info->instance_size = sizeof (GOmxPoolBuffer);
+        _type = g_type_register_static (GST_TYPE_BUFFER, "GOmxPoolBuffer", type_info, 0);
+        g_free (type_info);
+        g_once_init_leave (&gonce_data, (gsize) _type);
+    }
+
+    return (GType) gonce_data;
+}
+
+static GstBuffer *
+pool_buffer_new (GOmxBufferPool *pool)
+{
+    GOmxPoolBuffer *pool_buf;
+    GstBuffer *buf;
+
+    pool_buf = (GOmxPoolBuffer *) gst_mini_object_new (pool_buffer_get_type ());
+    buf = GST_BUFFER_CAST (pool_buf);
+
+    g_atomic_int_inc (&pool->refcount);
+    pool_buf->pool = pool;
+
+    GST_BUFFER_MALLOCDATA (buf) = g_malloc (pool->size);
+    GST_BUFFER_DATA (buf) = GST_BUFFER_MALLOCDATA (buf);
+    GST_BUFFER_SIZE (buf) = pool->size;
+
+    return buf;
+}
+
+static void
+pool_unref (GOmxBufferPool *pool)
+{
+    if (!g_atomic_int_dec_and_test (&pool->refcount))
+        return;
+
+    ring_queue_free (pool->free);
+    g_mutex_free (pool->lock);
+    g_free (pool);
+}
+
+GOmxBufferPool *
+g_omx_buffer_pool_new (guint size,
+                       guint max)
+{
+    GOmxBufferPool *pool = g_new0 (GOmxBufferPool, 1);
+
+    pool->refcount = 1;
+    pool->size = size;
+    pool->max = max;
+    pool->free = ring_queue_new (max);
+    pool->lock = g_mutex_new ();
+    pool->active = TRUE;
+
+    GST_DEBUG ("pool %p: size=%u, max=%u", pool, size, max);
+
+    return pool;
+}
+
+/**
+ * Release the owner's reference to the pool.  Buffers still in use
+ * downstream keep the pool alive, and are free'd when they come back.
+ */
+void
+g_omx_buffer_pool_free (GOmxBufferPool *pool)
+{
+    GstBuffer *buf;
+
+    GST_DEBUG ("pool %p: size=%u, allocated=%d, hits=%d, misses=%d",
+            pool, pool->size, g_atomic_int_get (&pool->allocated),
+            g_atomic_int_get (&pool->hits), g_atomic_int_get (&pool->misses));
+
+    g_mutex_lock (pool->lock);
+    pool->active = FALSE;
+    g_mutex_unlock (pool->lock);
+
+    while ((buf = ring_queue_pop_full (pool->free, FALSE, TRUE)))
+        gst_buffer_unref (buf);
+
+    pool_unref (pool);
+}
+
+/**
+ * Get a buffer of @len bytes from the pool.  Returns <code>NULL</code> if
+ * @len does not fit in the pool buffers, or if too many buffers are already
+ * in use, in which case the caller should fall back to a regular
+ * allocation.
+ */
+GstBuffer *
+g_omx_buffer_pool_get (GOmxBufferPool *pool,
+                       guint len)
+{
+    GstBuffer *buf;
+
+    if (G_UNLIKELY (len > pool->size))
+    {
+        g_atomic_int_inc (&pool->misses);
+        return NULL;
+    }
+
+    buf = ring_queue_pop_full (pool->free, FALSE, TRUE);
+
+    if (G_LIKELY (buf))
+    {
+        g_atomic_int_inc (&pool->hits);
+    }
+    else
+    {
+        g_atomic_int_inc (&pool->misses);
+
+        if (g_atomic_int_exchange_and_add (&pool->allocated, 1) >= (gint) pool->max)
+        {
+            g_atomic_int_add (&pool->allocated, -1);
+            return NULL;
+        }
+
+        buf = pool_buffer_new (pool);
+    }
+
+    GST_BUFFER_SIZE (buf) = len;
+
+    return buf;
+}
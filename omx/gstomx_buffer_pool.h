@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef GSTOMX_BUFFER_POOL_H
+#define GSTOMX_BUFFER_POOL_H
+
+#include <gst/gst.h>
+
+#include "gstomx_util.h"
+
+G_BEGIN_DECLS
+
+/* Structures. */
+
+/**
+ * Pool of equally sized GstBuffers.  Buffers handed out by the pool put
+ * themselves back in the pool when their last reference is dropped, rather
+ * than being free'd, so that the output port does not have to malloc (and
+ * page fault) a new frame sized buffer for every frame it copies out.
+ */
+struct GOmxBufferPool
+{
+    gint refcount;      /**< one for the owner, plus one per allocated buffer */
+
+    guint size;         /**< size of the buffers (nBufferSize of the port) */
+    guint max;          /**< max number of buffers alive at the same time */
+
+    RingQueue *free;    /**< buffers ready for reuse */
+    GMutex *lock;       /**< protects active vs. recycling */
+    gboolean active;
+
+    volatile gint allocated;
+    volatile gint hits;
+    volatile gint misses;
+};
+
+/* Functions. */
+
+GOmxBufferPool * g_omx_buffer_pool_new (guint size, guint max);
+void g_omx_buffer_pool_free (GOmxBufferPool *pool);
+GstBuffer * g_omx_buffer_pool_get (GOmxBufferPool *pool, guint len);
+
+G_END_DECLS
+
+#endif /* GSTOMX_BUFFER_POOL_H */
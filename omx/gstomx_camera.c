@@ -35,7 +35,6 @@
 #include <stdint.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
-#include <linux/timer-32k.h>
 #include <OMX_CoreExt.h>
 #include <OMX_IndexExt.h>
 
@@ -597,8 +596,6 @@ settings_changed_cb (GOmxCore *core)
 static void
 autofocus_cb (GstOmxCamera *self)
 {
-    guint32 autofocus_cb_time;
-
     GstStructure *structure = gst_structure_new ("omx_camera",
             "auto-focus", G_TYPE_BOOLEAN, TRUE, NULL);
 
@@ -607,9 +604,7 @@ autofocus_cb (GstOmxCamera *self)
 
     gst_element_post_message (GST_ELEMENT (self), message);
 
-    autofocus_cb_time = omap_32k_readraw ();
-    GST_CAT_INFO_OBJECT (gstomx_ppm, GST_OBJECT (self), "%d Autofocus locked",
-                         autofocus_cb_time);
+    g_omx_ppm_stop (GST_OMX_BASE_SRC (self)->gomx->ppm, "autofocus");
 }
 
 static void
@@ -765,7 +760,7 @@ start_ports (GstOmxCamera *self)
 #ifdef USE_GSTOMXCAM_IMGSRCPAD
     if (config[self->mode] & PORT_IMAGE)
     {
-        guint32 capture_start_time;
+        GOmxPpm *ppm = GST_OMX_BASE_SRC (self)->gomx->ppm;
 
         GST_DEBUG_OBJECT (self, "enable image port");
         gst_pad_set_active (self->imgsrcpad, TRUE);
@@ -777,9 +772,9 @@ start_ports (GstOmxCamera *self)
 
         GST_DEBUG_OBJECT (self, "image port set_capture set to  %d", TRUE);
 
-        capture_start_time = omap_32k_readraw();
-        GST_CAT_INFO_OBJECT (gstomx_ppm, self, "%d Start Image Capture",
-                             capture_start_time);
+        /* the time between two captures is the shot-to-shot latency: */
+        g_omx_ppm_stop (ppm, "shot-to-shot");
+        g_omx_ppm_start (ppm, "shot-to-shot");
 
         set_capture (self, TRUE);
     }
@@ -33,7 +33,6 @@
 #include <stdint.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
-#include <linux/timer-32k.h>
 #include <OMX_CoreExt.h>
 #include <OMX_IndexExt.h>
 
@@ -531,8 +530,6 @@ set_property (GObject *obj,
 
             if (omx_base->gomx->omx_state == OMX_StateExecuting)
             {
-                guint32 autofocus_start_time;
-
                 focusreq_cb.nPortIndex = OMX_ALL;
                 focusreq_cb.nIndex = OMX_IndexConfigCommonFocusStatus;
 
@@ -553,9 +550,7 @@ set_property (GObject *obj,
 
                     gst_element_post_message (GST_ELEMENT (self), message);
 
-                    autofocus_start_time = omap_32k_readraw ();
-                    GST_CAT_INFO_OBJECT (gstomx_ppm, self,
-                            "%d Autofocus started", autofocus_start_time);
+                    g_omx_ppm_start (gomx->ppm, "autofocus");
                 }
             }
             break;
@@ -0,0 +1,807 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "gstomx_convert.h"
+#include "gstomx.h"
+
+#include <string.h> /* for memcpy */
+#include <stdlib.h> /* for atoi */
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#  define HAVE_SSE2
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#  include <arm_neon.h>
+#  define HAVE_NEON
+#endif
+
+/* NOTE ABOUT CONVERSION KERNELS:
+ *
+ * Everything is done a row at a time, with a vector loop (SSE2 or NEON,
+ * whichever the compiler targets) for the bulk of the row and the plain C
+ * loop for what is left, so the result does not depend on the width or on
+ * the instruction set.  YUV to RGB is BT.601, limited range, in 16 bit fixed
+ * point with 6 fractional bits; the C version computes exactly what the
+ * vector ones do, saturation included.  Chroma is not interpolated: each
+ * sample covers 2x2 pixels.
+ */
+
+/*
+ * Rows.
+ */
+
+static inline void
+deinterleave_row (const guint8 *uv, guint8 *u, guint8 *v, gint n)
+{
+    gint i = 0;
+
+#if defined(HAVE_SSE2)
+    const __m128i mask = _mm_set1_epi16 (0x00ff);
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i a = _mm_loadu_si128 ((const __m128i *) (uv + 2 * i));
+        __m128i b = _mm_loadu_si128 ((const __m128i *) (uv + 2 * i + 16));
+
+        _mm_storeu_si128 ((__m128i *) (u + i),
+                _mm_packus_epi16 (_mm_and_si128 (a, mask), _mm_and_si128 (b, mask)));
+        _mm_storeu_si128 ((__m128i *) (v + i),
+                _mm_packus_epi16 (_mm_srli_epi16 (a, 8), _mm_srli_epi16 (b, 8)));
+    }
+#elif defined(HAVE_NEON)
+    for (; i + 16 <= n; i += 16)
+    {
+        uint8x16x2_t t = vld2q_u8 (uv + 2 * i);
+
+        vst1q_u8 (u + i, t.val[0]);
+        vst1q_u8 (v + i, t.val[1]);
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        u[i] = uv[2 * i];
+        v[i] = uv[2 * i + 1];
+    }
+}
+
+static inline void
+interleave_row (const guint8 *u, const guint8 *v, guint8 *uv, gint n)
+{
+    gint i = 0;
+
+#if defined(HAVE_SSE2)
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i a = _mm_loadu_si128 ((const __m128i *) (u + i));
+        __m128i b = _mm_loadu_si128 ((const __m128i *) (v + i));
+
+        _mm_storeu_si128 ((__m128i *) (uv + 2 * i), _mm_unpacklo_epi8 (a, b));
+        _mm_storeu_si128 ((__m128i *) (uv + 2 * i + 16), _mm_unpackhi_epi8 (a, b));
+    }
+#elif defined(HAVE_NEON)
+    for (; i + 16 <= n; i += 16)
+    {
+        uint8x16x2_t t;
+
+        t.val[0] = vld1q_u8 (u + i);
+        t.val[1] = vld1q_u8 (v + i);
+        vst2q_u8 (uv + 2 * i, t);
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        uv[2 * i] = u[i];
+        uv[2 * i + 1] = v[i];
+    }
+}
+
+/* NV12 row (and its chroma row) to YUY2, or UYVY */
+static inline void
+pack_row (const guint8 *y, const guint8 *uv, guint8 *out, gint width, gboolean uyvy)
+{
+    gint x = 0;
+
+#if defined(HAVE_SSE2)
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i a = _mm_loadu_si128 ((const __m128i *) (y + x));
+        __m128i b = _mm_loadu_si128 ((const __m128i *) (uv + x));
+
+        if (uyvy)
+        {
+            _mm_storeu_si128 ((__m128i *) (out + 2 * x), _mm_unpacklo_epi8 (b, a));
+            _mm_storeu_si128 ((__m128i *) (out + 2 * x + 16), _mm_unpackhi_epi8 (b, a));
+        }
+        else
+        {
+            _mm_storeu_si128 ((__m128i *) (out + 2 * x), _mm_unpacklo_epi8 (a, b));
+            _mm_storeu_si128 ((__m128i *) (out + 2 * x + 16), _mm_unpackhi_epi8 (a, b));
+        }
+    }
+#elif defined(HAVE_NEON)
+    for (; x + 16 <= width; x += 16)
+    {
+        uint8x16x2_t t;
+
+        t.val[uyvy ? 1 : 0] = vld1q_u8 (y + x);
+        t.val[uyvy ? 0 : 1] = vld1q_u8 (uv + x);
+        vst2q_u8 (out + 2 * x, t);
+    }
+#endif
+
+    for (; x < width; x += 2)
+    {
+        guint8 y0 = y[x];
+        guint8 y1 = (x + 1 < width) ? y[x + 1] : y0;
+
+        if (uyvy)
+        {
+            out[2 * x] = uv[x];
+            out[2 * x + 1] = y0;
+            out[2 * x + 2] = uv[x + 1];
+            out[2 * x + 3] = y1;
+        }
+        else
+        {
+            out[2 * x] = y0;
+            out[2 * x + 1] = uv[x];
+            out[2 * x + 2] = y1;
+            out[2 * x + 3] = uv[x + 1];
+        }
+    }
+}
+
+/* YUY2, or UYVY, row to NV12; chroma is only taken when @uv is given */
+static inline void
+unpack_row (const guint8 *in, guint8 *y, guint8 *uv, gint width, gboolean uyvy)
+{
+    gint x = 0;
+
+#if defined(HAVE_SSE2)
+    const __m128i mask = _mm_set1_epi16 (0x00ff);
+
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i a = _mm_loadu_si128 ((const __m128i *) (in + 2 * x));
+        __m128i b = _mm_loadu_si128 ((const __m128i *) (in + 2 * x + 16));
+        __m128i lo = _mm_packus_epi16 (_mm_and_si128 (a, mask), _mm_and_si128 (b, mask));
+        __m128i hi = _mm_packus_epi16 (_mm_srli_epi16 (a, 8), _mm_srli_epi16 (b, 8));
+
+        _mm_storeu_si128 ((__m128i *) (y + x), uyvy ? hi : lo);
+        if (uv)
+            _mm_storeu_si128 ((__m128i *) (uv + x), uyvy ? lo : hi);
+    }
+#elif defined(HAVE_NEON)
+    for (; x + 16 <= width; x += 16)
+    {
+        uint8x16x2_t t = vld2q_u8 (in + 2 * x);
+
+        vst1q_u8 (y + x, t.val[uyvy ? 1 : 0]);
+        if (uv)
+            vst1q_u8 (uv + x, t.val[uyvy ? 0 : 1]);
+    }
+#endif
+
+    for (; x < width; x += 2)
+    {
+        const guint8 *p = in + 2 * x;
+
+        y[x] = p[uyvy ? 1 : 0];
+        if (x + 1 < width)
+            y[x + 1] = p[uyvy ? 3 : 2];
+
+        if (uv)
+        {
+            uv[x] = p[uyvy ? 0 : 1];
+            uv[x + 1] = p[uyvy ? 2 : 3];
+        }
+    }
+}
+
+static inline guint8
+clamp_rgb (gint value)
+{
+    return CLAMP (value >> 6, 0, 255);
+}
+
+/* NV12 row (and its chroma row) to 32 bit RGB, @pos being the byte of R,
+ * G, B and A in a pixel
+ */
+static inline void
+rgb_row (const guint8 *y, const guint8 *uv, guint8 *out, gint width, const gint pos[4])
+{
+    gint x = 0;
+
+#if defined(HAVE_SSE2)
+    const __m128i zero = _mm_setzero_si128 ();
+    const __m128i mask = _mm_set1_epi16 (0x00ff);
+    const __m128i y_off = _mm_set1_epi16 (16);
+    const __m128i c_off = _mm_set1_epi16 (128);
+
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i yv = _mm_loadu_si128 ((const __m128i *) (y + x));
+        __m128i uvv = _mm_loadu_si128 ((const __m128i *) (uv + x));
+        __m128i c[2], d[2], e[2], ch[4], t0, t1, t2, t3;
+        __m128i r[2], g[2], b[2];
+        __m128i dd = _mm_sub_epi16 (_mm_and_si128 (uvv, mask), c_off);
+        __m128i ee = _mm_sub_epi16 (_mm_srli_epi16 (uvv, 8), c_off);
+        gint i;
+
+        c[0] = _mm_mullo_epi16 (_mm_sub_epi16 (_mm_unpacklo_epi8 (yv, zero), y_off), _mm_set1_epi16 (74));
+        c[1] = _mm_mullo_epi16 (_mm_sub_epi16 (_mm_unpackhi_epi8 (yv, zero), y_off), _mm_set1_epi16 (74));
+        d[0] = _mm_unpacklo_epi16 (dd, dd);
+        d[1] = _mm_unpackhi_epi16 (dd, dd);
+        e[0] = _mm_unpacklo_epi16 (ee, ee);
+        e[1] = _mm_unpackhi_epi16 (ee, ee);
+
+        for (i = 0; i < 2; i++)
+        {
+            r[i] = _mm_srai_epi16 (_mm_adds_epi16 (c[i],
+                        _mm_mullo_epi16 (e[i], _mm_set1_epi16 (102))), 6);
+            g[i] = _mm_srai_epi16 (_mm_subs_epi16 (c[i],
+                        _mm_add_epi16 (_mm_mullo_epi16 (d[i], _mm_set1_epi16 (25)),
+                                       _mm_mullo_epi16 (e[i], _mm_set1_epi16 (52)))), 6);
+            b[i] = _mm_srai_epi16 (_mm_adds_epi16 (c[i],
+                        _mm_mullo_epi16 (d[i], _mm_set1_epi16 (129))), 6);
+        }
+
+        ch[pos[0]] = _mm_packus_epi16 (r[0], r[1]);
+        ch[pos[1]] = _mm_packus_epi16 (g[0], g[1]);
+        ch[pos[2]] = _mm_packus_epi16 (b[0], b[1]);
+        ch[pos[3]] = _mm_set1_epi8 ((gchar) 0xff);
+
+        t0 = _mm_unpacklo_epi8 (ch[0], ch[1]);
+        t1 = _mm_unpackhi_epi8 (ch[0], ch[1]);
+        t2 = _mm_unpacklo_epi8 (ch[2], ch[3]);
+        t3 = _mm_unpackhi_epi8 (ch[2], ch[3]);
+
+        _mm_storeu_si128 ((__m128i *) (out + 4 * x), _mm_unpacklo_epi16 (t0, t2));
+        _mm_storeu_si128 ((__m128i *) (out + 4 * x + 16), _mm_unpackhi_epi16 (t0, t2));
+        _mm_storeu_si128 ((__m128i *) (out + 4 * x + 32), _mm_unpacklo_epi16 (t1, t3));
+        _mm_storeu_si128 ((__m128i *) (out + 4 * x + 48), _mm_unpackhi_epi16 (t1, t3));
+    }
+#elif defined(HAVE_NEON)
+    const int16x8_t y_off = vdupq_n_s16 (16);
+    const int16x8_t c_off = vdupq_n_s16 (128);
+
+    for (; x + 8 <= width; x += 8)
+    {
+        int16x8_t c = vmulq_n_s16 (vsubq_s16 (vreinterpretq_s16_u16 (
+                vmovl_u8 (vld1_u8 (y + x))), y_off), 74);
+        int16x8_t uv16 = vsubq_s16 (vreinterpretq_s16_u16 (
+                vmovl_u8 (vld1_u8 (uv + x))), c_off);
+        int16x8x2_t de = vtrnq_s16 (uv16, uv16);
+        int16x8_t d = de.val[0], e = de.val[1];
+        uint8x8x4_t px;
+
+        px.val[pos[0]] = vqmovun_s16 (vshrq_n_s16 (vqaddq_s16 (c,
+                        vmulq_n_s16 (e, 102)), 6));
+        px.val[pos[1]] = vqmovun_s16 (vshrq_n_s16 (vqsubq_s16 (c,
+                        vaddq_s16 (vmulq_n_s16 (d, 25), vmulq_n_s16 (e, 52))), 6));
+        px.val[pos[2]] = vqmovun_s16 (vshrq_n_s16 (vqaddq_s16 (c,
+                        vmulq_n_s16 (d, 129)), 6));
+        px.val[pos[3]] = vdup_n_u8 (0xff);
+
+        vst4_u8 (out + 4 * x, px);
+    }
+#endif
+
+    for (; x < width; x++)
+    {
+        gint c = 74 * (y[x] - 16);
+        gint d = uv[x & ~1] - 128;
+        gint e = uv[x | 1] - 128;
+        guint8 *p = out + 4 * x;
+
+        p[pos[0]] = clamp_rgb (MIN (c + 102 * e, G_MAXINT16));
+        p[pos[1]] = clamp_rgb (MAX (c - 25 * d - 52 * e, G_MININT16));
+        p[pos[2]] = clamp_rgb (MIN (c + 129 * d, G_MAXINT16));
+        p[pos[3]] = 0xff;
+    }
+}
+
+/* with @non_temporal, the stores bypass the cache: for frames much bigger
+ * than the cache, that nobody is going to read on this CPU soon
+ */
+static inline void
+copy_row (guint8 *dest, const guint8 *src, gint n, gboolean non_temporal)
+{
+#if defined(HAVE_SSE2)
+    if (non_temporal && n >= 64)
+    {
+        gint i = (16 - ((gsize) dest & 15)) & 15;
+
+        memcpy (dest, src, i);
+
+        for (; i + 16 <= n; i += 16)
+            _mm_stream_si128 ((__m128i *) (dest + i),
+                    _mm_loadu_si128 ((const __m128i *) (src + i)));
+
+        memcpy (dest + i, src + i, n - i);
+        return;
+    }
+#endif
+
+    memcpy (dest, src, n);
+}
+
+/*
+ * Frames.  Each function does the rows @y0 (even) to @y1 (excluded) of the
+ * picture, and the chroma rows that go with them.
+ */
+
+static void
+nv12_to_i420 (GOmxConvert *convert, guint8 *dest[3], const guint8 *src[3], gint y0, gint y1)
+{
+    gint cw = (convert->width + 1) / 2;
+    gint c0, c1;
+    gint i;
+
+    for (i = y0; i < y1; i++)
+        copy_row (dest[0] + i * convert->out.stride[0],
+                  src[0] + i * convert->in.stride[0], convert->width, FALSE);
+
+    c0 = y0 / 2;
+    c1 = (y1 + 1) / 2;
+
+    for (i = c0; i < c1; i++)
+        deinterleave_row (src[1] + i * convert->in.stride[1],
+                          dest[1] + i * convert->out.stride[1],
+                          dest[2] + i * convert->out.stride[2], cw);
+}
+
+static void
+i420_to_nv12 (GOmxConvert *convert, guint8 *dest[3], const guint8 *src[3], gint y0, gint y1)
+{
+    gint cw = (convert->width + 1) / 2;
+    gint c0, c1;
+    gint i;
+
+    for (i = y0; i < y1; i++)
+        copy_row (dest[0] + i * convert->out.stride[0],
+                  src[0] + i * convert->in.stride[0], convert->width, FALSE);
+
+    c0 = y0 / 2;
+    c1 = (y1 + 1) / 2;
+
+    for (i = c0; i < c1; i++)
+        interleave_row (src[1] + i * convert->in.stride[1],
+                        src[2] + i * convert->in.stride[2],
+                        dest[1] + i * convert->out.stride[1], cw);
+}
+
+static void
+nv12_to_packed (GOmxConvert *convert, guint8 *dest[3], const guint8 *src[3], gint y0, gint y1)
+{
+    gboolean uyvy = (convert->out.format == GST_VIDEO_FORMAT_UYVY);
+    gint i;
+
+    for (i = y0; i < y1; i++)
+        pack_row (src[0] + i * convert->in.stride[0],
+                  src[1] + (i / 2) * convert->in.stride[1],
+                  dest[0] + i * convert->out.stride[0], convert->width, uyvy);
+}
+
+static void
+packed_to_nv12 (GOmxConvert *convert, guint8 *dest[3], const guint8 *src[3], gint y0, gint y1)
+{
+    gboolean uyvy = (convert->in.format == GST_VIDEO_FORMAT_UYVY);
+    gint i;
+
+    /* chroma of the even rows: */
+    for (i = y0; i < y1; i++)
+        unpack_row (src[0] + i * convert->in.stride[0],
+                    dest[0] + i * convert->out.stride[0],
+                    (i & 1) ? NULL : dest[1] + (i / 2) * convert->out.stride[1],
+                    convert->width, uyvy);
+}
+
+static gboolean
+get_rgb_positions (GstVideoFormat format, gint pos[4])
+{
+    static const struct
+    {
+        GstVideoFormat format;
+        gint pos[4];    /* R, G, B, A */
+    } table[] = {
+        { GST_VIDEO_FORMAT_RGBx, { 0, 1, 2, 3 } },
+        { GST_VIDEO_FORMAT_RGBA, { 0, 1, 2, 3 } },
+        { GST_VIDEO_FORMAT_BGRx, { 2, 1, 0, 3 } },
+        { GST_VIDEO_FORMAT_BGRA, { 2, 1, 0, 3 } },
+        { GST_VIDEO_FORMAT_xRGB, { 1, 2, 3, 0 } },
+        { GST_VIDEO_FORMAT_ARGB, { 1, 2, 3, 0 } },
+        { GST_VIDEO_FORMAT_xBGR, { 3, 2, 1, 0 } },
+        { GST_VIDEO_FORMAT_ABGR, { 3, 2, 1, 0 } },
+    };
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (table); i++)
+    {
+        if (table[i].format == format)
+        {
+            memcpy (pos, table[i].pos, sizeof (table[i].pos));
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+nv12_to_rgb (GOmxConvert *convert, guint8 *dest[3], const guint8 *src[3], gint y0, gint y1)
+{
+    gint pos[4];
+    gint i;
+
+    get_rgb_positions (convert->out.format, pos);
+
+    for (i = y0; i < y1; i++)
+        rgb_row (src[0] + i * convert->in.stride[0],
+                 src[1] + (i / 2) * convert->in.stride[1],
+                 dest[0] + i * convert->out.stride[0], convert->width, pos);
+}
+
+static inline gboolean
+is_packed_yuv (GstVideoFormat format)
+{
+    return format == GST_VIDEO_FORMAT_YUY2 || format == GST_VIDEO_FORMAT_UYVY;
+}
+
+static gint
+n_planes (GstVideoFormat format)
+{
+    switch (format)
+    {
+        case GST_VIDEO_FORMAT_NV12:
+            return 2;
+        case GST_VIDEO_FORMAT_I420:
+            return 3;
+        default:
+            return 1;
+    }
+}
+
+/* bytes of picture in a row of @plane */
+static gint
+row_size (GstVideoFormat format, gint plane, gint width)
+{
+    gint cw = (width + 1) / 2;
+
+    switch (format)
+    {
+        case GST_VIDEO_FORMAT_NV12:
+            return plane ? 2 * cw : width;
+        case GST_VIDEO_FORMAT_I420:
+            return plane ? cw : width;
+        case GST_VIDEO_FORMAT_YUY2:
+        case GST_VIDEO_FORMAT_UYVY:
+            return 4 * cw;
+        default:
+            return 4 * width;
+    }
+}
+
+/* same format, different strides (and/or cropping) */
+static void
+repack (GOmxConvert *convert, guint8 *dest[3], const guint8 *src[3], gint y0, gint y1)
+{
+    gint p, i;
+
+    for (p = 0; p < n_planes (convert->in.format); p++)
+    {
+        gint size = row_size (convert->in.format, p, convert->width);
+        gint r0 = p ? y0 / 2 : y0;
+        gint r1 = p ? (y1 + 1) / 2 : y1;
+
+        for (i = r0; i < r1; i++)
+            copy_row (dest[p] + i * convert->out.stride[p],
+                      src[p] + i * convert->in.stride[p], size,
+                      convert->non_temporal);
+    }
+}
+
+static gpointer
+get_func (GstVideoFormat in_format, GstVideoFormat out_format)
+{
+    gint pos[4];
+
+    if (in_format == out_format)
+    {
+        if (in_format == GST_VIDEO_FORMAT_NV12 ||
+            in_format == GST_VIDEO_FORMAT_I420 ||
+            is_packed_yuv (in_format) ||
+            get_rgb_positions (in_format, pos))
+            return repack;
+    }
+    else if (in_format == GST_VIDEO_FORMAT_NV12)
+    {
+        if (out_format == GST_VIDEO_FORMAT_I420)
+            return nv12_to_i420;
+        if (is_packed_yuv (out_format))
+            return nv12_to_packed;
+        if (get_rgb_positions (out_format, pos))
+            return nv12_to_rgb;
+    }
+    else if (out_format == GST_VIDEO_FORMAT_NV12)
+    {
+        if (in_format == GST_VIDEO_FORMAT_I420)
+            return i420_to_nv12;
+        if (is_packed_yuv (in_format))
+            return packed_to_nv12;
+    }
+
+    return NULL;
+}
+
+/* with @stride 0, the default GStreamer layout */
+static void
+setup_frame (GOmxConvertFrame *frame,
+             GstVideoFormat format,
+             gint stride,
+             gint slice,
+             gint width,
+             gint height)
+{
+    gint ch = (height + 1) / 2;
+
+    memset (frame, 0, sizeof (*frame));
+    frame->format = format;
+
+    if (!stride)
+    {
+        gint i;
+
+        for (i = 0; i < n_planes (format); i++)
+        {
+            frame->offset[i] = gst_video_format_get_component_offset (format, i, width, height);
+            frame->stride[i] = gst_video_format_get_row_stride (format, i, width);
+        }
+
+        /* for packed formats, that's the offset of Y within a pixel */
+        frame->offset[0] = 0;
+        frame->size = gst_video_format_get_size (format, width, height);
+        return;
+    }
+
+    if (!slice)
+        slice = height;
+
+    switch (format)
+    {
+        case GST_VIDEO_FORMAT_NV12:
+            frame->offset[1] = stride * slice;
+            frame->stride[0] = frame->stride[1] = stride;
+            frame->size = frame->offset[1] + stride * ch;
+            break;
+        case GST_VIDEO_FORMAT_I420:
+            frame->offset[1] = stride * slice;
+            frame->offset[2] = frame->offset[1] + (stride / 2) * ((slice + 1) / 2);
+            frame->stride[0] = stride;
+            frame->stride[1] = frame->stride[2] = stride / 2;
+            frame->size = frame->offset[2] + (stride / 2) * ch;
+            break;
+        default:
+            frame->stride[0] = stride;
+            frame->size = stride * height;
+            break;
+    }
+}
+
+gboolean
+g_omx_convert_supported (GstVideoFormat in_format,
+                         GstVideoFormat out_format)
+{
+    return get_func (in_format, out_format) != NULL;
+}
+
+/** fewest rows worth giving to another thread */
+#define MIN_BAND_ROWS 64
+
+static void
+run_band (GOmxConvert *convert, gint band)
+{
+    gint y0 = band * convert->band_rows;
+    gint y1 = MIN (y0 + convert->band_rows, convert->height);
+
+    if (y0 < y1)
+        convert->func (convert, convert->dest, convert->src, y0, y1);
+
+#if defined(HAVE_SSE2)
+    /* make the streamed data visible before telling we're done */
+    if (convert->non_temporal)
+        _mm_sfence ();
+#endif
+}
+
+static void
+band_thread (gpointer data,
+             gpointer user_data)
+{
+    GOmxConvert *convert = user_data;
+
+    run_band (convert, GPOINTER_TO_INT (data) - 1);
+    g_sem_up (convert->done);
+}
+
+static void
+setup_bands (GOmxConvert *convert)
+{
+    const gchar *env;
+    gint n_threads;
+
+    env = g_getenv ("OMX_CONVERT_THREADS");
+    n_threads = env ? atoi (env) : 1;
+    n_threads = MAX (MIN (n_threads, convert->height / MIN_BAND_ROWS), 1);
+
+    if (n_threads > 1)
+    {
+        GError *err = NULL;
+
+        convert->pool = g_thread_pool_new (band_thread, convert,
+                                           n_threads - 1, TRUE, &err);
+        if (!convert->pool)
+        {
+            GST_WARNING ("no threads: %s", err->message);
+            g_error_free (err);
+            n_threads = 1;
+        }
+        else
+        {
+            convert->done = g_sem_new ();
+        }
+    }
+
+    convert->n_bands = n_threads;
+    /* an even number of rows, so no chroma row is shared by two bands */
+    convert->band_rows = ((convert->height + n_threads - 1) / n_threads + 1) & ~1;
+}
+
+/**
+ * Set up a conversion of @width x @height frames.  A stride of 0 means
+ * the default layout of GStreamer for the format, otherwise @stride and
+ * @slice (the number of rows of the luma plane, 0 for @height) describe
+ * the planes, as in OMX_VIDEO_PORTDEFINITIONTYPE.
+ *
+ * The frames are split in OMX_CONVERT_THREADS bands done in parallel (1 by
+ * default), and repacking frames of OMX_CONVERT_NT_SIZE bytes or more
+ * bypasses the cache (never, by default), which pays off when the frames
+ * are much bigger than the cache and the CPU does not touch them again.
+ *
+ * Returns <code>NULL</code> if the conversion is not supported.
+ */
+GOmxConvert *
+g_omx_convert_new (GstVideoFormat in_format,
+                   gint in_stride,
+                   gint in_slice,
+                   GstVideoFormat out_format,
+                   gint out_stride,
+                   gint out_slice,
+                   gint width,
+                   gint height)
+{
+    GOmxConvert *convert;
+    gpointer func;
+
+    func = get_func (in_format, out_format);
+    if (!func || width <= 0 || height <= 0)
+        return NULL;
+
+    convert = g_new0 (GOmxConvert, 1);
+    convert->refcount = 1;
+    convert->func = func;
+    convert->width = width;
+    convert->height = height;
+
+    setup_frame (&convert->in, in_format, in_stride, in_slice, width, height);
+    setup_frame (&convert->out, out_format, out_stride, out_slice, width, height);
+
+    {
+        const gchar *env = g_getenv ("OMX_CONVERT_NT_SIZE");
+        gint nt_size = env ? atoi (env) : 0;
+
+        convert->non_temporal = (nt_size > 0 && convert->out.size >= (guint) nt_size);
+    }
+
+    setup_bands (convert);
+
+    GST_DEBUG ("%" GST_FOURCC_FORMAT " (stride %d) -> %" GST_FOURCC_FORMAT " (stride %d), %dx%d, "
+               "%u bands%s",
+               GST_FOURCC_ARGS (gst_video_format_to_fourcc (in_format)), convert->in.stride[0],
+               GST_FOURCC_ARGS (gst_video_format_to_fourcc (out_format)), convert->out.stride[0],
+               width, height, convert->n_bands,
+               convert->non_temporal ? ", non-temporal" : "");
+
+    return convert;
+}
+
+/**
+ * Keep @convert around, ie. while running it outside of the lock that
+ * protects whoever owns it.
+ */
+GOmxConvert *
+g_omx_convert_ref (GOmxConvert *convert)
+{
+    g_atomic_int_inc (&convert->refcount);
+
+    return convert;
+}
+
+void
+g_omx_convert_unref (GOmxConvert *convert)
+{
+    if (!g_atomic_int_dec_and_test (&convert->refcount))
+        return;
+
+    if (convert->pool)
+    {
+        g_thread_pool_free (convert->pool, FALSE, TRUE);
+        g_sem_free (convert->done);
+    }
+
+    g_free (convert);
+}
+
+/**
+ * Convert the frame at @src into @dest, which must hold out.size bytes.
+ * @offset is the nOffset of the OMX buffer: the top-left corner of the
+ * picture within the planes, which is cropped away.
+ *
+ * A given @convert does one frame at a time.
+ */
+void
+g_omx_convert_run (GOmxConvert *convert,
+                   guint8 *dest,
+                   const guint8 *src,
+                   guint offset)
+{
+    const guint8 **src_planes = convert->src;
+    guint8 **dest_planes = convert->dest;
+    gint top = 0, left = 0;
+    guint i;
+
+    if (offset)
+    {
+        top = offset / convert->in.stride[0];
+        left = offset % convert->in.stride[0];
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+        src_planes[i] = src + convert->in.offset[i];
+        dest_planes[i] = dest + convert->out.offset[i];
+
+        if (i == 0)
+            src_planes[i] += offset;
+        else if (convert->in.format == GST_VIDEO_FORMAT_NV12)
+            src_planes[i] += (top / 2) * convert->in.stride[i] + (left & ~1);
+        else
+            src_planes[i] += (top / 2) * convert->in.stride[i] + left / 2;
+    }
+
+    for (i = 1; i < convert->n_bands; i++)
+        g_thread_pool_push (convert->pool, GINT_TO_POINTER (i + 1), NULL);
+
+    run_band (convert, 0);
+
+    for (i = 1; i < convert->n_bands; i++)
+        g_sem_down (convert->done);
+}
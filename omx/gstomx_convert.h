@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef GSTOMX_CONVERT_H
+#define GSTOMX_CONVERT_H
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include "gstomx_util.h"
+
+G_BEGIN_DECLS
+
+/* Structures. */
+
+/**
+ * Layout of the frames on one side of a conversion.  Offsets and strides
+ * of the planes are in bytes, from the start of the frame.
+ */
+typedef struct
+{
+    GstVideoFormat format;
+    gint offset[3];
+    gint stride[3];
+    guint size;
+} GOmxConvertFrame;
+
+/**
+ * Color format conversion between what the OMX component deals with
+ * (always NV12 here) and what the peer element wants, done while copying
+ * the frame anyway, so it costs about the same as the copy itself.
+ *
+ * Supported: NV12 to/from I420, YUY2 and UYVY, and NV12 to 32 bit RGB
+ * (BGRx, RGBx, xRGB, xBGR and their alpha variants).  With the same
+ * format on both sides, the planes are just repacked to the other stride.
+ *
+ * Big frames can be split in bands of rows, done in parallel; see
+ * OMX_CONVERT_THREADS and OMX_CONVERT_NT_SIZE in g_omx_convert_new().
+ */
+struct GOmxConvert
+{
+    GOmxConvertFrame in;
+    GOmxConvertFrame out;
+    gint width;
+    gint height;
+
+    /** does the rows @y0 (even) to @y1 (excluded) */
+    void (*func) (GOmxConvert *convert, guint8 *dest[3], const guint8 *src[3], gint y0, gint y1);
+
+    gboolean non_temporal;  /**< write around the cache when repacking */
+
+    guint n_bands;
+    gint band_rows;
+    GThreadPool *pool;      /**< for all bands but the first */
+    GSem *done;
+    guint8 *dest[3];        /**< planes of the frame being converted */
+    const guint8 *src[3];
+
+    gint refcount;
+};
+
+/* Functions. */
+
+gboolean g_omx_convert_supported (GstVideoFormat in_format, GstVideoFormat out_format);
+GOmxConvert * g_omx_convert_new (GstVideoFormat in_format, gint in_stride, gint in_slice,
+                                 GstVideoFormat out_format, gint out_stride, gint out_slice,
+                                 gint width, gint height);
+GOmxConvert * g_omx_convert_ref (GOmxConvert *convert);
+void g_omx_convert_unref (GOmxConvert *convert);
+void g_omx_convert_run (GOmxConvert *convert, guint8 *dest, const guint8 *src, guint offset);
+
+G_END_DECLS
+
+#endif /* GSTOMX_CONVERT_H */
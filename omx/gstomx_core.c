@@ -21,6 +21,7 @@
  */
 
 #include "gstomx_util.h"
+#include "gstomx_trace.h"
 #include "gstomx.h"
 
 #ifdef USE_OMXTICORE
@@ -41,10 +42,6 @@ static inline void
 change_state (GOmxCore *core,
               OMX_STATETYPE state);
 
-static inline void
-wait_for_state (GOmxCore *core,
-                OMX_STATETYPE state);
-
 static inline void
 in_port_cb (GOmxPort *port,
             OMX_BUFFERHEADERTYPE *omx_buffer);
@@ -148,13 +145,18 @@ g_omx_core_new (gpointer object, gpointer klass)
     core->omx_state_mutex = g_mutex_new ();
 
     core->done_sem = g_sem_new ();
-    core->flush_sem = g_sem_new ();
     core->port_sem = g_sem_new ();
 
     core->omx_state = OMX_StateInvalid;
+    core->pending_state = OMX_StateInvalid;
+    core->state_timeout = G_OMX_CORE_DEFAULT_STATE_TIMEOUT;
 
     core->use_timestamps = TRUE;
 
+    core->parallel_allocate = (g_getenv ("OMX_PARALLEL_ALLOCATE_ON") != NULL);
+
+    core->ppm = g_omx_ppm_new (object);
+
     {
         gchar *library_name, *component_name, *component_role;
 
@@ -183,7 +185,6 @@ g_omx_core_free (GOmxCore *core)
     g_omx_core_deinit (core);     /* just in case we didn't have a READY->NULL.. mainly for gst-inspect */
 
     g_sem_free (core->port_sem);
-    g_sem_free (core->flush_sem);
     g_sem_free (core->done_sem);
 
     g_mutex_free (core->omx_state_mutex);
@@ -191,6 +192,8 @@ g_omx_core_free (GOmxCore *core)
 
     g_ptr_array_free (core->ports, TRUE);
 
+    g_omx_ppm_free (core->ppm);
+
     g_free (core);
 }
 
@@ -198,10 +201,13 @@ void
 g_omx_core_init (GOmxCore *core)
 {
     gchar *library_name=NULL, *component_name=NULL, *component_role=NULL;
+    gchar *key;
 
     if (core->omx_handle)
       return;
 
+    g_omx_ppm_reset (core->ppm);
+
     g_object_get (core->object,
         "component-role", &component_role,
         "component-name", &component_name,
@@ -214,19 +220,55 @@ g_omx_core_init (GOmxCore *core)
     g_return_if_fail (component_name);
     g_return_if_fail (library_name);
 
+    key = g_strdup_printf ("%s/%s/%s", library_name, component_name,
+            component_role ? component_role : "");
+
+    core->handle = g_omx_handle_pool_take (key);
+
+    if (core->handle)
+    {
+        /* the role is already set, and the handle is in Loaded state: */
+        g_atomic_pointer_set ((gpointer *) &core->handle->core, core);
+        core->imp = core->handle->imp;
+        core->omx_handle = core->handle->omx_handle;
+        core->omx_error = OMX_ErrorNone;
+        core->omx_state = OMX_StateLoaded;
+
+        g_free (key);
+        g_free (component_role);
+        g_free (component_name);
+        g_free (library_name);
+        return;
+    }
+
     core->imp = g_omx_request_imp (library_name);
 
     if (!core->imp)
+    {
+        g_free (key);
         return;
+    }
+
+    core->handle = g_omx_handle_new (core->imp, key);
+    core->handle->core = core;
+    g_free (key);
 
     core->omx_error = core->imp->sym_table.get_handle (&core->omx_handle,
                                                        (char *) component_name,
-                                                       core,
+                                                       core->handle,
                                                        &callbacks);
 
     GST_DEBUG_OBJECT (core->object, "OMX_GetHandle(&%p) -> %s",
         core->omx_handle, g_omx_error_to_str (core->omx_error));
 
+    core->handle->omx_handle = core->omx_handle;
+
+    if (!core->omx_handle)
+    {
+        g_omx_handle_free (core->handle);
+        core->handle = NULL;
+    }
+
     g_return_if_fail (core->omx_handle);
 
     if (component_role)
@@ -257,25 +299,78 @@ g_omx_core_init (GOmxCore *core)
 void
 g_omx_core_deinit (GOmxCore *core)
 {
+    gboolean tunneled = FALSE;
+    guint index;
+
+    g_omx_ppm_report (core->ppm);
+
     if (!core->imp)
         return;
 
+    /* left on the way to Loaded by g_omx_core_unload(), for a tunnel peer to
+     * get there too; give it the time to, before tearing down the tunnel:
+     */
+    if (core->omx_state != OMX_StateLoaded &&
+        core->omx_state != OMX_StateInvalid &&
+        core->pending_state == OMX_StateLoaded)
+    {
+        g_omx_core_wait_for_state (core, OMX_StateLoaded);
+    }
+
+    /* the component only forgets about a tunnel if both sides are in
+     * Loaded, see g_omx_port_teardown_tunnel():
+     */
+    for (index = 0; index < core->ports->len; index++)
+    {
+        GOmxPort *port = get_port (core, index);
+
+        if (port && port->tunnel &&
+            port->tunnel->core->omx_state != OMX_StateLoaded)
+            tunneled = TRUE;
+    }
+
     core_for_each_port (core, g_omx_port_free);
     g_ptr_array_clear (core->ports);
 
-    if (core->omx_state == OMX_StateLoaded ||
-        core->omx_state == OMX_StateInvalid)
+    if (core->omx_handle)
     {
-        if (core->omx_handle)
+        /* only a clean handle goes back to the pool, not one still
+         * tunneled; any other one is freed whatever its state, rather than
+         * leaked:
+         */
+        if (core->omx_state == OMX_StateLoaded &&
+            core->omx_error == OMX_ErrorNone && !tunneled &&
+            g_omx_handle_pool_put (core->handle))
+        {
+            /* the pool took over our reference on the imp: */
+            core->imp = NULL;
+        }
+        else
         {
+            if (core->omx_state != OMX_StateLoaded &&
+                core->omx_state != OMX_StateInvalid)
+            {
+                GST_WARNING_OBJECT (core->object, "freeing handle in state %d",
+                                    core->omx_state);
+            }
+
             core->omx_error = core->imp->sym_table.free_handle (core->omx_handle);
             GST_DEBUG_OBJECT (core->object, "OMX_FreeHandle(%p) -> %s",
                 core->omx_handle, g_omx_error_to_str (core->omx_error));
-            core->omx_handle = NULL;
+            g_omx_handle_free (core->handle);
         }
+        core->handle = NULL;
+        core->omx_handle = NULL;
+    }
+
+    if (core->resource)
+    {
+        g_omx_release_resource (core->resource);
+        core->resource = NULL;
     }
 
-    g_omx_release_imp (core->imp);
+    if (core->imp)
+        g_omx_release_imp (core->imp);
     core->imp = NULL;
 }
 
@@ -295,20 +390,157 @@ port_allocate_buffers (GOmxPort *port)
         g_omx_port_allocate_buffers (port);
 }
 
+/* how much of the hardware the component will take with the current port
+ * settings, see NOTE ABOUT RESOURCES in gstomx_util.c
+ */
+static guint64
+core_resource_cost (GOmxCore *core)
+{
+    guint64 cost = 0;
+    guint index;
+
+    for (index = 0; index < core->ports->len; index++)
+    {
+        GOmxPort *port = get_port (core, index);
+        OMX_PARAM_PORTDEFINITIONTYPE param;
+        guint64 mbs;
+        guint fps;
+
+        if (!port || !port->enabled)
+            continue;
+
+        G_OMX_PORT_GET_DEFINITION (port, &param);
+
+        if (param.eDomain != OMX_PortDomainVideo)
+            continue;
+
+        mbs = ((param.format.video.nFrameWidth + 15) / 16) *
+              ((param.format.video.nFrameHeight + 15) / 16);
+
+        /* xFramerate is Q16, and often not set on decoders: */
+        fps = param.format.video.xFramerate >> 16;
+        if (!fps)
+            fps = 30;
+
+        cost = MAX (cost, mbs * fps);
+    }
+
+    return cost ? cost : 1;
+}
+
+static gboolean
+core_request_resource (GOmxCore *core)
+{
+    gchar *component_name = NULL;
+
+    if (core->resource)
+        return TRUE;
+
+    g_object_get (core->object, "component-name", &component_name, NULL);
+
+    core->resource = g_omx_request_resource (component_name,
+            core_resource_cost (core), core->priority);
+
+    g_free (component_name);
+
+    return (core->resource != NULL);
+}
+
+static gpointer
+allocate_thread (gpointer data)
+{
+    port_allocate_buffers ((GOmxPort *) data);
+    return NULL;
+}
+
+/* NOTE ABOUT PARALLEL ALLOCATION: the ports are allocated one after the
+ * other, one buffer at a time, which can take a while with many ports or
+ * big buffers.  Per the spec a component should cope with calls on
+ * different ports from different threads, but not all of them do, so
+ * allocating each port in its own thread is only done when the
+ * OMX_PARALLEL_ALLOCATE_ON env variable is set.
+ */
+static void
+core_allocate_buffers (GOmxCore *core)
+{
+    GThread **threads;
+    guint index;
+
+    if (!core->parallel_allocate || core->ports->len < 2)
+    {
+        core_for_each_port (core, port_allocate_buffers);
+        return;
+    }
+
+    threads = g_new0 (GThread *, core->ports->len);
+
+    for (index = 0; index < core->ports->len; index++)
+    {
+        GOmxPort *port = get_port (core, index);
+        GError *err = NULL;
+
+        if (!port || !port->enabled || port->buffers)
+            continue;
+
+        threads[index] = g_thread_create (allocate_thread, port, TRUE, &err);
+
+        if (!threads[index])
+        {
+            GST_WARNING_OBJECT (core->object, "could not create thread: %s",
+                                err->message);
+            g_error_free (err);
+            port_allocate_buffers (port);
+        }
+    }
+
+    for (index = 0; index < core->ports->len; index++)
+    {
+        if (threads[index])
+            g_thread_join (threads[index]);
+    }
+
+    g_free (threads);
+}
+
+/**
+ * Start the transition to Idle (and allocate the buffers that requires),
+ * without waiting for the component to get there, so the caller can do
+ * something else meanwhile.  Use g_omx_core_wait_for_state() before
+ * g_omx_core_start().
+ */
 void
-g_omx_core_prepare (GOmxCore *core)
+g_omx_core_prepare_async (GOmxCore *core,
+                          GOmxStateCb cb,
+                          gpointer data)
 {
     GST_DEBUG_OBJECT (core->object, "begin");
 
     /* Prepare port */
     core_for_each_port (core, port_prepare);
 
-    change_state (core, OMX_StateIdle);
+    if (!core_request_resource (core))
+    {
+        GST_ERROR_OBJECT (core->object, "not enough resources");
+        core->omx_error = OMX_ErrorInsufficientResources;
+        if (cb)
+            cb (core, core->omx_state, data);
+        return;
+    }
+
+    g_omx_core_request_state (core, OMX_StateIdle, cb, data);
 
     /* Allocate buffers. */
-    core_for_each_port (core, port_allocate_buffers);
+    core_allocate_buffers (core);
+
+    GST_DEBUG_OBJECT (core->object, "end");
+}
 
-    wait_for_state (core, OMX_StateIdle);
+void
+g_omx_core_prepare (GOmxCore *core)
+{
+    GST_DEBUG_OBJECT (core->object, "begin");
+    g_omx_core_prepare_async (core, NULL, NULL);
+    g_omx_core_wait_for_state (core, OMX_StateIdle);
     GST_DEBUG_OBJECT (core->object, "end");
 }
 
@@ -317,7 +549,7 @@ g_omx_core_start (GOmxCore *core)
 {
     GST_DEBUG_OBJECT (core->object, "begin");
     change_state (core, OMX_StateExecuting);
-    wait_for_state (core, OMX_StateExecuting);
+    g_omx_core_wait_for_state (core, OMX_StateExecuting);
 
     if (core->omx_state == OMX_StateExecuting)
         core_for_each_port (core, g_omx_port_start_buffers);
@@ -332,7 +564,7 @@ g_omx_core_stop (GOmxCore *core)
         core->omx_state == OMX_StatePause)
     {
         change_state (core, OMX_StateIdle);
-        wait_for_state (core, OMX_StateIdle);
+        g_omx_core_wait_for_state (core, OMX_StateIdle);
     }
     GST_DEBUG_OBJECT (core->object, "end");
 }
@@ -342,14 +574,57 @@ g_omx_core_pause (GOmxCore *core)
 {
     GST_DEBUG_OBJECT (core->object, "begin");
     change_state (core, OMX_StatePause);
-    wait_for_state (core, OMX_StatePause);
+    g_omx_core_wait_for_state (core, OMX_StatePause);
     GST_DEBUG_OBJECT (core->object, "end");
 }
 
+/* see NOTE ABOUT TUNNELS in gstomx_port.c: the buffers of a tunnel are
+ * freed while both components go to Loaded, so the first one to unload
+ * can't wait for it, and the second one waits for both.
+ */
+static gboolean
+core_tunnel_pending (GOmxCore *core)
+{
+    guint index;
+
+    for (index = 0; index < core->ports->len; index++)
+    {
+        GOmxPort *port = get_port (core, index);
+        GOmxCore *peer;
+
+        if (!port || !port->tunnel)
+            continue;
+
+        peer = port->tunnel->core;
+
+        if (peer->omx_state != OMX_StateLoaded &&
+            peer->omx_state != OMX_StateInvalid &&
+            peer->pending_state != OMX_StateLoaded)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+port_wait_tunnel_unload (GOmxPort *port)
+{
+    if (port->tunnel && port->tunnel->core->pending_state == OMX_StateLoaded)
+        g_omx_core_wait_for_state (port->tunnel->core, OMX_StateLoaded);
+}
+
 void
 g_omx_core_unload (GOmxCore *core)
 {
     GST_DEBUG_OBJECT (core->object, "begin");
+
+    /* finish an asynchronous prepare first: */
+    if (core->omx_state == OMX_StateLoaded &&
+        core->pending_state == OMX_StateIdle)
+    {
+        g_omx_core_wait_for_state (core, OMX_StateIdle);
+    }
+
     if (core->omx_state == OMX_StateIdle ||
         core->omx_state == OMX_StateWaitForResources ||
         core->omx_state == OMX_StateInvalid)
@@ -359,8 +634,19 @@ g_omx_core_unload (GOmxCore *core)
 
         core_for_each_port (core, g_omx_port_free_buffers);
 
-        if (core->omx_state != OMX_StateInvalid)
-            wait_for_state (core, OMX_StateLoaded);
+        /* a tunnel peer still to unload takes us the rest of the way: */
+        if (core->omx_state != OMX_StateInvalid && !core_tunnel_pending (core))
+        {
+            g_omx_core_wait_for_state (core, OMX_StateLoaded);
+            core_for_each_port (core, port_wait_tunnel_unload);
+        }
+    }
+
+    /* the hardware is free again once in Loaded: */
+    if (core->resource && core->omx_state == OMX_StateLoaded)
+    {
+        g_omx_release_resource (core->resource);
+        core->resource = NULL;
     }
     GST_DEBUG_OBJECT (core->object, "end");
 }
@@ -418,11 +704,181 @@ void
 g_omx_core_flush_stop (GOmxCore *core)
 {
     GST_DEBUG_OBJECT (core->object, "begin");
-    core_for_each_port (core, g_omx_port_flush);
+    g_omx_core_flush (core);
     core_for_each_port (core, g_omx_port_resume);
     GST_DEBUG_OBJECT (core->object, "end");
 }
 
+/* called with omx_state_mutex */
+static inline gboolean
+core_flushing (GOmxCore *core)
+{
+    guint index;
+
+    for (index = 0; index < core->ports->len; index++)
+    {
+        GOmxPort *port = get_port (core, index);
+
+        if (port && port->flushing)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* NOTE ABOUT FLUSHING: all the ports are flushed with a single
+ * OMX_CommandFlush on OMX_ALL, for which the component completes each port
+ * on its own, so the flush takes as long as the slowest port rather than
+ * the sum of all of them.  By the time a port is completed, the component
+ * has given back all its buffers, so whatever is in our queues then is
+ * stale and every buffer is ours (see g_omx_port_flush).
+ */
+
+/* called with omx_state_mutex */
+static inline void
+core_clear_flushing (GOmxCore *core)
+{
+    guint index;
+
+    for (index = 0; index < core->ports->len; index++)
+    {
+        GOmxPort *port = get_port (core, index);
+
+        if (port)
+            port->flushing = FALSE;
+    }
+}
+
+/**
+ * Flush all the enabled ports, and wait (at most state_timeout ms) for
+ * the component to be done with it.  The ports should be paused (see
+ * g_omx_core_flush_start) so nobody waits on them meanwhile.  Nothing is
+ * done unless the component is in Idle, Executing or Pause state, since
+ * it has no buffers to give back otherwise.
+ *
+ * Returns FALSE if the component refused the flush, or did not complete
+ * it in time.
+ */
+gboolean
+g_omx_core_flush (GOmxCore *core)
+{
+    GTimeVal tv;
+    gboolean ret = TRUE;
+    OMX_ERRORTYPE omx_error;
+    guint index;
+
+    GST_DEBUG_OBJECT (core->object, "begin");
+
+    if (core->omx_state != OMX_StateIdle &&
+        core->omx_state != OMX_StateExecuting &&
+        core->omx_state != OMX_StatePause)
+    {
+        GST_DEBUG_OBJECT (core->object, "nothing to flush in state %d",
+                          core->omx_state);
+        return TRUE;
+    }
+
+    g_mutex_lock (core->omx_state_mutex);
+    for (index = 0; index < core->ports->len; index++)
+    {
+        GOmxPort *port = get_port (core, index);
+
+        if (port)
+            port->flushing = port->enabled;
+    }
+    g_mutex_unlock (core->omx_state_mutex);
+
+    GST_DEBUG_OBJECT (core->object, "SendCommand(Flush, OMX_ALL)");
+    omx_error = OMX_SendCommand (core->omx_handle, OMX_CommandFlush, OMX_ALL, NULL);
+
+    g_mutex_lock (core->omx_state_mutex);
+
+    if (omx_error != OMX_ErrorNone)
+    {
+        GST_ERROR_OBJECT (core->object, "flush failed: %s",
+                          g_omx_error_to_str (omx_error));
+        core_clear_flushing (core);
+        g_mutex_unlock (core->omx_state_mutex);
+        return FALSE;
+    }
+
+    g_get_current_time (&tv);
+    g_time_val_add (&tv, (glong) core->state_timeout * 1000);
+
+    while (core_flushing (core) && core->omx_error == OMX_ErrorNone)
+    {
+        if (!g_cond_timed_wait (core->omx_state_condition, core->omx_state_mutex, &tv))
+        {
+            GST_ERROR_OBJECT (core->object, "flush timed out");
+            core_clear_flushing (core);
+            ret = FALSE;
+            break;
+        }
+    }
+
+    g_mutex_unlock (core->omx_state_mutex);
+
+    core_for_each_port (core, g_omx_port_flush);
+
+    GST_DEBUG_OBJECT (core->object, "end");
+
+    return ret;
+}
+
+/* the component completed the flush of port @index, or of all of them */
+static void
+complete_flush (GOmxCore *core,
+                guint index)
+{
+    guint i;
+
+    GST_DEBUG_OBJECT (core->object, "flushed port %d", index);
+
+    g_mutex_lock (core->omx_state_mutex);
+
+    for (i = 0; i < core->ports->len; i++)
+    {
+        GOmxPort *port = get_port (core, i);
+
+        if (port && (index == OMX_ALL || port->port_index == index))
+            port->flushing = FALSE;
+    }
+
+    g_cond_broadcast (core->omx_state_condition);
+
+    g_mutex_unlock (core->omx_state_mutex);
+}
+
+/**
+ * Counters of all the ports, as a structure holding one "omx-port-stats"
+ * structure per port, named after the port.
+ */
+GstStructure *
+g_omx_core_get_stats (GOmxCore *core)
+{
+    GstStructure *stats;
+    guint index;
+
+    stats = gst_structure_new ("omx-stats",
+            "state", G_TYPE_INT, core->omx_state,
+            NULL);
+
+    for (index = 0; index < core->ports->len; index++)
+    {
+        GOmxPort *port = get_port (core, index);
+        GstStructure *port_stats;
+
+        if (!port)
+            continue;
+
+        port_stats = g_omx_port_get_stats (port);
+        gst_structure_set (stats, port->name, GST_TYPE_STRUCTURE, port_stats, NULL);
+        gst_structure_free (port_stats);
+    }
+
+    return stats;
+}
+
 /**
  * Accessor for OMX component handle.  If the OMX component is not constructed
  * yet, this will trigger it to be constructed (OMX_GetHandle()).  This should
@@ -446,60 +902,127 @@ static inline void
 change_state (GOmxCore *core,
               OMX_STATETYPE state)
 {
-    GST_DEBUG_OBJECT (core->object, "state=%d", state);
-    OMX_SendCommand (core->omx_handle, OMX_CommandStateSet, state, NULL);
+    g_omx_core_request_state (core, state, NULL, NULL);
+}
+
+/* called with omx_state_mutex, returns the callback to call (without the
+ * lock) if any
+ */
+static inline GOmxStateCb
+take_state_cb (GOmxCore *core,
+               gpointer *data)
+{
+    GOmxStateCb cb = core->state_cb;
+
+    *data = core->state_cb_data;
+
+    core->pending_state = OMX_StateInvalid;
+    core->state_cb = NULL;
+    core->state_cb_data = NULL;
+
+    return cb;
+}
+
+/** name of the ppm span of a transition to @state */
+static const gchar *
+state_span (OMX_STATETYPE state)
+{
+    switch (state)
+    {
+        case OMX_StateLoaded:    return "to-loaded";
+        case OMX_StateIdle:      return "to-idle";
+        case OMX_StateExecuting: return "to-executing";
+        case OMX_StatePause:     return "to-pause";
+        default:                 return "to-other";
+    }
 }
 
 static inline void
 complete_change_state (GOmxCore *core,
                        OMX_STATETYPE state)
 {
+    GOmxStateCb cb = NULL;
+    gpointer data;
+
     g_mutex_lock (core->omx_state_mutex);
 
     core->omx_state = state;
-    g_cond_signal (core->omx_state_condition);
+    if (core->pending_state == state)
+        cb = take_state_cb (core, &data);
+    g_cond_broadcast (core->omx_state_condition);
     GST_DEBUG_OBJECT (core->object, "state=%d", state);
 
     g_mutex_unlock (core->omx_state_mutex);
+
+    g_omx_ppm_stop (core->ppm, state_span (state));
+
+    if (cb)
+        cb (core, state, data);
 }
 
-static inline void
-wait_for_state (GOmxCore *core,
-                OMX_STATETYPE state)
+/**
+ * Ask the component to go to @state, but don't wait for it.  If not NULL,
+ * @cb is called once the component got there, or failed to (so check the
+ * state passed to it).  It is called from the OMX callback thread, so it
+ * must not call back into the component; it should rather just wake up or
+ * schedule whoever is waiting on it.
+ */
+void
+g_omx_core_request_state (GOmxCore *core,
+                          OMX_STATETYPE state,
+                          GOmxStateCb cb,
+                          gpointer data)
 {
-    GTimeVal tv;
-    gboolean signaled;
+    GST_DEBUG_OBJECT (core->object, "state=%d", state);
 
     g_mutex_lock (core->omx_state_mutex);
+    core->pending_state = state;
+    core->state_cb = cb;
+    core->state_cb_data = data;
+    g_mutex_unlock (core->omx_state_mutex);
 
-    if (core->omx_error != OMX_ErrorNone)
-        goto leave;
+    g_omx_ppm_start (core->ppm, state_span (state));
+
+    OMX_SendCommand (core->omx_handle, OMX_CommandStateSet, state, NULL);
+}
+
+/**
+ * Wait for the component to reach @state, at most state_timeout ms.
+ *
+ * Returns TRUE if the component is in @state.
+ */
+gboolean
+g_omx_core_wait_for_state (GOmxCore *core,
+                           OMX_STATETYPE state)
+{
+    GTimeVal tv;
+    gboolean ret;
+
+    g_mutex_lock (core->omx_state_mutex);
 
     g_get_current_time (&tv);
-    g_time_val_add (&tv, 100000000);
+    g_time_val_add (&tv, (glong) core->state_timeout * 1000);
 
-    /* try once */
-    if (core->omx_state != state)
+    while (core->omx_state != state && core->omx_error == OMX_ErrorNone)
     {
-        signaled = g_cond_timed_wait (core->omx_state_condition, core->omx_state_mutex, &tv);
-
-        if (!signaled)
+        if (!g_cond_timed_wait (core->omx_state_condition, core->omx_state_mutex, &tv))
         {
             GST_ERROR_OBJECT (core->object, "timed out");
+            break;
         }
     }
 
-    if (core->omx_error != OMX_ErrorNone)
-        goto leave;
+    ret = (core->omx_state == state);
 
-    if (core->omx_state != state)
+    if (!ret && core->omx_error == OMX_ErrorNone)
     {
         GST_ERROR_OBJECT (core->object, "wrong state received: state=%d, expected=%d",
                           core->omx_state, state);
     }
 
-leave:
     g_mutex_unlock (core->omx_state_mutex);
+
+    return ret;
 }
 
 /*
@@ -546,6 +1069,13 @@ g_omx_core_got_buffer (GOmxCore *core,
 
     if (G_LIKELY (port))
     {
+        /* not ours to queue, this gives it back to the upstream component: */
+        if (G_UNLIKELY (port->imported) &&
+            g_omx_port_release_imported (port, omx_buffer))
+        {
+            return;
+        }
+
         g_omx_port_push_buffer (port, omx_buffer);
 
         switch (port->type)
@@ -576,7 +1106,11 @@ EventHandler (OMX_HANDLETYPE omx_handle,
 {
     GOmxCore *core;
 
-    core = (GOmxCore *) app_data;
+    core = g_atomic_pointer_get ((gpointer *) &((GOmxHandle *) app_data)->core);
+
+    /* idle in the handle pool, nobody to tell: */
+    if (!core)
+        return OMX_ErrorNone;
 
     switch (event)
     {
@@ -594,7 +1128,7 @@ EventHandler (OMX_HANDLETYPE omx_handle,
                         complete_change_state (core, data_2);
                         break;
                     case OMX_CommandFlush:
-                        g_sem_up (core->flush_sem);
+                        complete_flush (core, data_2);
                         break;
                     case OMX_CommandPortDisable:
                     case OMX_CommandPortEnable:
@@ -640,10 +1174,20 @@ EventHandler (OMX_HANDLETYPE omx_handle,
                                   g_omx_error_to_str (data_1), data_1);
                 /* component might leave us waiting for buffers, unblock */
                 g_omx_core_flush_start (core);
-                /* unlock wait_for_state */
-                g_mutex_lock (core->omx_state_mutex);
-                g_cond_signal (core->omx_state_condition);
-                g_mutex_unlock (core->omx_state_mutex);
+                /* unlock wait_for_state, and whoever waits for a state */
+                {
+                    GOmxStateCb cb = NULL;
+                    gpointer cb_data;
+
+                    g_mutex_lock (core->omx_state_mutex);
+                    if (core->pending_state != OMX_StateInvalid)
+                        cb = take_state_cb (core, &cb_data);
+                    g_cond_broadcast (core->omx_state_condition);
+                    g_mutex_unlock (core->omx_state_mutex);
+
+                    if (cb)
+                        cb (core, core->omx_state, cb_data);
+                }
                 break;
             }
 #ifdef USE_OMXTICORE
@@ -681,9 +1225,20 @@ EmptyBufferDone (OMX_HANDLETYPE omx_handle,
 
     g_return_val_if_fail (omx_buffer, OMX_ErrorBadParameter);
 
-    core = (GOmxCore*) app_data;
+    core = g_atomic_pointer_get ((gpointer *) &((GOmxHandle *) app_data)->core);
+
+    /* a late one, the handle went back to the pool meanwhile: */
+    if (!core)
+        return OMX_ErrorNone;
+
     port = get_port (core, omx_buffer->nInputPortIndex);
 
+    if (G_LIKELY (port))
+    {
+        g_atomic_int_inc (&port->stats.ebd);
+        G_OMX_TRACE (port, G_OMX_TRACE_EBD, omx_buffer);
+    }
+
     GST_DEBUG_OBJECT (core->object, "EBD: omx_buffer=%p, pAppPrivate=%p, pBuffer=%p",
             omx_buffer, omx_buffer->pAppPrivate, omx_buffer->pBuffer);
 
@@ -702,9 +1257,20 @@ FillBufferDone (OMX_HANDLETYPE omx_handle,
 
     g_return_val_if_fail (omx_buffer, OMX_ErrorBadParameter);
 
-    core = (GOmxCore *) app_data;
+    core = g_atomic_pointer_get ((gpointer *) &((GOmxHandle *) app_data)->core);
+
+    /* a late one, the handle went back to the pool meanwhile: */
+    if (!core)
+        return OMX_ErrorNone;
+
     port = get_port (core, omx_buffer->nOutputPortIndex);
 
+    if (G_LIKELY (port))
+    {
+        g_atomic_int_inc (&port->stats.fbd);
+        G_OMX_TRACE (port, G_OMX_TRACE_FBD, omx_buffer);
+    }
+
     GST_DEBUG_OBJECT (core->object, "FBD: omx_buffer=%p, pAppPrivate=%p, pBuffer=%p",
             omx_buffer, omx_buffer->pAppPrivate, omx_buffer->pBuffer);
 
@@ -24,6 +24,7 @@
 #define GSTOMX_CORE_H
 
 #include "gstomx_util.h"
+#include "gstomx_ppm.h"
 
 G_BEGIN_DECLS
 
@@ -31,6 +32,10 @@ G_BEGIN_DECLS
 
 typedef void (*GOmxCb) (GOmxCore *core);
 typedef void (*GOmxCbargs2) (GOmxCore *core, gint data1, gint data2);
+typedef void (*GOmxStateCb) (GOmxCore *core, OMX_STATETYPE state, gpointer data);
+
+/** default for GOmxCore::state_timeout */
+#define G_OMX_CORE_DEFAULT_STATE_TIMEOUT 100000
 
 /* Structures. */
 
@@ -39,16 +44,21 @@ struct GOmxCore
     gpointer object; /**< GStreamer element. */
 
     OMX_HANDLETYPE omx_handle;
+    GOmxHandle *handle;     /**< app_data of omx_handle */
     OMX_ERRORTYPE omx_error;
 
     OMX_STATETYPE omx_state;
     GCond *omx_state_condition;
     GMutex *omx_state_mutex;
 
+    OMX_STATETYPE pending_state; /**< requested state, or OMX_StateInvalid */
+    GOmxStateCb state_cb;
+    gpointer state_cb_data;
+    guint state_timeout;         /**< in ms */
+
     GPtrArray *ports;
 
     GSem *done_sem;
-    GSem *flush_sem;
     GSem *port_sem;
 
     GOmxCb settings_changed_cb;
@@ -58,6 +68,13 @@ struct GOmxCore
 
     gboolean done;
 
+    gboolean parallel_allocate; /**< allocate the buffers of each port in its own thread */
+
+    ResourceSession *resource;  /**< our share of the hardware, while not Loaded */
+    gint priority;              /**< for getting it when it is scarce */
+
+    GOmxPpm *ppm;               /**< performance markers */
+
     gboolean use_timestamps; /** @todo remove; timestamps should always be used */
 };
 
@@ -96,6 +113,9 @@ void g_omx_core_free (GOmxCore *core);
 void g_omx_core_init (GOmxCore *core);
 void g_omx_core_deinit (GOmxCore *core);
 void g_omx_core_prepare (GOmxCore *core);
+void g_omx_core_prepare_async (GOmxCore *core, GOmxStateCb cb, gpointer data);
+void g_omx_core_request_state (GOmxCore *core, OMX_STATETYPE state, GOmxStateCb cb, gpointer data);
+gboolean g_omx_core_wait_for_state (GOmxCore *core, OMX_STATETYPE state);
 void g_omx_core_start (GOmxCore *core);
 void g_omx_core_pause (GOmxCore *core);
 void g_omx_core_stop (GOmxCore *core);
@@ -104,7 +124,9 @@ void g_omx_core_set_done (GOmxCore *core);
 void g_omx_core_wait_for_done (GOmxCore *core);
 void g_omx_core_flush_start (GOmxCore *core);
 void g_omx_core_flush_stop (GOmxCore *core);
+gboolean g_omx_core_flush (GOmxCore *core);
 OMX_HANDLETYPE g_omx_core_get_handle (GOmxCore *core);
+GstStructure *g_omx_core_get_stats (GOmxCore *core);
 GOmxPort *g_omx_core_get_port (GOmxCore *core, const gchar *name, guint index);
 
 /* Friend:  helpers used by GOmxPort */
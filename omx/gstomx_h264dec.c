@@ -72,10 +72,71 @@ type_base_init (gpointer g_class)
     }
 }
 
+/**
+ * Non-reference pictures (nal_ref_idc == 0) can be skipped.  The stream is
+ * either in byte-stream format, or in AVC format when there is codec_data.
+ */
+static gboolean
+is_droppable (GstOmxBaseVideoDec *self,
+              GstBuffer *buf)
+{
+    GstBuffer *codec_data = GST_OMX_BASE_FILTER (self)->codec_data;
+    const guint8 *data = GST_BUFFER_DATA (buf);
+    guint size = GST_BUFFER_SIZE (buf);
+    guint length_size = 0;
+    guint pos = 0;
+
+    if (codec_data && GST_BUFFER_SIZE (codec_data) > 4 &&
+        GST_BUFFER_DATA (codec_data)[0] == 1)
+    {
+        length_size = (GST_BUFFER_DATA (codec_data)[4] & 0x03) + 1;
+    }
+
+    while (pos < size)
+    {
+        guint nal, type;
+
+        if (length_size)
+        {
+            guint len = 0, i;
+
+            if (pos + length_size >= size)
+                break;
+
+            for (i = 0; i < length_size; i++)
+                len = (len << 8) | data[pos + i];
+
+            nal = pos + length_size;
+            pos = nal + len;
+        }
+        else
+        {
+            while (pos + 3 < size &&
+                   !(data[pos] == 0 && data[pos + 1] == 0 && data[pos + 2] == 1))
+                pos++;
+
+            if (pos + 3 >= size)
+                break;
+
+            nal = pos + 3;
+            pos = nal;
+        }
+
+        type = data[nal] & 0x1f;
+
+        /* the first slice tells: */
+        if (type == 1 || type == 5)
+            return type == 1 && (data[nal] & 0x60) == 0;
+    }
+
+    return FALSE;
+}
+
 static void
 type_class_init (gpointer g_class,
                  gpointer class_data)
 {
+    GST_OMX_BASE_VIDEODEC_CLASS (g_class)->is_droppable = is_droppable;
 }
 
 static void
@@ -40,3 +40,31 @@ gst_omx_get_type (void)
 
     return type;
 }
+
+/**
+ * The port behind the pad linked to @pad, if that belongs to a GstOmx
+ * element, which keep their ports as the element_private of their pads.
+ */
+GOmxPort *
+gst_omx_get_peer_port (GstPad *pad)
+{
+    GstPad *peer;
+    GstElement *element;
+    GOmxPort *port = NULL;
+
+    peer = gst_pad_get_peer (pad);
+    if (!peer)
+        return NULL;
+
+    element = gst_pad_get_parent_element (peer);
+    if (element)
+    {
+        if (GST_IS_OMX (element))
+            port = gst_pad_get_element_private (peer);
+        gst_object_unref (element);
+    }
+
+    gst_object_unref (peer);
+
+    return port;
+}
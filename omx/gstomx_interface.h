@@ -24,6 +24,8 @@
 
 #include <gst/gst.h>
 
+#include "gstomx_util.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_OMX (gst_omx_get_type ())
@@ -40,6 +42,8 @@ typedef struct GstOmxClass
 
 GType gst_omx_get_type (void);
 
+GOmxPort * gst_omx_get_peer_port (GstPad *pad);
+
 G_END_DECLS
 
 #endif /* GSTOMX_INTERFACE_H */
@@ -99,10 +99,35 @@ type_base_init (gpointer g_class)
     }
 }
 
+/**
+ * B-VOPs are never used as reference, so they can be skipped.
+ */
+static gboolean
+is_droppable (GstOmxBaseVideoDec *self,
+              GstBuffer *buf)
+{
+    const guint8 *data = GST_BUFFER_DATA (buf);
+    guint size = GST_BUFFER_SIZE (buf);
+    guint pos;
+
+    for (pos = 0; pos + 4 < size; pos++)
+    {
+        /* vop_start_code, followed by vop_coding_type: */
+        if (data[pos] == 0 && data[pos + 1] == 0 && data[pos + 2] == 1 &&
+            data[pos + 3] == 0xb6)
+        {
+            return (data[pos + 4] >> 6) == 2;
+        }
+    }
+
+    return FALSE;
+}
+
 static void
 type_class_init (gpointer g_class,
                  gpointer class_data)
 {
+    GST_OMX_BASE_VIDEODEC_CLASS (g_class)->is_droppable = is_droppable;
 }
 
 static void
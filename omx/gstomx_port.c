@@ -24,6 +24,7 @@
 
 #include "gstomx_util.h"
 #include "gstomx_port.h"
+#include "gstomx_trace.h"
 #include "gstomx.h"
 
 #ifdef USE_OMXTICORE
@@ -40,6 +41,11 @@ GST_DEBUG_CATEGORY_EXTERN (gstomx_util_debug);
 static OMX_BUFFERHEADERTYPE * request_buffer (GOmxPort *port);
 static void release_buffer (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer);
 static void setup_shared_buffer (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer);
+static void reclaim_held_buffers (GOmxPort *port);
+static void prepare_import (GOmxPort *port, OMX_PARAM_PORTDEFINITIONTYPE *param);
+static void allocate_imported (GOmxPort *port);
+static void free_imported (GOmxPort *port);
+static void unimport (GOmxPort *port);
 
 #define DEBUG(port, fmt, args...) \
     GST_DEBUG ("<%s:%s> "fmt, GST_OBJECT_NAME ((port)->core->object), (port)->name, ##args)
@@ -49,6 +55,50 @@ static void setup_shared_buffer (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffe
     GST_WARNING ("<%s:%s> "fmt, GST_OBJECT_NAME ((port)->core->object), (port)->name, ##args)
 #define ERROR(port, fmt, args...) \
     GST_ERROR ("<%s:%s> "fmt, GST_OBJECT_NAME ((port)->core->object), (port)->name, ##args)
+/*
+ * Arena
+ */
+
+/* the memory of all the buffers of a port we allocate ourselves.  It stays
+ * around as long as something still points into it: the buffers held past
+ * g_omx_port_free_buffers(), and the input ports importing them (see NOTE
+ * ABOUT IMPORTED BUFFERS):
+ */
+struct GOmxArena
+{
+    gint refcount;
+    gpointer data;
+};
+
+static GOmxArena *
+arena_new (gsize size)
+{
+    GOmxArena *arena = g_new (GOmxArena, 1);
+
+    arena->refcount = 1;
+    arena->data = g_malloc (size);
+
+    return arena;
+}
+
+static GOmxArena *
+arena_ref (GOmxArena *arena)
+{
+    g_atomic_int_inc (&arena->refcount);
+
+    return arena;
+}
+
+static void
+arena_unref (GOmxArena *arena)
+{
+    if (arena && g_atomic_int_dec_and_test (&arena->refcount))
+    {
+        g_free (arena->data);
+        g_free (arena);
+    }
+}
+
 /*
  * Port
  */
@@ -65,10 +115,14 @@ g_omx_port_new (GOmxCore *core, const gchar *name, guint index)
     port->buffers = NULL;
 
     port->enabled = TRUE;
-    port->queue = async_queue_new ();
+    /* sized for the actual buffers in g_omx_port_allocate_buffers(): */
+    port->queue = ring_queue_new (1);
     port->mutex = g_mutex_new ();
+    port->held_mutex = g_mutex_new ();
+    port->held_cond = g_cond_new ();
+    port->stats_mutex = g_mutex_new ();
+    port->exported = g_hash_table_new (NULL, NULL);
 
-    port->ignore_count = 0;
     port->n_offset = 0;
 
     return port;
@@ -79,12 +133,26 @@ g_omx_port_free (GOmxPort *port)
 {
     DEBUG (port, "begin");
 
+    g_omx_port_teardown_tunnel (port);
+    unimport (port);
+
+    if (port->pool)
+        g_omx_buffer_pool_free (port->pool);
+
+    if (port->convert)
+        g_omx_convert_unref (port->convert);
+
+    g_hash_table_destroy (port->exported);
+    g_mutex_free (port->stats_mutex);
+    g_cond_free (port->held_cond);
+    g_mutex_free (port->held_mutex);
     g_mutex_free (port->mutex);
-    async_queue_free (port->queue);
+    ring_queue_free (port->queue);
 
     g_free (port->name);
 
     g_free (port->buffers);
+    arena_unref (port->arena);
     g_free (port);
 
     GST_DEBUG ("end");
@@ -110,7 +178,7 @@ g_omx_port_setup (GOmxPort *port,
 
     port->type = type;
     /** @todo should it be nBufferCountMin? */
-    port->num_buffers = omx_port->nBufferCountActual;
+    port->num_buffers = omx_port->nBufferCountActual - port->num_imported;
     port->port_index = omx_port->nPortIndex;
 
     DEBUG (port, "type=%d, num_buffers=%d, port_index=%d",
@@ -131,6 +199,9 @@ buffer_alloc (GOmxPort *port, gint len)
     if (port->buffer_alloc)
         buf = port->buffer_alloc (port, len);
 
+    if (!buf && port->pool)
+        buf = g_omx_buffer_pool_get (port->pool, len);
+
     if (!buf)
         buf = gst_buffer_new_and_alloc (len);
 
@@ -151,6 +222,10 @@ g_omx_port_prepare (GOmxPort *port)
     GstBuffer *buf;
     guint size;
 
+    /* the buffers of a tunnel never leave the components: */
+    if (port->tunnel)
+        return;
+
     DEBUG (port, "begin");
 
     G_OMX_PORT_GET_DEFINITION (port, &param);
@@ -166,10 +241,13 @@ g_omx_port_prepare (GOmxPort *port)
 
     /* number of buffers could have changed */
     G_OMX_PORT_GET_DEFINITION (port, &param);
-    port->num_buffers = param.nBufferCountActual;
+    port->num_buffers = param.nBufferCountActual - port->num_imported;
 
     gst_buffer_unref (buf);
 
+    if (port->type == GOMX_PORT_INPUT)
+        prepare_import (port, &param);
+
 #ifdef USE_OMXTICORE
     if (port->share_buffer)
     {
@@ -197,17 +275,68 @@ g_omx_port_allocate_buffers (GOmxPort *port)
     OMX_PARAM_PORTDEFINITIONTYPE param;
     guint i;
     guint size;
+    guint stride = 0;
+    GOmxArena *arena = NULL;
+    GTimeVal start, end;
 
-    if (port->buffers)
+    if (port->buffers || port->tunnel)
         return;
 
     DEBUG (port, "begin");
 
+    g_get_current_time (&start);
+
     G_OMX_PORT_GET_DEFINITION (port, &param);
     size = param.nBufferSize;
 
+    /* first, since our own buffers take the slots of the imported ones
+     * the component refuses:
+     */
+    if (port->import)
+        allocate_imported (port);
+
+    /* the same buffer can be in the queue twice (ie. refcount notification
+     * on top of the FillBufferDone), so leave room for that; the imported
+     * buffers never go in there.  Nothing else can be using the queue now,
+     * and g_omx_port_push_buffer() counts on it being big enough:
+     */
+    ring_queue_flush (port->queue);
+    if (!ring_queue_reserve (port->queue, port->num_buffers * 2))
+    {
+        ERROR (port, "could not grow queue to %d", port->num_buffers * 2);
+        free_imported (port);
+        return;
+    }
+
     port->buffers = g_new0 (OMX_BUFFERHEADERTYPE *, port->num_buffers);
 
+    /* when not sharing buffers, every output buffer is copied into a new
+     * GstBuffer of up to nBufferSize bytes.. recycle those:
+     */
+    if (port->type == GOMX_PORT_OUTPUT && !port->share_buffer)
+    {
+        /* vs. g_omx_port_get_stats(): */
+        g_mutex_lock (port->stats_mutex);
+
+        if (port->pool && port->pool->size != size)
+        {
+            g_omx_buffer_pool_free (port->pool);
+            port->pool = NULL;
+        }
+
+        if (!port->pool)
+            port->pool = g_omx_buffer_pool_new (size, port->num_buffers * 2);
+
+        g_mutex_unlock (port->stats_mutex);
+    }
+
+    /* when we provide the memory, get it for all the buffers at once: */
+    if (!port->omx_allocate && !port->share_buffer)
+    {
+        stride = GST_ROUND_UP_32 (size);
+        arena = arena_new (stride * port->num_buffers);
+    }
+
     for (i = 0; i < port->num_buffers; i++)
     {
 
@@ -228,7 +357,7 @@ g_omx_port_allocate_buffers (GOmxPort *port)
 
             if (! port->share_buffer)
             {
-                buffer_data = g_malloc (size);
+                buffer_data = (guint8 *) arena->data + (i * stride);
             }
 
             DEBUG (port, "%d: OMX_UseBuffer(), size=%d, share_buffer=%d", i, size, port->share_buffer);
@@ -249,7 +378,15 @@ g_omx_port_allocate_buffers (GOmxPort *port)
         }
     }
 
-    DEBUG (port, "end");
+    /* only now can input ports import them, see g_omx_port_import(): */
+    g_mutex_lock (port->held_mutex);
+    port->arena = arena;
+    g_mutex_unlock (port->held_mutex);
+
+    g_get_current_time (&end);
+
+    DEBUG (port, "end: %d buffers of %d bytes in %ld us", port->num_buffers, size,
+            (end.tv_sec - start.tv_sec) * G_USEC_PER_SEC + (end.tv_usec - start.tv_usec));
 }
 
 void
@@ -258,12 +395,22 @@ g_omx_port_free_buffers (GOmxPort *port)
     guint i;
     guint n_free_buffers = 0;
     OMX_BUFFERHEADERTYPE *omx_buffer;
+    GOmxArena *arena;
 
     if (!port->buffers)
         return;
 
     DEBUG (port, "begin");
 
+    /* get back the buffers still held downstream, if any: */
+    reclaim_held_buffers (port);
+
+    /* no new imports from here on, the current ones keep their ref: */
+    g_mutex_lock (port->held_mutex);
+    arena = port->arena;
+    port->arena = NULL;
+    g_mutex_unlock (port->held_mutex);
+
     for (i = 0; i < port->num_buffers; i++)
     {
 
@@ -271,7 +418,7 @@ g_omx_port_free_buffers (GOmxPort *port)
          * OMX component, to avoid freeing a buffer that the component
          * is still accessing:
          */
-        omx_buffer = async_queue_pop_full (port->queue, TRUE, TRUE);
+        omx_buffer = ring_queue_pop_full (port->queue, TRUE, TRUE);
 
         if (omx_buffer)
         /* the queue could have repeated pointers, thus the 'sizeof' check
@@ -298,7 +445,7 @@ g_omx_port_free_buffers (GOmxPort *port)
         for (i = 0; i < port->num_buffers; i++)
         {
             omx_buffer = port->buffers[i];
-            if (!async_queue_exist (port->queue, (gpointer) omx_buffer))
+            if (!ring_queue_exist (port->queue, (gpointer) omx_buffer))
             {
                 DEBUG (port, "OMX_FreeBuffer(%p)", omx_buffer);
                 OMX_FreeBuffer (port->core->omx_handle, port->port_index, omx_buffer);
@@ -306,9 +453,13 @@ g_omx_port_free_buffers (GOmxPort *port)
         }
     }
 
+    free_imported (port);
+
     g_free (port->buffers);
     port->buffers = NULL;
 
+    arena_unref (arena);
+
     DEBUG (port, "end");
 }
 
@@ -317,7 +468,7 @@ g_omx_port_start_buffers (GOmxPort *port)
 {
     guint i;
 
-    if (!port->enabled)
+    if (!port->enabled || port->tunnel)
         return;
 
     g_return_if_fail (port->buffers);
@@ -350,14 +501,55 @@ void
 g_omx_port_push_buffer (GOmxPort *port,
                         OMX_BUFFERHEADERTYPE *omx_buffer)
 {
-    async_queue_push (port->queue, omx_buffer);
+    gint queued, peak;
+    gboolean pushed;
+
+    /* it holds twice the buffers of the port, so it can't be full: */
+    pushed = ring_queue_push (port->queue, omx_buffer);
+    g_assert (pushed);
+
+    queued = ring_queue_length (port->queue);
+    do
+    {
+        peak = g_atomic_int_get (&port->stats.peak_queued);
+    }
+    while (queued > peak &&
+           !g_atomic_int_compare_and_exchange (&port->stats.peak_queued, peak, queued));
+}
+
+/* for the 64 bit counters, see GOmxPortStats */
+static inline void
+stats_add (GOmxPort *port,
+           guint64 *counter,
+           guint64 value)
+{
+    g_mutex_lock (port->stats_mutex);
+    *counter += value;
+    g_mutex_unlock (port->stats_mutex);
 }
 
 static OMX_BUFFERHEADERTYPE *
 request_buffer (GOmxPort *port)
 {
+    OMX_BUFFERHEADERTYPE *omx_buffer;
+    GTimeVal start, end;
+
     LOG (port, "request buffer");
-    return async_queue_pop (port->queue);
+
+    /* fast path, no need to time it: */
+    omx_buffer = ring_queue_pop_full (port->queue, FALSE, FALSE);
+    if (G_LIKELY (omx_buffer))
+        return omx_buffer;
+
+    g_get_current_time (&start);
+    omx_buffer = ring_queue_pop (port->queue);
+    g_get_current_time (&end);
+
+    stats_add (port, &port->stats.blocked,
+               (end.tv_sec - start.tv_sec) * G_USEC_PER_SEC +
+               (end.tv_usec - start.tv_usec));
+
+    return omx_buffer;
 }
 
 static void
@@ -368,11 +560,16 @@ release_buffer (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer)
         case GOMX_PORT_INPUT:
             DEBUG (port, "ETB: omx_buffer=%p, pAppPrivate=%p, pBuffer=%p",
                     omx_buffer, omx_buffer ? omx_buffer->pAppPrivate : 0, omx_buffer ? omx_buffer->pBuffer : 0);
+            g_atomic_int_inc (&port->stats.etb);
+            g_omx_ppm_mark_once (port->core->ppm, &port->ppm_first, "first-buffer-in");
+            G_OMX_TRACE (port, G_OMX_TRACE_ETB, omx_buffer);
             OMX_EmptyThisBuffer (port->core->omx_handle, omx_buffer);
             break;
         case GOMX_PORT_OUTPUT:
             DEBUG (port, "FTB: omx_buffer=%p, pAppPrivate=%p, pBuffer=%p",
                     omx_buffer, omx_buffer ? omx_buffer->pAppPrivate : 0, omx_buffer ? omx_buffer->pBuffer : 0);
+            g_atomic_int_inc (&port->stats.ftb);
+            G_OMX_TRACE (port, G_OMX_TRACE_FTB, omx_buffer);
             OMX_FillThisBuffer (port->core->omx_handle, omx_buffer);
             break;
         default:
@@ -421,209 +618,720 @@ setup_shared_buffer (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer)
     }
 }
 
-typedef void (*SendPrep) (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer, gpointer obj);
+/* NOTE ABOUT DEFERRED RELEASE:
+ *
+ * When defer_release is set on an output port which does not share
+ * buffers, g_omx_port_recv() does not copy the data out of the OMX buffer,
+ * but returns a GstBuffer pointing into it.  The OMX buffer is only given
+ * back to the component (FillThisBuffer) when that GstBuffer is finalized.
+ *
+ * Downstream may keep buffers around for a while (ie. a sink keeping the
+ * last frame), so at least one OMX buffer is always kept out of its hands,
+ * falling back to copying, so the component does not starve.  And when the
+ * port buffers are free'd, buffers still held downstream are given their
+ * own copy of the data, or keep the memory alive when we allocated it.
+ *
+ * NOTE ABOUT EXPORTED BUFFERS:
+ *
+ * The same GstBuffer subclass is used the other way around for input ports
+ * with export_buffers set: g_omx_port_request_input_buffer() lends a free
+ * OMX buffer to upstream (ie. from the sink pad's bufferalloc function), so
+ * upstream writes directly in memory the component already knows about.
+ * The port->exported table maps the data pointers of those GstBuffers back
+ * to their OMX buffers, so when such a buffer is sent it goes to
+ * EmptyThisBuffer without being copied, detached from the GstBuffer, as
+ * long as nothing else holds a reference to it; a shared one is copied
+ * like any other buffer.  If upstream drops the buffer without sending it
+ * (or once the copy is done with), the OMX buffer goes back to the queue.
+ *
+ * port->held_mutex protects the association between the GstBuffers and
+ * the port (port->held, port->n_held, port->exported), since the GstBuffers
+ * can outlive the port buffers.  It is never held while calling into the
+ * component: a returned buffer is counted in port->n_releasing until it
+ * has been given back, so that reclaim_held_buffers() still waits for it.
+ */
+
+#define HELD_BUFFER_TIMEOUT (G_USEC_PER_SEC / 5)
+
+typedef struct GOmxPortBuffer GOmxPortBuffer;
+
+struct GOmxPortBuffer
+{
+    GstBuffer buffer;
+    GOmxPort *port;     /**< NULL once detached */
+    OMX_BUFFERHEADERTYPE *omx_buffer;
+    GOmxArena *arena;   /**< pinned by a detached buffer, if any */
+};
+
+static GstMiniObjectClass *port_buffer_parent_class;
 
+/* called with port->held_mutex */
 static void
-send_prep_codec_data (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer, GstBuffer *buf)
+unhold_buffer (GOmxPort *port, GOmxPortBuffer *port_buf)
 {
-    omx_buffer->nFlags |= OMX_BUFFERFLAG_CODECCONFIG;
-    omx_buffer->nFilledLen = GST_BUFFER_SIZE (buf);
+    port->held = g_list_remove (port->held, port_buf);
+    port->n_held--;
 
-    if (port->share_buffer)
-    {
-        omx_buffer->nOffset = 0;
-        omx_buffer->pBuffer = malloc (omx_buffer->nFilledLen);
-    }
+    if (port->type == GOMX_PORT_INPUT)
+        g_hash_table_remove (port->exported, GST_BUFFER_DATA (port_buf));
 
-    memcpy (omx_buffer->pBuffer + omx_buffer->nOffset,
-            GST_BUFFER_DATA (buf), omx_buffer->nFilledLen);
+    g_atomic_pointer_set (&port_buf->port, NULL);
 }
 
 static void
-send_prep_buffer_data (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer, GstBuffer *buf)
+port_buffer_finalize (GOmxPortBuffer *port_buf)
 {
-    if (port->share_buffer)
-    {
-        omx_buffer->nOffset     = port->n_offset;
-        omx_buffer->pBuffer     = GST_BUFFER_DATA (buf);
-        omx_buffer->nFilledLen  = GST_BUFFER_SIZE (buf);
-        /* Temp hack to not update nAllocLen for each ETB/FTB till we
-         * find a cleaner solution to get padded width and height */
-        /* omx_buffer->nAllocLen   = GST_BUFFER_SIZE (buf); */
-        omx_buffer->pAppPrivate = gst_buffer_ref (buf);
+    GOmxPort *port;
+    OMX_BUFFERHEADERTYPE *omx_buffer = port_buf->omx_buffer;
+    gboolean returned = FALSE, fill = FALSE;
 
-        /* special hack.. this should be removed: */
-        omx_buffer->nFlags     |= OMX_BUFFERHEADERFLAG_MODIFIED;
-    }
-    else
+    /* the port is only free'd once all its buffers are detached, and it
+     * can't detach this one behind our back once we have the lock:
+     */
+    port = g_atomic_pointer_get (&port_buf->port);
+
+    if (port)
     {
-        omx_buffer->nFilledLen = MIN (GST_BUFFER_SIZE (buf),
-                omx_buffer->nAllocLen - omx_buffer->nOffset);
-        memcpy (omx_buffer->pBuffer + omx_buffer->nOffset,
-                GST_BUFFER_DATA (buf), omx_buffer->nFilledLen);
+        g_mutex_lock (port->held_mutex);
+        if (port_buf->port == port)
+        {
+            unhold_buffer (port, port_buf);
+            port->n_releasing++;
+            fill = port->type == GOMX_PORT_OUTPUT && G_LIKELY (port->enabled);
+            returned = TRUE;
+        }
+        g_mutex_unlock (port->held_mutex);
     }
 
-    if (port->core->use_timestamps)
+    if (returned)
     {
-        omx_buffer->nTimeStamp = gst_util_uint64_scale_int (
-                GST_BUFFER_TIMESTAMP (buf),
-                OMX_TICKS_PER_SECOND, GST_SECOND);
+        LOG (port, "returned: omx_buffer=%p", omx_buffer);
+
+        /* output buffers go back to the component, input buffers that
+         * were never sent just go back to the queue:
+         */
+        if (fill)
+            release_buffer (port, omx_buffer);
+        else
+            g_omx_port_push_buffer (port, omx_buffer);
+
+        g_mutex_lock (port->held_mutex);
+        port->n_releasing--;
+        g_cond_broadcast (port->held_cond);
+        g_mutex_unlock (port->held_mutex);
     }
 
-    DEBUG (port, "omx_buffer: size=%lu, len=%lu, flags=%lu, offset=%lu, timestamp=%lld",
-            omx_buffer->nAllocLen, omx_buffer->nFilledLen, omx_buffer->nFlags,
-            omx_buffer->nOffset, omx_buffer->nTimeStamp);
+    arena_unref (port_buf->arena);
+
+    port_buffer_parent_class->finalize (GST_MINI_OBJECT_CAST (port_buf));
 }
 
 static void
-send_prep_eos_event (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer, GstEvent *evt)
+port_buffer_class_init (gpointer g_class,
+                        gpointer class_data)
 {
-    omx_buffer->nFlags |= OMX_BUFFERFLAG_EOS;
-    omx_buffer->nFilledLen = 0;
-    if (port->share_buffer) {
-        /* OMX should not try to read from the buffer, since it is empty..
-         * but yet it complains if pBuffer is NULL.  This will get us past
-         * that check, and ensure that OMX segfaults in a debuggible way
-         * if they do something stupid like read from the empty buffer:
-         */
-        omx_buffer->pBuffer    = (OMX_U8 *)1;
-        /* TODO: Temporary hack as OMX currently complains about
-         * non-zero nAllocLen. Need to be removed once aligned with OMX.
-         */
-        /* omx_buffer->nAllocLen  = 0; */
-    }
+    GstMiniObjectClass *mini_object_class = GST_MINI_OBJECT_CLASS (g_class);
+
+    port_buffer_parent_class = g_type_class_peek_parent (g_class);
+
+    mini_object_class->finalize = (GstMiniObjectFinalizeFunction) port_buffer_finalize;
 }
 
-/**
- * Send a buffer/event to the OMX component.  This handles conversion of
- * GST buffer, codec-data, and EOS events to the equivalent OMX buffer.
- *
- * This method does not take ownership of the ref to @obj
- *
- * Returns number of bytes sent, or negative if error
- */
-gint
-g_omx_port_send (GOmxPort *port, gpointer obj)
+static GType
+port_buffer_get_type (void)
 {
-    SendPrep send_prep = NULL;
-
-    g_return_val_if_fail (port->type == GOMX_PORT_INPUT, -1);
+    static volatile gsize gonce_data = 0;
 
-    if (GST_IS_BUFFER (obj))
+    if (g_once_init_enter (&gonce_data))
     {
-        if (G_UNLIKELY (GST_BUFFER_FLAG_IS_SET (obj, GST_BUFFER_FLAG_IN_CAPS)))
-            send_prep = (SendPrep)send_prep_codec_data;
-        else
-            send_prep = (SendPrep)send_prep_buffer_data;
-    }
-    else if (GST_IS_EVENT (obj))
-    {
-        if (G_LIKELY (GST_EVENT_TYPE (obj) == GST_EVENT_EOS))
-            send_prep = (SendPrep)send_prep_eos_event;
+        GType _type;
+        GTypeInfo *type_info;
+
+        type_info = g_new0 (GTypeInfo, 1);
+        type_info->class_size = sizeof (GstBufferClass);
+        type_info->class_init = port_buffer_class_init;
+        type_info->instance_size = sizeof (GOmxPortBuffer);
+        _type = g_type_register_static (GST_TYPE_BUFFER, "GOmxPortBuffer", type_info, 0);
+        g_free (type_info);
+        g_once_init_leave (&gonce_data, (gsize) _type);
     }
 
-    if (G_LIKELY (send_prep))
-    {
-        gint ret;
-        OMX_BUFFERHEADERTYPE *omx_buffer = request_buffer (port);
+    return (GType) gonce_data;
+}
 
-        if (!omx_buffer)
-        {
-            DEBUG (port, "null buffer");
-            return -1;
-        }
+static gboolean
+can_defer_release (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer)
+{
+    if ((!port->defer_release && !g_atomic_int_get (&port->n_importers)) ||
+        port->share_buffer || port->convert)
+        return FALSE;
 
-        /* don't assume OMX component clears flags!
-         */
-        omx_buffer->nFlags = 0;
+    if (omx_buffer->nFlags & (OMX_BUFFERFLAG_CODECCONFIG | GST_BUFFERFLAG_UNREF_CHECK))
+        return FALSE;
 
-        /* if buffer sharing is enabled, pAppPrivate might hold the ref to
-         * a buffer that is no longer required and should be unref'd.  We
-         * do this check here, rather than in send_prep_buffer_data() so
-         * we don't keep the reference live in case, for example, this time
-         * the buffer is used for an EOS event.
-         */
-        if (omx_buffer->pAppPrivate)
-        {
-            GstBuffer *old_buf = omx_buffer->pAppPrivate;
-            gst_buffer_unref (old_buf);
-            omx_buffer->pAppPrivate = NULL;
-            omx_buffer->pBuffer = NULL;     /* just to ease debugging */
-        }
+#ifdef USE_OMXTICORE
+    /* the component still uses it, it will be released later */
+    if (omx_buffer->nFlags & OMX_TI_BUFFERFLAG_READONLY)
+        return FALSE;
+#endif
 
-        send_prep (port, omx_buffer, obj);
+    return g_atomic_int_get (&port->n_held) < (gint) port->num_buffers - 1;
+}
 
-        ret = omx_buffer->nFilledLen;
+static GstBuffer *
+hold_buffer (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer, guint len)
+{
+    GOmxPortBuffer *port_buf;
+    GstBuffer *buf;
 
-        release_buffer (port, omx_buffer);
+    port_buf = (GOmxPortBuffer *) gst_mini_object_new (port_buffer_get_type ());
+    port_buf->port = port;
+    port_buf->omx_buffer = omx_buffer;
 
-        return ret;
-    }
+    buf = GST_BUFFER_CAST (port_buf);
+    GST_BUFFER_DATA (buf) = omx_buffer->pBuffer + omx_buffer->nOffset;
+    GST_BUFFER_SIZE (buf) = len;
 
-    WARNING (port, "unknown obj type");
-    return -1;
+    g_mutex_lock (port->held_mutex);
+    port->held = g_list_prepend (port->held, port_buf);
+    port->n_held++;
+    if (port->type == GOMX_PORT_INPUT)
+        g_hash_table_insert (port->exported, GST_BUFFER_DATA (buf), port_buf);
+    g_mutex_unlock (port->held_mutex);
+
+    return buf;
 }
 
 /**
- * Receive a buffer/event from OMX component.  This handles the conversion
- * of OMX buffer to GST buffer, codec-data, or EOS event.
- *
- * Returns <code>NULL</code> if buffer could not be received.
+ * Lend a free OMX buffer of the input port to upstream, so that it can
+ * write the data in place.  Returns <code>NULL</code> if exporting buffers
+ * is not enabled, or no buffer is available right now, in which case the
+ * caller should allocate a normal buffer.
  */
-gpointer
-g_omx_port_recv (GOmxPort *port)
+GstBuffer *
+g_omx_port_request_input_buffer (GOmxPort *port, guint len)
 {
-    gpointer ret = NULL;
+    OMX_BUFFERHEADERTYPE *omx_buffer;
 
-    g_return_val_if_fail (port->type == GOMX_PORT_OUTPUT, NULL);
+    g_return_val_if_fail (port->type == GOMX_PORT_INPUT, NULL);
 
-    while (!ret && port->enabled)
+    if (!port->export_buffers || port->share_buffer || port->convert ||
+        !port->buffers || !port->enabled)
+        return NULL;
+
+    /* always keep one buffer for codec-data, EOS, and upstream buffers
+     * which are not ours:
+     */
+    if (g_atomic_int_get (&port->n_held) >= (gint) port->num_buffers - 1)
+        return NULL;
+
+    omx_buffer = ring_queue_pop_full (port->queue, FALSE, FALSE);
+    if (!omx_buffer)
+        return NULL;
+
+    if (len > omx_buffer->nAllocLen - omx_buffer->nOffset)
     {
-        OMX_BUFFERHEADERTYPE *omx_buffer = request_buffer (port);
+        g_omx_port_push_buffer (port, omx_buffer);
+        return NULL;
+    }
 
-        if (G_UNLIKELY (!omx_buffer))
-        {
-            return NULL;
-        }
+    LOG (port, "exported omx_buffer=%p", omx_buffer);
 
-        DEBUG (port, "omx_buffer=%p size=%lu, len=%lu, flags=%lu, offset=%lu, timestamp=%lld",
-                omx_buffer, omx_buffer->nAllocLen, omx_buffer->nFilledLen, omx_buffer->nFlags,
-                omx_buffer->nOffset, omx_buffer->nTimeStamp);
+    return hold_buffer (port, omx_buffer, len);
+}
 
-        /* XXX this ignore_count workaround might play badly w/ refcnting
-         * in OMX component..
-         */
+/* if upstream wrote @buf directly into one of our OMX buffers, take that
+ * OMX buffer back.  Only if nobody else can still see the memory through
+ * @buf (ie. a tee, or a subbuffer), which is detached from it, since the
+ * component is about to use it; otherwise the data is copied as usual,
+ * and the OMX buffer comes back once @buf is finalized:
+ */
+static OMX_BUFFERHEADERTYPE *
+take_exported_buffer (GOmxPort *port, GstBuffer *buf)
+{
+    OMX_BUFFERHEADERTYPE *omx_buffer = NULL;
+    GOmxPortBuffer *port_buf;
 
-        if (port->ignore_count)
-        {
-            DEBUG (port, "ignore_count=%d", port->ignore_count);
-            release_buffer (port, omx_buffer);
-            port->ignore_count--;
-            continue;
-        }
+    if (!port->export_buffers ||
+        !G_TYPE_CHECK_INSTANCE_TYPE (buf, port_buffer_get_type ()) ||
+        !gst_buffer_is_writable (buf))
+        return NULL;
 
-        if (G_UNLIKELY (omx_buffer->nFlags & OMX_BUFFERFLAG_EOS))
-        {
-            DEBUG (port, "got eos");
-            ret = gst_event_new_eos ();
-        }
-        else if (G_LIKELY (omx_buffer->nFilledLen > 0))
-        {
-            GstBuffer *buf = omx_buffer->pAppPrivate;
+    g_mutex_lock (port->held_mutex);
 
-            /* I'm not really sure if it was intentional to block zero-copy of
-             * the codec-data buffer.. this is how the original code worked,
-             * so I kept the behavior
-             */
-            if (!buf || (omx_buffer->nFlags & OMX_BUFFERFLAG_CODECCONFIG))
-            {
+    port_buf = g_hash_table_lookup (port->exported, GST_BUFFER_DATA (buf));
+    if (port_buf == (GOmxPortBuffer *) buf && port_buf->port == port)
+    {
+        omx_buffer = port_buf->omx_buffer;
+        unhold_buffer (port, port_buf);
+        GST_BUFFER_DATA (buf) = NULL;
+    }
+
+    g_mutex_unlock (port->held_mutex);
+
+    return omx_buffer;
+}
+
+/* if @buf is one of the buffers of port->import, take the OMX buffer of
+ * ours registered on the same memory, see NOTE ABOUT IMPORTED BUFFERS:
+ */
+static OMX_BUFFERHEADERTYPE *
+take_imported_buffer (GOmxPort *port, GstBuffer *buf)
+{
+    OMX_BUFFERHEADERTYPE *omx_buffer = NULL;
+    GOmxPortBuffer *port_buf;
+    GOmxPort *import = port->import;
+    guint i;
+
+    if (!port->imported || port->convert ||
+        !G_TYPE_CHECK_INSTANCE_TYPE (buf, port_buffer_get_type ()))
+        return NULL;
+
+    port_buf = (GOmxPortBuffer *) buf;
+
+    g_mutex_lock (import->held_mutex);
+
+    /* unless upstream re-allocated its buffers since: */
+    if (port_buf->port == import && import->arena == port->imported_arena)
+    {
+        for (i = 0; i < port->num_imported && i < import->num_buffers; i++)
+        {
+            if (import->buffers[i] == port_buf->omx_buffer)
+            {
+                omx_buffer = port->imported[i];
+                break;
+            }
+        }
+    }
+
+    g_mutex_unlock (import->held_mutex);
+
+    return omx_buffer;
+}
+
+static void
+reclaim_held_buffers (GOmxPort *port)
+{
+    GTimeVal tv;
+
+    g_get_current_time (&tv);
+    g_time_val_add (&tv, HELD_BUFFER_TIMEOUT);
+
+    g_mutex_lock (port->held_mutex);
+
+    /* upstream pools may keep exported buffers around forever, so only
+     * wait for downstream.  Not for the components importing our buffers
+     * either, which only give them back once they are done with them,
+     * and keep the memory pinned until then:
+     */
+    while (port->held && port->type == GOMX_PORT_OUTPUT && !port->n_importers)
+    {
+        if (!g_cond_timed_wait (port->held_cond, port->held_mutex, &tv))
+            break;
+    }
+
+    /* buffers being given back only need the time to do it: */
+    while (port->n_releasing)
+        g_cond_wait (port->held_cond, port->held_mutex);
+
+    /* the remaining buffers keep our memory, or get their own copy of the
+     * data, before the OMX buffers go away:
+     */
+    while (port->held)
+    {
+        GOmxPortBuffer *port_buf = port->held->data;
+        GstBuffer *buf = GST_BUFFER_CAST (port_buf);
+        OMX_BUFFERHEADERTYPE *omx_buffer = port_buf->omx_buffer;
+
+        DEBUG (port, "detaching omx_buffer=%p from %p", omx_buffer, buf);
+
+        unhold_buffer (port, port_buf);
+
+        if (port->arena)
+        {
+            port_buf->arena = arena_ref (port->arena);
+        }
+        else
+        {
+            GST_BUFFER_MALLOCDATA (buf) = g_memdup (GST_BUFFER_DATA (buf), GST_BUFFER_SIZE (buf));
+            GST_BUFFER_DATA (buf) = GST_BUFFER_MALLOCDATA (buf);
+        }
+
+        g_omx_port_push_buffer (port, omx_buffer);
+    }
+
+    g_mutex_unlock (port->held_mutex);
+}
+
+typedef void (*SendPrep) (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer, gpointer obj);
+
+static void
+send_prep_codec_data (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer, GstBuffer *buf)
+{
+    omx_buffer->nFlags |= OMX_BUFFERFLAG_CODECCONFIG;
+    omx_buffer->nFilledLen = GST_BUFFER_SIZE (buf);
+
+    if (port->share_buffer)
+    {
+        omx_buffer->nOffset = 0;
+        omx_buffer->pBuffer = malloc (omx_buffer->nFilledLen);
+    }
+
+    memcpy (omx_buffer->pBuffer + omx_buffer->nOffset,
+            GST_BUFFER_DATA (buf), omx_buffer->nFilledLen);
+}
+
+static inline void
+send_prep_timestamp (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer, GstBuffer *buf)
+{
+    if (port->core->use_timestamps)
+    {
+        omx_buffer->nTimeStamp = gst_util_uint64_scale_int (
+                GST_BUFFER_TIMESTAMP (buf),
+                OMX_TICKS_PER_SECOND, GST_SECOND);
+    }
+}
+
+/* the color conversion for the next frame, if any, see
+ * g_omx_port_set_convert():
+ */
+static GOmxConvert *
+get_convert (GOmxPort *port)
+{
+    GOmxConvert *convert = NULL;
+
+    if (!g_atomic_pointer_get (&port->convert))
+        return NULL;
+
+    g_mutex_lock (port->mutex);
+    if (port->convert)
+        convert = g_omx_convert_ref (port->convert);
+    g_mutex_unlock (port->mutex);
+
+    return convert;
+}
+
+/* copy @buf into @omx_buffer through the color conversion, if there is
+ * one and the frame fits:
+ */
+static gboolean
+convert_buffer_data (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer, GstBuffer *buf)
+{
+    GOmxConvert *convert;
+    gboolean ret = FALSE;
+
+    convert = get_convert (port);
+    if (!convert)
+        return FALSE;
+
+    if (GST_BUFFER_SIZE (buf) < convert->in.size ||
+        convert->out.size > omx_buffer->nAllocLen - omx_buffer->nOffset)
+    {
+        WARNING (port, "can't convert: %u byte buffer, %u -> %u bytes, %lu available",
+                GST_BUFFER_SIZE (buf), convert->in.size, convert->out.size,
+                omx_buffer->nAllocLen - omx_buffer->nOffset);
+    }
+    else
+    {
+        g_omx_convert_run (convert, omx_buffer->pBuffer + omx_buffer->nOffset,
+                           GST_BUFFER_DATA (buf), 0);
+        omx_buffer->nFilledLen = convert->out.size;
+        ret = TRUE;
+    }
+
+    g_omx_convert_unref (convert);
+
+    return ret;
+}
+
+static void
+send_prep_buffer_data (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer, GstBuffer *buf)
+{
+    if (port->share_buffer)
+    {
+        omx_buffer->nOffset     = port->n_offset;
+        omx_buffer->pBuffer     = GST_BUFFER_DATA (buf);
+        omx_buffer->nFilledLen  = GST_BUFFER_SIZE (buf);
+        /* Temp hack to not update nAllocLen for each ETB/FTB till we
+         * find a cleaner solution to get padded width and height */
+        /* omx_buffer->nAllocLen   = GST_BUFFER_SIZE (buf); */
+        omx_buffer->pAppPrivate = gst_buffer_ref (buf);
+
+        /* special hack.. this should be removed: */
+        omx_buffer->nFlags     |= OMX_BUFFERHEADERFLAG_MODIFIED;
+    }
+    else if (convert_buffer_data (port, omx_buffer, buf))
+    {
+        g_atomic_int_inc (&port->stats.copies);
+    }
+    else
+    {
+        omx_buffer->nFilledLen = MIN (GST_BUFFER_SIZE (buf),
+                omx_buffer->nAllocLen - omx_buffer->nOffset);
+
+        memcpy (omx_buffer->pBuffer + omx_buffer->nOffset,
+                GST_BUFFER_DATA (buf), omx_buffer->nFilledLen);
+        g_atomic_int_inc (&port->stats.copies);
+    }
+
+    send_prep_timestamp (port, omx_buffer, buf);
+
+    DEBUG (port, "omx_buffer: size=%lu, len=%lu, flags=%lu, offset=%lu, timestamp=%lld",
+            omx_buffer->nAllocLen, omx_buffer->nFilledLen, omx_buffer->nFlags,
+            omx_buffer->nOffset, omx_buffer->nTimeStamp);
+}
+
+/* upstream wrote @buf right in @omx_buffer, which it has been detached
+ * from, see take_exported_buffer():
+ */
+static void
+send_prep_exported_data (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer, GstBuffer *buf)
+{
+    omx_buffer->nFilledLen = GST_BUFFER_SIZE (buf);
+
+    g_atomic_int_inc (&port->stats.zero_copies);
+
+    send_prep_timestamp (port, omx_buffer, buf);
+
+    DEBUG (port, "omx_buffer: exported, len=%lu, offset=%lu, timestamp=%lld",
+            omx_buffer->nFilledLen, omx_buffer->nOffset, omx_buffer->nTimeStamp);
+}
+
+/* @buf lives in the memory @omx_buffer was registered on, so only point
+ * at it, and keep it until the component is done with it:
+ */
+static void
+send_prep_imported_data (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer, GstBuffer *buf)
+{
+    omx_buffer->nOffset     = GST_BUFFER_DATA (buf) - omx_buffer->pBuffer;
+    omx_buffer->nFilledLen  = GST_BUFFER_SIZE (buf);
+    omx_buffer->pAppPrivate = gst_buffer_ref (buf);
+
+    g_atomic_int_inc (&port->stats.zero_copies);
+
+    send_prep_timestamp (port, omx_buffer, buf);
+
+    DEBUG (port, "omx_buffer: imported, len=%lu, offset=%lu, timestamp=%lld",
+            omx_buffer->nFilledLen, omx_buffer->nOffset, omx_buffer->nTimeStamp);
+}
+
+static void
+send_prep_eos_event (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer, GstEvent *evt)
+{
+    omx_buffer->nFlags |= OMX_BUFFERFLAG_EOS;
+    omx_buffer->nFilledLen = 0;
+    g_omx_ppm_start (port->core->ppm, "eos-drain");
+    if (port->share_buffer) {
+        /* OMX should not try to read from the buffer, since it is empty..
+         * but yet it complains if pBuffer is NULL.  This will get us past
+         * that check, and ensure that OMX segfaults in a debuggible way
+         * if they do something stupid like read from the empty buffer:
+         */
+        omx_buffer->pBuffer    = (OMX_U8 *)1;
+        /* TODO: Temporary hack as OMX currently complains about
+         * non-zero nAllocLen. Need to be removed once aligned with OMX.
+         */
+        /* omx_buffer->nAllocLen  = 0; */
+    }
+}
+
+/**
+ * Send a buffer/event to the OMX component.  This handles conversion of
+ * GST buffer, codec-data, and EOS events to the equivalent OMX buffer.
+ *
+ * This method does not take ownership of the ref to @obj
+ *
+ * Returns number of bytes sent, or negative if error
+ */
+gint
+g_omx_port_send (GOmxPort *port, gpointer obj)
+{
+    SendPrep send_prep = NULL;
+
+    g_return_val_if_fail (port->type == GOMX_PORT_INPUT, -1);
+
+    if (GST_IS_BUFFER (obj))
+    {
+        if (G_UNLIKELY (GST_BUFFER_FLAG_IS_SET (obj, GST_BUFFER_FLAG_IN_CAPS)))
+            send_prep = (SendPrep)send_prep_codec_data;
+        else
+            send_prep = (SendPrep)send_prep_buffer_data;
+    }
+    else if (GST_IS_EVENT (obj))
+    {
+        if (G_LIKELY (GST_EVENT_TYPE (obj) == GST_EVENT_EOS))
+            send_prep = (SendPrep)send_prep_eos_event;
+    }
+
+    if (G_LIKELY (send_prep))
+    {
+        gint ret;
+        OMX_BUFFERHEADERTYPE *omx_buffer = NULL;
+
+        if (send_prep == (SendPrep)send_prep_buffer_data)
+        {
+            if ((omx_buffer = take_exported_buffer (port, obj)))
+                send_prep = (SendPrep)send_prep_exported_data;
+            else if ((omx_buffer = take_imported_buffer (port, obj)))
+                send_prep = (SendPrep)send_prep_imported_data;
+        }
+
+        if (!omx_buffer)
+            omx_buffer = request_buffer (port);
+
+        if (!omx_buffer)
+        {
+            DEBUG (port, "null buffer");
+            return -1;
+        }
+
+        G_OMX_TRACE (port, G_OMX_TRACE_SEND, omx_buffer);
+
+        /* don't assume OMX component clears flags!
+         */
+        omx_buffer->nFlags = 0;
+
+        /* if buffer sharing is enabled, pAppPrivate might hold the ref to
+         * a buffer that is no longer required and should be unref'd.  We
+         * do this check here, rather than in send_prep_buffer_data() so
+         * we don't keep the reference live in case, for example, this time
+         * the buffer is used for an EOS event.
+         */
+        if (omx_buffer->pAppPrivate)
+        {
+            GstBuffer *old_buf = omx_buffer->pAppPrivate;
+            gst_buffer_unref (old_buf);
+            omx_buffer->pAppPrivate = NULL;
+            omx_buffer->pBuffer = NULL;     /* just to ease debugging */
+        }
+
+        send_prep (port, omx_buffer, obj);
+
+        ret = omx_buffer->nFilledLen;
+        stats_add (port, &port->stats.bytes, ret);
+
+        release_buffer (port, omx_buffer);
+
+        return ret;
+    }
+
+    WARNING (port, "unknown obj type");
+    return -1;
+}
+
+/* copy the frame in @omx_buffer into a new buffer through the color
+ * conversion, if there is one.
+ *
+ * Allocating the buffer may renegotiate with downstream, which installs
+ * another conversion (see g_omx_port_set_convert()), so it is done with
+ * no lock held, and the frame then goes through the new conversion; the
+ * one we hold a reference to stays valid meanwhile either way.
+ */
+static gboolean
+recv_convert (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer, GstBuffer **buf)
+{
+    GOmxConvert *convert;
+    guint tries;
+
+    *buf = NULL;
+
+    for (tries = 0; !*buf && tries < 2 && (convert = get_convert (port)); tries++)
+    {
+        if (G_UNLIKELY (convert->in.size > omx_buffer->nAllocLen))
+        {
+            WARNING (port, "can't convert: %lu byte buffer, %u byte frames",
+                    omx_buffer->nAllocLen, convert->in.size);
+            g_omx_convert_unref (convert);
+            break;
+        }
+
+        *buf = buffer_alloc (port, convert->out.size);
+
+        /* renegotiated, try again with the new one; only once, in case
+         * downstream keeps changing its mind:
+         */
+        if (!tries && G_UNLIKELY (g_atomic_pointer_get (&port->convert) != convert))
+        {
+            gst_buffer_unref (*buf);
+            *buf = NULL;
+        }
+        else
+        {
+            g_omx_convert_run (convert, GST_BUFFER_DATA (*buf),
+                               omx_buffer->pBuffer, omx_buffer->nOffset);
+        }
+
+        g_omx_convert_unref (convert);
+    }
+
+    return *buf != NULL;
+}
+
+/**
+ * Receive a buffer/event from OMX component.  This handles the conversion
+ * of OMX buffer to GST buffer, codec-data, or EOS event.
+ *
+ * Returns <code>NULL</code> if buffer could not be received.
+ */
+gpointer
+g_omx_port_recv (GOmxPort *port)
+{
+    gpointer ret = NULL;
+
+    g_return_val_if_fail (port->type == GOMX_PORT_OUTPUT, NULL);
+
+    while (!ret && port->enabled)
+    {
+        gboolean held = FALSE, converted = FALSE;
+        OMX_BUFFERHEADERTYPE *omx_buffer = request_buffer (port);
+
+        if (G_UNLIKELY (!omx_buffer))
+        {
+            return NULL;
+        }
+
+        DEBUG (port, "omx_buffer=%p size=%lu, len=%lu, flags=%lu, offset=%lu, timestamp=%lld",
+                omx_buffer, omx_buffer->nAllocLen, omx_buffer->nFilledLen, omx_buffer->nFlags,
+                omx_buffer->nOffset, omx_buffer->nTimeStamp);
+
+        if (G_UNLIKELY (omx_buffer->nFlags & OMX_BUFFERFLAG_EOS))
+        {
+            DEBUG (port, "got eos");
+            g_omx_ppm_stop (port->core->ppm, "eos-drain");
+            ret = gst_event_new_eos ();
+        }
+        else if (G_LIKELY (omx_buffer->nFilledLen > 0))
+        {
+            GstBuffer *buf = omx_buffer->pAppPrivate;
+
+            /* I'm not really sure if it was intentional to block zero-copy of
+             * the codec-data buffer.. this is how the original code worked,
+             * so I kept the behavior
+             */
+            if (!buf && can_defer_release (port, omx_buffer))
+            {
+                buf = hold_buffer (port, omx_buffer, omx_buffer->nFilledLen);
+                held = TRUE;
+                g_atomic_int_inc (&port->stats.zero_copies);
+            }
+            else if (!buf || (omx_buffer->nFlags & OMX_BUFFERFLAG_CODECCONFIG))
+            {
                 if (buf)
                     gst_buffer_unref (buf);
 
-                buf = buffer_alloc (port, omx_buffer->nFilledLen);
-                memcpy (GST_BUFFER_DATA (buf),
-                        omx_buffer->pBuffer + omx_buffer->nOffset,
-                        omx_buffer->nFilledLen);
+                if (!(omx_buffer->nFlags & OMX_BUFFERFLAG_CODECCONFIG) &&
+                    recv_convert (port, omx_buffer, &buf))
+                {
+                    converted = TRUE;
+                }
+                else
+                {
+                    buf = buffer_alloc (port, omx_buffer->nFilledLen);
+                    memcpy (GST_BUFFER_DATA (buf),
+                            omx_buffer->pBuffer + omx_buffer->nOffset,
+                            omx_buffer->nFilledLen);
+                }
+                g_atomic_int_inc (&port->stats.copies);
             }
             else if (buf)
             {
@@ -631,8 +1339,11 @@ g_omx_port_recv (GOmxPort *port)
                  * when we allocated the buffer.
                  */
                 GST_BUFFER_SIZE (buf) = omx_buffer->nFilledLen;
+                g_atomic_int_inc (&port->stats.zero_copies);
             }
 
+            stats_add (port, &port->stats.bytes, omx_buffer->nFilledLen);
+
             if (port->core->use_timestamps)
             {
                 GST_BUFFER_TIMESTAMP (buf) = gst_util_uint64_scale_int (
@@ -645,7 +1356,12 @@ g_omx_port_recv (GOmxPort *port)
                 GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_IN_CAPS);
             }
 
-            port->n_offset = omx_buffer->nOffset;
+            /* the conversion already cropped the picture: */
+            port->n_offset = converted ? 0 : omx_buffer->nOffset;
+
+            G_OMX_TRACE (port, G_OMX_TRACE_RECV, omx_buffer);
+
+            g_omx_ppm_mark_once (port->core->ppm, &port->ppm_first, "first-buffer-out");
 
             ret = buf;
         }
@@ -700,6 +1416,12 @@ g_omx_port_recv (GOmxPort *port)
         }
         else
 #endif
+        if (held)
+        {
+            /* released when downstream unrefs the buffer */
+            LOG (port, "held buffer %p", omx_buffer);
+        }
+        else
         {
             setup_shared_buffer (port, omx_buffer);
             release_buffer (port, omx_buffer);
@@ -714,29 +1436,52 @@ void
 g_omx_port_resume (GOmxPort *port)
 {
     DEBUG (port, "resume");
-    async_queue_enable (port->queue);
+    ring_queue_enable (port->queue);
 }
 
 void
 g_omx_port_pause (GOmxPort *port)
 {
     DEBUG (port, "pause");
-    async_queue_disable (port->queue);
+    ring_queue_disable (port->queue);
 }
 
+/**
+ * Called once the component completed a flush of the port (see
+ * g_omx_core_flush): the component gave back all the buffers, so the
+ * output buffers we have received but not yet processed in the output
+ * loop are stale, and are all sent to be filled again.  Input buffers
+ * are just free.
+ */
 void
 g_omx_port_flush (GOmxPort *port)
 {
+    gint in_component;
+
     DEBUG (port, "begin");
 
+    if (port->type == GOMX_PORT_INPUT)
+        in_component = g_atomic_int_get (&port->stats.etb) - g_atomic_int_get (&port->stats.ebd);
+    else
+        in_component = g_atomic_int_get (&port->stats.ftb) - g_atomic_int_get (&port->stats.fbd);
+
+    if (in_component)
+        WARNING (port, "%d buffers still in the component after flush", in_component);
+
     if (port->type == GOMX_PORT_OUTPUT)
     {
-        /* This will get rid of any buffers that we have received, but not
-         * yet processed in the output_loop.
-         */
         OMX_BUFFERHEADERTYPE *omx_buffer;
-        while ((omx_buffer = async_queue_pop_full (port->queue, FALSE, TRUE)))
+        GList *released = NULL;
+
+        while ((omx_buffer = ring_queue_pop_full (port->queue, FALSE, TRUE)))
         {
+            /* the same buffer can be queued twice (see allocate_buffers),
+             * but must only be given back once:
+             */
+            if (g_list_find (released, omx_buffer))
+                continue;
+            released = g_list_prepend (released, omx_buffer);
+
             omx_buffer->nFilledLen = 0;
 
 #ifdef USE_OMXTICORE
@@ -756,12 +1501,10 @@ g_omx_port_flush (GOmxPort *port)
                 release_buffer (port, omx_buffer);
             }
         }
+
+        g_list_free (released);
     }
 
-    DEBUG (port, "SendCommand(Flush, %d)", port->port_index);
-    OMX_SendCommand (port->core->omx_handle, OMX_CommandFlush, port->port_index, NULL);
-    g_sem_down (port->core->flush_sem);
-    port->ignore_count = port->num_buffers;
     DEBUG (port, "end");
 }
 
@@ -823,7 +1566,500 @@ g_omx_port_finish (GOmxPort *port)
 {
     DEBUG (port, "finish");
     port->enabled = FALSE;
-    async_queue_disable (port->queue);
+    ring_queue_disable (port->queue);
+}
+
+/**
+ * Change the number of buffers of the port, within what the component
+ * allows.  If the port is running, its buffers are re-allocated, with a
+ * port disable/enable, so this must be called from the thread sending to
+ * (input) or receiving from (output) the port, between buffers.
+ */
+void
+g_omx_port_set_num_buffers (GOmxPort *port,
+                            guint num_buffers)
+{
+    OMX_PARAM_PORTDEFINITIONTYPE param;
+    gboolean running = port->enabled && port->buffers;
+
+    G_OMX_PORT_GET_DEFINITION (port, &param);
+
+    /* what the component needs wins, see G_OMX_PORT_MAX_BUFFERS: */
+    num_buffers = MAX (MIN (num_buffers, G_OMX_PORT_MAX_BUFFERS), param.nBufferCountMin);
+
+    if (num_buffers + port->num_imported == param.nBufferCountActual)
+        return;
+
+    DEBUG (port, "num_buffers: %lu -> %u",
+           param.nBufferCountActual - port->num_imported, num_buffers);
+
+    if (running)
+        g_omx_port_disable (port);
+
+    param.nBufferCountActual = num_buffers + port->num_imported;
+    G_OMX_PORT_SET_DEFINITION (port, &param);
+    port->num_buffers = num_buffers;
+
+    if (running)
+        g_omx_port_enable (port);
+}
+
+/**
+ * Install a color conversion, done while copying buffers to (input) or
+ * from (output) the component, taking ownership of @convert; pass
+ * <code>NULL</code> to remove it.  The conversion is not used for buffers
+ * which are shared or handed out without copying, so the caller must make
+ * sure the port copies.
+ *
+ * This can be called from the streaming thread of the port, ie. from a
+ * setcaps function while g_omx_port_recv() allocates a buffer: it takes
+ * effect with the next frame, and a frame being converted keeps the old
+ * conversion until it is done.
+ */
+void
+g_omx_port_set_convert (GOmxPort *port,
+                        GOmxConvert *convert)
+{
+    GOmxConvert *old;
+
+    g_mutex_lock (port->mutex);
+    old = port->convert;
+    g_atomic_pointer_set (&port->convert, convert);
+    g_mutex_unlock (port->mutex);
+
+    if (old)
+        g_omx_convert_unref (old);
+}
+
+/* NOTE ABOUT TUNNELS: when two components come from the same OpenMAX IL
+ * implementation, the output port of one can be connected to the input
+ * port of the other with OMX_SetupTunnel, after which the components pass
+ * the buffers to each other without us in between.  The buffers are
+ * allocated by one side, the supplier, and given to the other one with
+ * OMX_UseBuffer while both components go from Loaded to Idle, and freed
+ * again while both go back to Loaded, so neither of the two transitions
+ * can complete until the peer makes it too (see g_omx_core_unload).  Our
+ * side of a tunneled port has no buffers at all: it is skipped when
+ * allocating, starting and freeing buffers.
+ */
+
+/**
+ * Connect the output port @port to the input port @peer of another
+ * component, both in Loaded state.  The side which would otherwise allocate
+ * its buffers with OMX_AllocateBuffer is asked to be the supplier.
+ *
+ * Returns FALSE if the components cannot be tunneled, in which case the
+ * ports are left as they were.
+ */
+gboolean
+g_omx_port_setup_tunnel (GOmxPort *port,
+                         GOmxPort *peer)
+{
+    GOmxImp *imp = port->core->imp;
+    OMX_PARAM_BUFFERSUPPLIERTYPE param;
+    OMX_BUFFERSUPPLIERTYPE supplier;
+    OMX_ERRORTYPE omx_error;
+
+    g_return_val_if_fail (port->type == GOMX_PORT_OUTPUT, FALSE);
+    g_return_val_if_fail (peer->type == GOMX_PORT_INPUT, FALSE);
+
+    if (port->tunnel == peer)
+        return TRUE;
+
+    if (port->tunnel || peer->tunnel)
+        return FALSE;
+
+    if (!imp || imp != peer->core->imp || !imp->sym_table.setup_tunnel)
+    {
+        DEBUG (port, "can't tunnel to %s", peer->name);
+        return FALSE;
+    }
+
+    if (port->core->omx_state != OMX_StateLoaded ||
+        peer->core->omx_state != OMX_StateLoaded)
+    {
+        WARNING (port, "components not in Loaded state");
+        return FALSE;
+    }
+
+    if (port->omx_allocate || !peer->omx_allocate)
+        supplier = OMX_BufferSupplyOutput;
+    else
+        supplier = OMX_BufferSupplyInput;
+
+    /* only a preference, the components settle it in OMX_SetupTunnel: */
+    G_OMX_PORT_GET_PARAM (port, OMX_IndexParamCompBufferSupplier, &param);
+    param.eBufferSupplier = supplier;
+    G_OMX_PORT_SET_PARAM (port, OMX_IndexParamCompBufferSupplier, &param);
+
+    G_OMX_PORT_GET_PARAM (peer, OMX_IndexParamCompBufferSupplier, &param);
+    param.eBufferSupplier = supplier;
+    G_OMX_PORT_SET_PARAM (peer, OMX_IndexParamCompBufferSupplier, &param);
+
+    omx_error = imp->sym_table.setup_tunnel (port->core->omx_handle, port->port_index,
+                                             peer->core->omx_handle, peer->port_index);
+
+    DEBUG (port, "OMX_SetupTunnel(%s) -> %s", peer->name,
+           g_omx_error_to_str (omx_error));
+
+    if (omx_error != OMX_ErrorNone)
+        return FALSE;
+
+    G_OMX_PORT_GET_PARAM (port, OMX_IndexParamCompBufferSupplier, &param);
+    DEBUG (port, "buffer supplier: %d", param.eBufferSupplier);
+
+    port->tunnel = peer;
+    peer->tunnel = port;
+
+    return TRUE;
+}
+
+/**
+ * Disconnect the port from its tunnel peer, if any.  The components
+ * are only told while both are in Loaded state.
+ */
+void
+g_omx_port_teardown_tunnel (GOmxPort *port)
+{
+    GOmxPort *peer = port->tunnel;
+    GOmxPort *out_port, *in_port;
+    GOmxImp *imp;
+
+    if (!peer)
+        return;
+
+    out_port = (port->type == GOMX_PORT_OUTPUT) ? port : peer;
+    in_port = (port->type == GOMX_PORT_OUTPUT) ? peer : port;
+    imp = port->core->imp;
+
+    if (imp && port->core->omx_state == OMX_StateLoaded &&
+        peer->core->omx_state == OMX_StateLoaded)
+    {
+        imp->sym_table.setup_tunnel (out_port->core->omx_handle,
+                                     out_port->port_index, NULL, 0);
+        imp->sym_table.setup_tunnel (NULL, 0, in_port->core->omx_handle,
+                                     in_port->port_index);
+    }
+
+    DEBUG (port, "teardown tunnel with %s", peer->name);
+
+    port->tunnel = NULL;
+    peer->tunnel = NULL;
+}
+
+/* NOTE ABOUT IMPORTED BUFFERS: when two components can't be tunneled, the
+ * output buffers of the upstream one can still reach the downstream one
+ * without a copy.  The input port registers each of them a second time
+ * with OMX_UseBuffer, on top of its own buffers (port->imported, counted
+ * in nBufferCountActual), and the upstream port defers its releases (see
+ * NOTE ABOUT DEFERRED RELEASE) as long as it has importers
+ * (peer->n_importers), so the GstBuffers it pushes point right into that
+ * memory.  When such a buffer is sent, it goes to EmptyThisBuffer in the
+ * matching imported header, which holds a reference to the GstBuffer until
+ * the component gives it back; dropping it then gives the upstream buffer
+ * back to its component with FillThisBuffer.  Anything else is copied into
+ * our own buffers as usual.
+ *
+ * Both ports must be in UseBuffer mode: the component can't be handed the
+ * memory of another one, and the upstream memory (peer->arena) is ours, so
+ * the input port keeps a reference to it (port->imported_arena) until its
+ * own buffers are free'd, whatever upstream does meanwhile.  Upstream only
+ * publishes, and takes back, its buffers and its arena under
+ * peer->held_mutex, which is how both sides see a consistent set of them.
+ */
+
+/**
+ * Register the buffers of the output port @peer of the upstream element
+ * on the input port @port too, both ports of components not tunneled
+ * together, and both in UseBuffer mode.  @port must be in Loaded state
+ * and @peer must have its buffers already.  It only takes effect with the
+ * next g_omx_port_prepare(), and is undone when the buffers of @port are
+ * free'd, so @peer must not be free'd before that.
+ *
+ * Returns FALSE if the buffers of @peer can't be imported.
+ */
+gboolean
+g_omx_port_import (GOmxPort *port,
+                   GOmxPort *peer)
+{
+    g_return_val_if_fail (port->type == GOMX_PORT_INPUT, FALSE);
+    g_return_val_if_fail (peer->type == GOMX_PORT_OUTPUT, FALSE);
+
+    if (port->import == peer)
+        return TRUE;
+
+    if (port->tunnel || peer->tunnel || port->share_buffer || port->convert ||
+        peer->share_buffer || peer->convert ||
+        port->omx_allocate || peer->omx_allocate)
+    {
+        DEBUG (port, "can't import from %s", peer->name);
+        return FALSE;
+    }
+
+    if (port->core->omx_state != OMX_StateLoaded)
+    {
+        WARNING (port, "component not in Loaded state");
+        return FALSE;
+    }
+
+    unimport (port);
+
+    /* peer runs in another thread, which only looks at n_importers: */
+    g_mutex_lock (peer->held_mutex);
+    if (peer->arena)
+    {
+        g_atomic_int_inc (&peer->n_importers);
+        port->import = peer;
+    }
+    g_mutex_unlock (peer->held_mutex);
+
+    if (!port->import)
+    {
+        DEBUG (port, "%s has no buffers to import", peer->name);
+        return FALSE;
+    }
+
+    DEBUG (port, "import %d buffers from %s", peer->num_buffers, peer->name);
+
+    return TRUE;
+}
+
+/* undo g_omx_port_import(), with none of the buffers of port->import
+ * registered anymore:
+ */
+static void
+unimport (GOmxPort *port)
+{
+    GOmxPort *import = port->import;
+
+    if (!import)
+        return;
+
+    g_mutex_lock (import->held_mutex);
+    g_atomic_int_add (&import->n_importers, -1);
+    g_mutex_unlock (import->held_mutex);
+
+    port->import = NULL;
+}
+
+/* count the imported buffers in the port definition, unless some of them
+ * are too small for the component:
+ */
+static void
+prepare_import (GOmxPort *port, OMX_PARAM_PORTDEFINITIONTYPE *param)
+{
+    GOmxPort *import = port->import;
+    guint num_imported = 0;
+    guint i;
+
+    if (import)
+    {
+        g_mutex_lock (import->held_mutex);
+
+        if (import->arena)
+            num_imported = import->num_buffers;
+
+        for (i = 0; i < num_imported; i++)
+        {
+            if (import->buffers[i]->nAllocLen < param->nBufferSize)
+            {
+                DEBUG (port, "%s buffers too small: %lu < %lu", import->name,
+                        import->buffers[i]->nAllocLen, param->nBufferSize);
+                num_imported = 0;
+                break;
+            }
+        }
+
+        g_mutex_unlock (import->held_mutex);
+    }
+
+    if (!num_imported)
+        unimport (port);
+
+    if (num_imported != port->num_imported)
+    {
+        port->num_imported = num_imported;
+        param->nBufferCountActual = port->num_buffers + num_imported;
+        G_OMX_PORT_SET_DEFINITION (port, param);
+    }
+}
+
+/* register the buffers of port->import, the memory of which stays pinned
+ * until free_imported().  Upstream may have re-allocated them since
+ * prepare_import(), or the component may refuse them, in which case our
+ * own buffers take all the slots:
+ */
+static void
+allocate_imported (GOmxPort *port)
+{
+    GOmxPort *import = port->import;
+    OMX_BUFFERHEADERTYPE *peer_buffers;
+    OMX_ERRORTYPE omx_error = OMX_ErrorNone;
+    guint i;
+
+    port->imported = g_new0 (OMX_BUFFERHEADERTYPE *, port->num_imported);
+    peer_buffers = g_new (OMX_BUFFERHEADERTYPE, port->num_imported);
+
+    g_mutex_lock (import->held_mutex);
+    if (import->arena && import->num_buffers >= port->num_imported)
+    {
+        port->imported_arena = arena_ref (import->arena);
+        for (i = 0; i < port->num_imported; i++)
+            peer_buffers[i] = *import->buffers[i];
+    }
+    g_mutex_unlock (import->held_mutex);
+
+    if (!port->imported_arena)
+        omx_error = OMX_ErrorInsufficientResources;
+
+    for (i = 0; i < port->num_imported && omx_error == OMX_ErrorNone; i++)
+    {
+        DEBUG (port, "%d: OMX_UseBuffer(), imported from %s", i, import->name);
+        omx_error = OMX_UseBuffer (port->core->omx_handle,
+                                   &port->imported[i],
+                                   port->port_index,
+                                   NULL,
+                                   peer_buffers[i].nAllocLen,
+                                   peer_buffers[i].pBuffer);
+
+        if (omx_error != OMX_ErrorNone)
+            port->imported[i] = NULL;
+    }
+
+    g_free (peer_buffers);
+
+    if (omx_error != OMX_ErrorNone)
+    {
+        WARNING (port, "can't import from %s: %s", import->name,
+                 g_omx_error_to_str (omx_error));
+
+        port->num_buffers += port->num_imported;
+        free_imported (port);
+        port->num_imported = 0;
+    }
+}
+
+/* the imported buffers are not in port->queue: they are either idle, or
+ * with the component, which has returned them all by now:
+ */
+static void
+free_imported (GOmxPort *port)
+{
+    OMX_BUFFERHEADERTYPE *omx_buffer;
+    guint i;
+
+    for (i = 0; port->imported && i < port->num_imported; i++)
+    {
+        omx_buffer = port->imported[i];
+
+        if (!omx_buffer)
+            continue;
+
+        if (omx_buffer->pAppPrivate)
+        {
+            gst_buffer_unref (GST_BUFFER_CAST (omx_buffer->pAppPrivate));
+            omx_buffer->pAppPrivate = NULL;
+        }
+
+        DEBUG (port, "OMX_FreeBuffer(%p)", omx_buffer);
+        OMX_FreeBuffer (port->core->omx_handle, port->port_index, omx_buffer);
+    }
+
+    g_free (port->imported);
+    port->imported = NULL;
+
+    /* the component is done with that memory, upstream can have it back: */
+    arena_unref (port->imported_arena);
+    port->imported_arena = NULL;
+
+    unimport (port);
+}
+
+/**
+ * Called when the component is done with the input buffer @omx_buffer.
+ * If it is one of the imported buffers, drop the GstBuffer it was sent
+ * from, which gives the buffer back to the upstream component, from the
+ * calling thread.
+ *
+ * Returns FALSE if @omx_buffer is one of our own buffers.
+ */
+gboolean
+g_omx_port_release_imported (GOmxPort *port,
+                             OMX_BUFFERHEADERTYPE *omx_buffer)
+{
+    GstBuffer *buf;
+    guint i;
+
+    if (!port->imported)
+        return FALSE;
+
+    for (i = 0; i < port->num_imported; i++)
+    {
+        if (port->imported[i] != omx_buffer)
+            continue;
+
+        buf = omx_buffer->pAppPrivate;
+        omx_buffer->pAppPrivate = NULL;
+
+        if (buf)
+            gst_buffer_unref (buf);
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ * Snapshot of the port counters, see GOmxPortStats, plus the hits and
+ * misses of the buffer pool, if any.
+ */
+GstStructure *
+g_omx_port_get_stats (GOmxPort *port)
+{
+    GOmxPortStats *stats = &port->stats;
+    guint64 bytes, blocked;
+    gint pool_hits = 0, pool_misses = 0;
+
+    g_mutex_lock (port->stats_mutex);
+    bytes = stats->bytes;
+    blocked = stats->blocked;
+    if (port->pool)
+    {
+        pool_hits = g_atomic_int_get (&port->pool->hits);
+        pool_misses = g_atomic_int_get (&port->pool->misses);
+    }
+    g_mutex_unlock (port->stats_mutex);
+
+    return gst_structure_new ("omx-port-stats",
+            "etb", G_TYPE_INT, g_atomic_int_get (&stats->etb),
+            "ebd", G_TYPE_INT, g_atomic_int_get (&stats->ebd),
+            "ftb", G_TYPE_INT, g_atomic_int_get (&stats->ftb),
+            "fbd", G_TYPE_INT, g_atomic_int_get (&stats->fbd),
+            "bytes", G_TYPE_UINT64, bytes,
+            "queued", G_TYPE_INT, (gint) ring_queue_length (port->queue),
+            "peak-queued", G_TYPE_INT, g_atomic_int_get (&stats->peak_queued),
+            "blocked", G_TYPE_UINT64, blocked,
+            "copies", G_TYPE_INT, g_atomic_int_get (&stats->copies),
+            "zero-copies", G_TYPE_INT, g_atomic_int_get (&stats->zero_copies),
+            "pool-hits", G_TYPE_INT, pool_hits,
+            "pool-misses", G_TYPE_INT, pool_misses,
+            NULL);
+}
+
+/**
+ * Time spent waiting for a buffer so far, in us, see GOmxPortStats.
+ */
+guint64
+g_omx_port_get_blocked (GOmxPort *port)
+{
+    guint64 blocked;
+
+    g_mutex_lock (port->stats_mutex);
+    blocked = port->stats.blocked;
+    g_mutex_unlock (port->stats_mutex);
+
+    return blocked;
 }
 
 
@@ -30,9 +30,15 @@
 
 G_BEGIN_DECLS
 
+/** most buffers we ever ask for on a port, unless the component needs
+ *  more (nBufferCountMin) */
+#define G_OMX_PORT_MAX_BUFFERS 32
+
 /* Typedefs. */
 
 typedef enum GOmxPortType GOmxPortType;
+typedef struct GOmxPortStats GOmxPortStats;
+typedef struct GOmxArena GOmxArena;
 
 /* Enums. */
 
@@ -42,6 +48,24 @@ enum GOmxPortType
     GOMX_PORT_OUTPUT
 };
 
+/**
+ * Counters cheap enough to always keep.  The gint ones are updated with
+ * atomic ops; the 64 bit ones, which have none, under GOmxPort::stats_mutex
+ * (use g_omx_port_get_blocked() or g_omx_port_get_stats() to read them).
+ */
+struct GOmxPortStats
+{
+    volatile gint etb;          /**< OMX_EmptyThisBuffer calls */
+    volatile gint ebd;          /**< EmptyBufferDone callbacks */
+    volatile gint ftb;          /**< OMX_FillThisBuffer calls */
+    volatile gint fbd;          /**< FillBufferDone callbacks */
+    volatile gint peak_queued;  /**< max buffers waiting in the queue */
+    volatile gint copies;       /**< buffers passed by copying the data */
+    volatile gint zero_copies;  /**< buffers passed without copying */
+    guint64 bytes;              /**< sent to/received from the component */
+    guint64 blocked;            /**< us spent waiting for a buffer */
+};
+
 struct GOmxPort
 {
     GOmxCore *core;
@@ -55,14 +79,48 @@ struct GOmxPort
     GMutex *mutex;
     gboolean enabled;
     gboolean omx_allocate; /**< Setup with OMX_AllocateBuffer rather than OMX_UseBuffer */
-    AsyncQueue *queue;
+    RingQueue *queue;
 
     GstBuffer * (*buffer_alloc)(GOmxPort *port, gint len); /**< allows elements to override shared buffer allocation for output ports */
+    GOmxBufferPool *pool; /**< recycled buffers for copying out of non-shared output ports, replaced under stats_mutex */
+    GOmxArena *arena;     /**< backing memory of all the buffers, if we allocate it */
 
     /** @todo this is a hack.. OpenMAX IL spec should be revised. */
     gboolean share_buffer;
 
-    gint ignore_count;  /* XXX hack to work around seek bug w/ codec */
+    /** zero-copy output: hand out the OMX buffers themselves, and only give
+     *  them back to the component once downstream is done with them */
+    gboolean defer_release;
+    /** zero-copy input: lend free OMX buffers to upstream to write into */
+    gboolean export_buffers;
+    GList *held;        /**< buffers currently held downstream/upstream */
+    gint n_held;
+    gint n_releasing;   /**< returned, but not yet given back to the component */
+    GMutex *held_mutex;
+    GCond *held_cond;
+    GHashTable *exported; /**< data pointer -> buffer lent to upstream */
+    gint n_importers;   /**< input ports importing our buffers, see g_omx_port_import */
+
+    /** color conversion done while copying the data, if any; only used
+     *  when neither share_buffer nor defer_release apply */
+    GOmxConvert *convert;
+
+    /** port of another component this one passes its buffers to (output)
+     *  or gets them from (input) directly, see g_omx_port_setup_tunnel */
+    GOmxPort *tunnel;
+
+    /** input port: the output port of the upstream element whose buffers
+     *  are registered here too, see g_omx_port_import */
+    GOmxPort *import;
+    OMX_BUFFERHEADERTYPE **imported; /**< ours, one per buffer of import */
+    guint num_imported;              /**< counted in nBufferCountActual */
+    GOmxArena *imported_arena;       /**< the memory of import, pinned */
+
+    GOmxPortStats stats;
+    GMutex *stats_mutex;
+    volatile gint ppm_first;    /**< for the first-buffer-in/out marks */
+
+    gboolean flushing;  /**< waiting for the component to complete a flush */
 
     /** nOffset value of the last received (input) or next sent (output) port */
     guint n_offset;     /* a bit ugly.. but..  */
@@ -113,9 +171,18 @@ void g_omx_port_flush (GOmxPort *port);
 void g_omx_port_enable (GOmxPort *port);
 void g_omx_port_disable (GOmxPort *port);
 void g_omx_port_finish (GOmxPort *port);
+void g_omx_port_set_num_buffers (GOmxPort *port, guint num_buffers);
 void g_omx_port_push_buffer (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer);
 gint g_omx_port_send (GOmxPort *port, gpointer obj);
 gpointer g_omx_port_recv (GOmxPort *port);
+GstBuffer * g_omx_port_request_input_buffer (GOmxPort *port, guint len);
+void g_omx_port_set_convert (GOmxPort *port, GOmxConvert *convert);
+gboolean g_omx_port_setup_tunnel (GOmxPort *port, GOmxPort *peer);
+void g_omx_port_teardown_tunnel (GOmxPort *port);
+gboolean g_omx_port_import (GOmxPort *port, GOmxPort *peer);
+gboolean g_omx_port_release_imported (GOmxPort *port, OMX_BUFFERHEADERTYPE *omx_buffer);
+GstStructure * g_omx_port_get_stats (GOmxPort *port);
+guint64 g_omx_port_get_blocked (GOmxPort *port);
 
 /*
  * Some domain specific port related utility functions:
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <time.h>
+
+#include "gstomx_ppm.h"
+#include "gstomx.h"
+
+typedef struct GOmxPpmEntry GOmxPpmEntry;
+
+struct GOmxPpmEntry
+{
+    gboolean span;      /**< started/stopped rather than marked */
+    guint count;        /**< marks, or completed spans */
+    guint64 first;      /**< first mark, relative to origin */
+    guint64 started;    /**< start of the running span, 0 if none */
+    guint64 total;
+    guint64 min;
+    guint64 max;
+};
+
+static inline gboolean
+enabled (void)
+{
+    return gst_debug_category_get_threshold (gstomx_ppm) >= GST_LEVEL_INFO;
+}
+
+static GOmxPpmEntry *
+get_entry (GOmxPpm *ppm,
+           const gchar *name)
+{
+    GOmxPpmEntry *entry;
+
+    entry = g_hash_table_lookup (ppm->entries, name);
+
+    if (!entry)
+    {
+        entry = g_new0 (GOmxPpmEntry, 1);
+        g_hash_table_insert (ppm->entries, (gpointer) name, entry);
+    }
+
+    return entry;
+}
+
+/**
+ * Monotonic time in us, unlike the OMX or GStreamer clocks it does not
+ * depend on the pipeline.
+ */
+guint64
+g_omx_ppm_now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return (guint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+GOmxPpm *
+g_omx_ppm_new (gpointer object)
+{
+    GOmxPpm *ppm = g_new0 (GOmxPpm, 1);
+
+    ppm->object = object;
+    ppm->mutex = g_mutex_new ();
+    ppm->entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+    ppm->origin = g_omx_ppm_now ();
+    ppm->generation = 1;
+
+    return ppm;
+}
+
+void
+g_omx_ppm_free (GOmxPpm *ppm)
+{
+    g_hash_table_destroy (ppm->entries);
+    g_mutex_free (ppm->mutex);
+    g_free (ppm);
+}
+
+/**
+ * Forget everything recorded so far, and start counting marks from now.
+ */
+void
+g_omx_ppm_reset (GOmxPpm *ppm)
+{
+    g_mutex_lock (ppm->mutex);
+    g_hash_table_remove_all (ppm->entries);
+    ppm->origin = g_omx_ppm_now ();
+    g_atomic_int_inc (&ppm->generation);
+    g_mutex_unlock (ppm->mutex);
+}
+
+void
+g_omx_ppm_mark (GOmxPpm *ppm,
+                const gchar *name)
+{
+    GOmxPpmEntry *entry;
+    guint64 time;
+
+    if (!enabled ())
+        return;
+
+    g_mutex_lock (ppm->mutex);
+
+    time = g_omx_ppm_now () - ppm->origin;
+
+    entry = get_entry (ppm, name);
+    if (!entry->count++)
+        entry->first = time;
+
+    g_mutex_unlock (ppm->mutex);
+
+    GST_CAT_INFO_OBJECT (gstomx_ppm, ppm->object, "%s at %" G_GUINT64_FORMAT " us",
+                         name, time);
+}
+
+/**
+ * Mark @name only the first time since the last reset.  @generation, which
+ * starts at 0, keeps track of the last reset it was marked after, so this
+ * takes no lock once marked, and can go on a per buffer path.
+ */
+void
+g_omx_ppm_mark_once (GOmxPpm *ppm,
+                     volatile gint *generation,
+                     const gchar *name)
+{
+    gint current, last;
+
+    if (!enabled ())
+        return;
+
+    current = g_atomic_int_get (&ppm->generation);
+    last = g_atomic_int_get (generation);
+
+    if (G_LIKELY (last == current) ||
+        !g_atomic_int_compare_and_exchange (generation, last, current))
+        return;
+
+    g_omx_ppm_mark (ppm, name);
+}
+
+void
+g_omx_ppm_start (GOmxPpm *ppm,
+                 const gchar *name)
+{
+    GOmxPpmEntry *entry;
+
+    if (!enabled ())
+        return;
+
+    g_mutex_lock (ppm->mutex);
+    entry = get_entry (ppm, name);
+    entry->span = TRUE;
+    entry->started = g_omx_ppm_now ();
+    g_mutex_unlock (ppm->mutex);
+
+    GST_CAT_INFO_OBJECT (gstomx_ppm, ppm->object, "%s started", name);
+}
+
+/**
+ * Stop the span @name, if it was started.
+ */
+void
+g_omx_ppm_stop (GOmxPpm *ppm,
+                const gchar *name)
+{
+    GOmxPpmEntry *entry;
+    guint64 duration;
+
+    if (!enabled ())
+        return;
+
+    g_mutex_lock (ppm->mutex);
+
+    entry = g_hash_table_lookup (ppm->entries, name);
+
+    if (!entry || !entry->started)
+    {
+        g_mutex_unlock (ppm->mutex);
+        return;
+    }
+
+    duration = g_omx_ppm_now () - entry->started;
+    entry->started = 0;
+
+    if (!entry->count++ || duration < entry->min)
+        entry->min = duration;
+    entry->max = MAX (entry->max, duration);
+    entry->total += duration;
+
+    g_mutex_unlock (ppm->mutex);
+
+    GST_CAT_INFO_OBJECT (gstomx_ppm, ppm->object, "%s took %" G_GUINT64_FORMAT " us",
+                         name, duration);
+}
+
+static void
+report_entry (gpointer key,
+              gpointer value,
+              gpointer user_data)
+{
+    const gchar *name = key;
+    GOmxPpmEntry *entry = value;
+    GOmxPpm *ppm = user_data;
+
+    if (!entry->count)
+        return;
+
+    if (entry->span)
+    {
+        GST_CAT_INFO_OBJECT (gstomx_ppm, ppm->object,
+                "  %-20s %4u x avg %" G_GUINT64_FORMAT " us, min %" G_GUINT64_FORMAT
+                " us, max %" G_GUINT64_FORMAT " us", name, entry->count,
+                entry->total / entry->count, entry->min, entry->max);
+    }
+    else
+    {
+        GST_CAT_INFO_OBJECT (gstomx_ppm, ppm->object,
+                "  %-20s %4u x first at %" G_GUINT64_FORMAT " us", name,
+                entry->count, entry->first);
+    }
+}
+
+/**
+ * Log a summary of everything recorded since the last reset, and reset.
+ */
+void
+g_omx_ppm_report (GOmxPpm *ppm)
+{
+    if (!enabled ())
+        return;
+
+    g_mutex_lock (ppm->mutex);
+
+    if (g_hash_table_size (ppm->entries))
+    {
+        GST_CAT_INFO_OBJECT (gstomx_ppm, ppm->object, "summary:");
+        g_hash_table_foreach (ppm->entries, report_entry, ppm);
+    }
+
+    g_hash_table_remove_all (ppm->entries);
+    ppm->origin = g_omx_ppm_now ();
+    g_atomic_int_inc (&ppm->generation);
+
+    g_mutex_unlock (ppm->mutex);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef GSTOMX_PPM_H
+#define GSTOMX_PPM_H
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Typedefs. */
+
+typedef struct GOmxPpm GOmxPpm;
+
+/* Structures. */
+
+/**
+ * Performance markers of one element, logged in the omx_ppm debug category
+ * (at INFO level) and summed up by g_omx_ppm_report().  Marks are points
+ * in time, relative to the last reset; spans measure the time between a
+ * start and a stop of the same name.  Names must be static strings.
+ *
+ * Nothing is recorded unless the omx_ppm category is enabled, so markers
+ * are cheap, but they do take a lock: use them for events, not per buffer.
+ */
+struct GOmxPpm
+{
+    gpointer object;    /**< element, for logging */
+    GMutex *mutex;
+    GHashTable *entries;
+    guint64 origin;     /**< time of the last reset, in us */
+    volatile gint generation;   /**< bumped by each reset, see g_omx_ppm_mark_once */
+};
+
+/* Functions. */
+
+guint64 g_omx_ppm_now (void);
+
+GOmxPpm *g_omx_ppm_new (gpointer object);
+void g_omx_ppm_free (GOmxPpm *ppm);
+void g_omx_ppm_reset (GOmxPpm *ppm);
+void g_omx_ppm_mark (GOmxPpm *ppm, const gchar *name);
+void g_omx_ppm_mark_once (GOmxPpm *ppm, volatile gint *generation, const gchar *name);
+void g_omx_ppm_start (GOmxPpm *ppm, const gchar *name);
+void g_omx_ppm_stop (GOmxPpm *ppm, const gchar *name);
+void g_omx_ppm_report (GOmxPpm *ppm);
+
+G_END_DECLS
+
+#endif /* GSTOMX_PPM_H */
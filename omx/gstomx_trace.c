@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gstomx_trace.h"
+#include "gstomx.h"
+
+/* NOTE ABOUT TRACING:
+ *
+ * When the OMX_TRACE env variable is set to a file name, every transition
+ * of every OMX buffer (see GOmxTraceType) is recorded, and the last ones
+ * are written to that file at exit (or whenever g_omx_trace_dump() is
+ * called) in the Chrome trace-event format, which can be loaded in
+ * chrome://tracing.  Each buffer shows as a row of spans: "component"
+ * while the component owns it, and "fill"/"free" (input) or
+ * "queued"/"downstream" (output) while we do.
+ *
+ * Recording takes no lock: writers claim a slot of the ring with an atomic
+ * increment, and mark it complete with its sequence number once filled,
+ * so the dump can skip slots that are being (over)written.  The counter
+ * wraps around after 2^32 events, so it is only ever compared modulo
+ * that, and the ring size is a power of two so the slots keep going round
+ * in order when it does.
+ */
+
+#define TRACE_DEFAULT_SIZE 65536
+
+typedef struct GOmxTraceEvent GOmxTraceEvent;
+
+struct GOmxTraceEvent
+{
+    volatile guint sequence; /**< index + 1 of the event once complete, or 0 */
+    GOmxTraceType type;
+    guint64 time;           /**< in us, monotonic */
+    gpointer omx_buffer;
+    gchar element[32];
+    gchar port[16];
+};
+
+gboolean g_omx_trace_enabled;
+
+static GOmxTraceEvent *events;
+static guint n_events;
+static volatile guint next_event;
+static gchar *trace_path;
+
+static const struct
+{
+    const gchar *end;
+    const gchar *begin;
+} spans[] =
+{
+    [G_OMX_TRACE_SEND] = { "free",       "fill" },
+    [G_OMX_TRACE_ETB]  = { "fill",       "component" },
+    [G_OMX_TRACE_EBD]  = { "component",  "free" },
+    [G_OMX_TRACE_FTB]  = { "downstream", "component" },
+    [G_OMX_TRACE_FBD]  = { "component",  "queued" },
+    [G_OMX_TRACE_RECV] = { "queued",     "downstream" },
+};
+
+static const gchar *names[] =
+{
+    [G_OMX_TRACE_SEND] = "send",
+    [G_OMX_TRACE_ETB]  = "ETB",
+    [G_OMX_TRACE_EBD]  = "EBD",
+    [G_OMX_TRACE_FTB]  = "FTB",
+    [G_OMX_TRACE_FBD]  = "FBD",
+    [G_OMX_TRACE_RECV] = "recv",
+};
+
+static inline guint64
+now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return (guint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+static void
+dump_at_exit (void)
+{
+    g_omx_trace_dump (trace_path);
+}
+
+void
+g_omx_trace_init (void)
+{
+    const gchar *env;
+
+    if (g_omx_trace_enabled)
+        return;
+
+    env = g_getenv ("OMX_TRACE");
+    if (!env)
+        return;
+
+    trace_path = g_strdup (env);
+
+    env = g_getenv ("OMX_TRACE_SIZE");
+    n_events = env ? atoi (env) : 0;
+    if (!n_events)
+        n_events = TRACE_DEFAULT_SIZE;
+    n_events = MIN (n_events, G_MAXUINT / 2 + 1);
+    n_events = 1U << g_bit_storage (n_events - 1);
+
+    events = g_new0 (GOmxTraceEvent, n_events);
+
+    atexit (dump_at_exit);
+
+    g_omx_trace_enabled = TRUE;
+
+    GST_INFO ("tracing %u events to %s", n_events, trace_path);
+}
+
+void
+g_omx_trace_event (GOmxPort *port,
+                   GOmxTraceType type,
+                   OMX_BUFFERHEADERTYPE *omx_buffer)
+{
+    GOmxTraceEvent *event;
+    guint index;
+
+    index = (guint) g_atomic_int_exchange_and_add ((volatile gint *) &next_event, 1);
+    event = &events[index & (n_events - 1)];
+
+    /* mark it incomplete while we fill it: */
+    g_atomic_int_set ((volatile gint *) &event->sequence, 0);
+
+    event->type = type;
+    event->time = now ();
+    event->omx_buffer = omx_buffer;
+    g_strlcpy (event->element, GST_OBJECT_NAME (port->core->object), sizeof (event->element));
+    g_strlcpy (event->port, port->name, sizeof (event->port));
+
+    g_atomic_int_set ((volatile gint *) &event->sequence, index + 1);
+}
+
+static void
+write_event (FILE *file,
+             GOmxTraceEvent *event,
+             const gchar *phase,
+             const gchar *name,
+             gboolean *first)
+{
+    fprintf (file, "%s\n{\"name\":\"%s\",\"cat\":\"%s:%s\",\"ph\":\"%s\","
+                   "\"ts\":%" G_GUINT64_FORMAT ",\"pid\":%d,\"tid\":1,"
+                   "\"id\":\"%p\",\"args\":{\"event\":\"%s\"}}",
+             *first ? "" : ",", name, event->element, event->port, phase,
+             event->time, (gint) getpid (), event->omx_buffer, names[event->type]);
+
+    *first = FALSE;
+}
+
+/**
+ * Write the recorded events to @path, in Chrome trace-event format.
+ */
+gboolean
+g_omx_trace_dump (const gchar *path)
+{
+    FILE *file;
+    guint end, index, i, count = 0;
+    gboolean first = TRUE;
+
+    if (!g_omx_trace_enabled)
+        return FALSE;
+
+    file = fopen (path, "w");
+    if (!file)
+    {
+        GST_WARNING ("could not open %s", path);
+        return FALSE;
+    }
+
+    end = (guint) g_atomic_int_get ((volatile gint *) &next_event);
+
+    fprintf (file, "{\"traceEvents\":[");
+
+    /* the last n_events ones, oldest first; slots never written yet are
+     * still 0, like the ones being written:
+     */
+    for (i = 0; i < n_events; i++)
+    {
+        GOmxTraceEvent *event;
+        GOmxTraceEvent copy;
+        guint sequence;
+
+        index = end - n_events + i;
+        event = &events[index & (n_events - 1)];
+
+        /* skip it if being written, or overwritten by a newer one, before
+         * or while we copy it:
+         */
+        sequence = (guint) g_atomic_int_get ((volatile gint *) &event->sequence);
+        if (sequence == 0 || sequence != index + 1)
+            continue;
+        copy = *event;
+        if ((guint) g_atomic_int_get ((volatile gint *) &event->sequence) != sequence)
+            continue;
+
+        write_event (file, &copy, "e", spans[copy.type].end, &first);
+        write_event (file, &copy, "b", spans[copy.type].begin, &first);
+        count++;
+    }
+
+    fprintf (file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose (file);
+
+    GST_INFO ("dumped %u events to %s", count, path);
+
+    return TRUE;
+}
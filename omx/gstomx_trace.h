@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef GSTOMX_TRACE_H
+#define GSTOMX_TRACE_H
+
+#include <gst/gst.h>
+
+#include "gstomx_util.h"
+
+G_BEGIN_DECLS
+
+/* Typedefs. */
+
+typedef enum GOmxTraceType GOmxTraceType;
+
+/* Enums. */
+
+/** points in the life of an OMX buffer */
+enum GOmxTraceType
+{
+    G_OMX_TRACE_SEND,   /**< input buffer taken to be filled */
+    G_OMX_TRACE_ETB,
+    G_OMX_TRACE_EBD,
+    G_OMX_TRACE_FTB,
+    G_OMX_TRACE_FBD,
+    G_OMX_TRACE_RECV,   /**< output buffer handed to the element */
+};
+
+/* Macros. */
+
+extern gboolean g_omx_trace_enabled;
+
+/** record an event, only costs a test when tracing is not enabled */
+#define G_OMX_TRACE(port, type, omx_buffer) G_STMT_START {                    \
+        if (G_UNLIKELY (g_omx_trace_enabled))                                 \
+            g_omx_trace_event ((port), (type), (omx_buffer));                 \
+    } G_STMT_END
+
+/* Functions. */
+
+void g_omx_trace_init (void);
+void g_omx_trace_event (GOmxPort *port, GOmxTraceType type, OMX_BUFFERHEADERTYPE *omx_buffer);
+gboolean g_omx_trace_dump (const gchar *path);
+
+G_END_DECLS
+
+#endif /* GSTOMX_TRACE_H */
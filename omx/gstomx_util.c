@@ -23,6 +23,7 @@
 #include "gstomx_util.h"
 #include <dlfcn.h>
 #include <string.h>
+#include <stdlib.h>
 
 #include "gstomx.h"
 
@@ -34,13 +35,35 @@ static GMutex *imp_mutex;
 static GHashTable *implementations;
 static gboolean initialized;
 
+/* idle component handles, most recently used first */
+static GMutex *handle_pool_mutex;
+static GQueue *handle_pool;
+static guint handle_pool_size;      /* 0 means no pooling */
+static guint handle_pool_timeout;   /* in seconds, 0 means forever */
+static GCond *handle_pool_cond;
+static GThread *handle_pool_reaper;
+static gboolean handle_pool_quit;
+
+#define HANDLE_POOL_DEFAULT_TIMEOUT 30
+
+/* hardware admission control */
+static ResourceManager *resource_manager;
+static guint resource_timeout;      /* in ms */
+
+#define RESOURCE_DEFAULT_TIMEOUT 10000
+
+/* tuned buffer counts */
+static GMutex *buffer_cache_mutex;
+static gchar *buffer_cache_path;
+
 
 /*
  * Main
  */
 
 static GOmxImp *
-imp_new (const gchar *name)
+imp_new (const gchar *name,
+         gboolean preload)
 {
     GOmxImp *imp;
 
@@ -50,11 +73,15 @@ imp_new (const gchar *name)
     {
         void *handle;
 
-        imp->dl_handle = handle = dlopen (name, RTLD_LAZY);
+        /* when preloading, resolve everything now rather than on first use */
+        imp->dl_handle = handle = dlopen (name, preload ? RTLD_NOW : RTLD_LAZY);
         GST_DEBUG ("dlopen(%s) -> %p", name, handle);
         if (!handle)
         {
-            g_warning ("%s\n", dlerror ());
+            if (preload)
+                GST_DEBUG ("%s", dlerror ());
+            else
+                g_warning ("%s\n", dlerror ());
             g_free (imp);
             return NULL;
         }
@@ -64,6 +91,7 @@ imp_new (const gchar *name)
         imp->sym_table.deinit = dlsym (handle, "OMX_Deinit");
         imp->sym_table.get_handle = dlsym (handle, "OMX_GetHandle");
         imp->sym_table.free_handle = dlsym (handle, "OMX_FreeHandle");
+        imp->sym_table.setup_tunnel = dlsym (handle, "OMX_SetupTunnel");
     }
 
     return imp;
@@ -84,8 +112,9 @@ imp_free (GOmxImp *imp)
  * Helpers used by GOmxCore:
  */
 
-GOmxImp *
-g_omx_request_imp (const gchar *name)
+static GOmxImp *
+request_imp (const gchar *name,
+             gboolean preload)
 {
     GOmxImp *imp = NULL;
 
@@ -93,7 +122,7 @@ g_omx_request_imp (const gchar *name)
     imp = g_hash_table_lookup (implementations, name);
     if (!imp)
     {
-        imp = imp_new (name);
+        imp = imp_new (name, preload);
         if (imp)
             g_hash_table_insert (implementations, g_strdup (name), imp);
     }
@@ -119,6 +148,12 @@ g_omx_request_imp (const gchar *name)
     return imp;
 }
 
+GOmxImp *
+g_omx_request_imp (const gchar *name)
+{
+    return request_imp (name, FALSE);
+}
+
 void
 g_omx_release_imp (GOmxImp *imp)
 {
@@ -131,10 +166,424 @@ g_omx_release_imp (GOmxImp *imp)
     g_mutex_unlock (imp->mutex);
 }
 
+/*
+ * Handle pool:
+ */
+
+/* NOTE ABOUT THE HANDLE POOL: getting a component handle (and setting its
+ * role) can be expensive, and elements get a new one on every NULL->READY.
+ * If OMX_HANDLE_POOL_SIZE is set, that many handles which were left in the
+ * Loaded state are kept around on READY->NULL, and given back to the next
+ * core asking for the same library/component/role.  Handles not reused
+ * within OMX_HANDLE_POOL_TIMEOUT seconds are free'd.
+ *
+ * A reused handle keeps the port settings of its previous user, but every
+ * element (re)configures its ports before going to Idle anyways.
+ */
+
+GOmxHandle *
+g_omx_handle_new (GOmxImp *imp,
+                  const gchar *key)
+{
+    GOmxHandle *handle = g_new0 (GOmxHandle, 1);
+
+    handle->imp = imp;
+    handle->key = g_strdup (key);
+
+    return handle;
+}
+
+void
+g_omx_handle_free (GOmxHandle *handle)
+{
+    g_free (handle->key);
+    g_free (handle);
+}
+
+/* really get rid of a pooled handle */
+static void
+handle_destroy (GOmxHandle *handle)
+{
+    OMX_ERRORTYPE omx_error;
+
+    omx_error = handle->imp->sym_table.free_handle (handle->omx_handle);
+    GST_DEBUG ("OMX_FreeHandle(%p) -> %s", handle->omx_handle,
+               g_omx_error_to_str (omx_error));
+
+    g_omx_release_imp (handle->imp);
+    g_omx_handle_free (handle);
+}
+
+static void
+handle_list_destroy (GList *list)
+{
+    GList *l;
+
+    for (l = list; l; l = l->next)
+        handle_destroy (l->data);
+
+    g_list_free (list);
+}
+
+static gpointer
+handle_pool_reaper_thread (gpointer data)
+{
+    g_mutex_lock (handle_pool_mutex);
+
+    while (!handle_pool_quit)
+    {
+        GOmxHandle *oldest = g_queue_peek_tail (handle_pool);
+        GTimeVal now, expire;
+
+        if (!oldest)
+        {
+            g_cond_wait (handle_pool_cond, handle_pool_mutex);
+            continue;
+        }
+
+        expire = oldest->idle_since;
+        g_time_val_add (&expire, handle_pool_timeout * G_USEC_PER_SEC);
+        g_get_current_time (&now);
+
+        if (now.tv_sec < expire.tv_sec ||
+            (now.tv_sec == expire.tv_sec && now.tv_usec < expire.tv_usec))
+        {
+            g_cond_timed_wait (handle_pool_cond, handle_pool_mutex, &expire);
+            continue;
+        }
+
+        g_queue_pop_tail (handle_pool);
+
+        /* OMX_FreeHandle() can take a while, don't block the pool: */
+        g_mutex_unlock (handle_pool_mutex);
+        GST_DEBUG ("handle %p (%s) expired", oldest->omx_handle, oldest->key);
+        handle_destroy (oldest);
+        g_mutex_lock (handle_pool_mutex);
+    }
+
+    g_mutex_unlock (handle_pool_mutex);
+
+    return NULL;
+}
+
+/**
+ * Get an idle handle for @key out of the pool, or <code>NULL</code> if
+ * there is none.
+ */
+GOmxHandle *
+g_omx_handle_pool_take (const gchar *key)
+{
+    GOmxHandle *handle = NULL;
+    GList *l;
+
+    if (!handle_pool_size)
+        return NULL;
+
+    g_mutex_lock (handle_pool_mutex);
+
+    for (l = handle_pool->head; l; l = l->next)
+    {
+        GOmxHandle *h = l->data;
+
+        if (!strcmp (h->key, key))
+        {
+            handle = h;
+            g_queue_delete_link (handle_pool, l);
+            break;
+        }
+    }
+
+    g_mutex_unlock (handle_pool_mutex);
+
+    if (handle)
+        GST_DEBUG ("reusing handle %p (%s)", handle->omx_handle, key);
+
+    return handle;
+}
+
+/**
+ * Put an idle handle, in the Loaded state, in the pool.  The pool takes
+ * over the handle and its reference on the implementation.  Returns FALSE
+ * if pooling is disabled, in which case the caller should free the handle
+ * itself.
+ */
+gboolean
+g_omx_handle_pool_put (GOmxHandle *handle)
+{
+    GList *evicted = NULL;
+
+    if (!handle_pool_size)
+        return FALSE;
+
+    g_atomic_pointer_set ((gpointer *) &handle->core, NULL);
+    g_get_current_time (&handle->idle_since);
+
+    g_mutex_lock (handle_pool_mutex);
+
+    g_queue_push_head (handle_pool, handle);
+
+    while (g_queue_get_length (handle_pool) > handle_pool_size)
+        evicted = g_list_prepend (evicted, g_queue_pop_tail (handle_pool));
+
+    if (handle_pool_timeout && !handle_pool_reaper)
+    {
+        handle_pool_reaper = g_thread_create (handle_pool_reaper_thread,
+                                              NULL, TRUE, NULL);
+    }
+
+    g_cond_signal (handle_pool_cond);
+
+    g_mutex_unlock (handle_pool_mutex);
+
+    GST_DEBUG ("pooled handle %p (%s)", handle->omx_handle, handle->key);
+
+    handle_list_destroy (evicted);
+
+    return TRUE;
+}
+
+/*
+ * Resources:
+ */
+
+/* NOTE ABOUT RESOURCES: by default components are not limited, so running
+ * too many pipelines at once fails somewhere in the component when it runs
+ * out of hardware.  OMX_RESOURCE_CAPACITY sets how much each component can
+ * take, as a comma separated list of name=capacity, ie:
+ *
+ *   OMX_RESOURCE_CAPACITY=OMX.TI.DUCATI1.VIDEO.DECODER=979200
+ *
+ * The cost of a session is in macroblocks per second for video components
+ * and 1 otherwise, so the capacity of an audio component is its max number
+ * of instances.  Sessions that don't fit wait up to OMX_RESOURCE_TIMEOUT ms
+ * (0 to reject right away), highest priority first.
+ */
+
+static void
+resource_init (void)
+{
+    const gchar *env;
+
+    resource_manager = resource_manager_new ();
+
+    env = g_getenv ("OMX_RESOURCE_TIMEOUT");
+    resource_timeout = env ? atoi (env) : RESOURCE_DEFAULT_TIMEOUT;
+
+    env = g_getenv ("OMX_RESOURCE_CAPACITY");
+    if (env)
+    {
+        gchar **entries;
+        guint i;
+
+        entries = g_strsplit (env, ",", 0);
+
+        for (i = 0; entries[i]; i++)
+        {
+            gchar *sep = strrchr (entries[i], '=');
+
+            if (!sep)
+            {
+                GST_WARNING ("invalid resource capacity: %s", entries[i]);
+                continue;
+            }
+
+            *sep = '\0';
+            resource_manager_set_capacity (resource_manager, entries[i],
+                                           g_ascii_strtoull (sep + 1, NULL, 10));
+            GST_DEBUG ("capacity of %s: %s", entries[i], sep + 1);
+        }
+
+        g_strfreev (entries);
+    }
+}
+
+/**
+ * Reserve @cost of the hardware used by component @name.  Returns
+ * <code>NULL</code> if it is not available, after waiting for it if so
+ * configured.
+ */
+ResourceSession *
+g_omx_request_resource (const gchar *name,
+                        guint64 cost,
+                        gint priority)
+{
+    ResourceSession *session;
+    guint64 used, capacity;
+    guint sessions;
+
+    session = resource_manager_acquire (resource_manager, name, cost,
+                                        priority, resource_timeout);
+
+    used = resource_manager_get_usage (resource_manager, name, &capacity, &sessions);
+
+    GST_INFO ("%s: %s %" G_GUINT64_FORMAT " (priority %d), usage %"
+              G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT " in %u sessions",
+              name, session ? "got" : "refused", cost, priority,
+              used, capacity, sessions);
+
+    return session;
+}
+
+void
+g_omx_release_resource (ResourceSession *session)
+{
+    const gchar *name = session->resource->name;
+    guint64 used, capacity;
+    guint sessions;
+
+    resource_manager_release (resource_manager, session);
+
+    used = resource_manager_get_usage (resource_manager, name, &capacity, &sessions);
+
+    GST_INFO ("%s: usage %" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT
+              " in %u sessions", name, used, capacity, sessions);
+}
+
+/*
+ * Buffer counts:
+ */
+
+/* NOTE ABOUT THE BUFFER CACHE: elements with auto-buffers on remember
+ * the buffer counts they settled on, so the next run starts from there.
+ * They are kept in a key file, one group per component and resolution,
+ * in OMX_BUFFER_CACHE (default $XDG_CACHE_HOME/gst-openmax/buffers).
+ */
+
+static GKeyFile *
+buffer_cache_load (void)
+{
+    GKeyFile *key_file = g_key_file_new ();
+
+    /* a missing or broken file is just an empty cache: */
+    g_key_file_load_from_file (key_file, buffer_cache_path, G_KEY_FILE_NONE, NULL);
+
+    return key_file;
+}
+
+/**
+ * Look up the buffer counts stored for @key.  Returns FALSE if there are
+ * none.
+ */
+gboolean
+g_omx_buffer_cache_lookup (const gchar *key,
+                           guint *num_input,
+                           guint *num_output)
+{
+    GKeyFile *key_file;
+    gboolean found;
+
+    g_mutex_lock (buffer_cache_mutex);
+
+    key_file = buffer_cache_load ();
+
+    found = g_key_file_has_key (key_file, key, "input", NULL) &&
+            g_key_file_has_key (key_file, key, "output", NULL);
+
+    if (found)
+    {
+        *num_input = g_key_file_get_integer (key_file, key, "input", NULL);
+        *num_output = g_key_file_get_integer (key_file, key, "output", NULL);
+    }
+
+    g_key_file_free (key_file);
+
+    g_mutex_unlock (buffer_cache_mutex);
+
+    return found;
+}
+
+void
+g_omx_buffer_cache_store (const gchar *key,
+                          guint num_input,
+                          guint num_output)
+{
+    GKeyFile *key_file;
+    gchar *data, *dir;
+    gsize length;
+    GError *error = NULL;
+
+    g_mutex_lock (buffer_cache_mutex);
+
+    key_file = buffer_cache_load ();
+
+    g_key_file_set_integer (key_file, key, "input", num_input);
+    g_key_file_set_integer (key_file, key, "output", num_output);
+
+    data = g_key_file_to_data (key_file, &length, NULL);
+
+    dir = g_path_get_dirname (buffer_cache_path);
+    g_mkdir_with_parents (dir, 0755);
+    g_free (dir);
+
+    if (!g_file_set_contents (buffer_cache_path, data, length, &error))
+    {
+        GST_WARNING ("could not write %s: %s", buffer_cache_path, error->message);
+        g_error_free (error);
+    }
+
+    g_free (data);
+    g_key_file_free (key_file);
+
+    g_mutex_unlock (buffer_cache_mutex);
+
+    GST_DEBUG ("%s: %u input, %u output buffers", key, num_input, num_output);
+}
+
 /*
  * Helpers used by plugin:
  */
 
+static gpointer
+preload_thread (gpointer data)
+{
+    GList *names = data;
+    GList *l;
+
+    for (l = names; l; l = l->next)
+    {
+        GTimeVal start, end;
+        GOmxImp *imp;
+
+        g_get_current_time (&start);
+
+        /* the reference is never released, so the library stays loaded
+         * and initialized for the life of the process:
+         */
+        imp = request_imp (l->data, TRUE);
+
+        g_get_current_time (&end);
+
+        GST_DEBUG ("preloading %s %s in %ld us", (gchar *) l->data,
+                   imp ? "done" : "failed",
+                   (end.tv_sec - start.tv_sec) * G_USEC_PER_SEC + (end.tv_usec - start.tv_usec));
+    }
+
+    g_list_free (names);
+
+    return NULL;
+}
+
+/**
+ * Load and OMX_Init() the given libraries in the background, so the first
+ * element using them does not have to.  Libraries which fail to load are
+ * silently skipped, the element using them will complain later.  Takes
+ * ownership of the list, but not of the names (which are expected to be
+ * static).
+ */
+void
+g_omx_preload (GList *library_names)
+{
+    GThread *thread;
+
+    thread = g_thread_create (preload_thread, library_names, FALSE, NULL);
+
+    if (!thread)
+    {
+        GST_WARNING ("could not create preload thread");
+        g_list_free (library_names);
+    }
+}
+
 void
 g_omx_init (void)
 {
@@ -146,6 +595,37 @@ g_omx_init (void)
                                                  g_str_equal,
                                                  g_free,
                                                  (GDestroyNotify) imp_free);
+
+        {
+            const gchar *env;
+
+            handle_pool_mutex = g_mutex_new ();
+            handle_pool_cond = g_cond_new ();
+            handle_pool = g_queue_new ();
+            handle_pool_quit = FALSE;
+
+            env = g_getenv ("OMX_HANDLE_POOL_SIZE");
+            handle_pool_size = env ? atoi (env) : 0;
+
+            env = g_getenv ("OMX_HANDLE_POOL_TIMEOUT");
+            handle_pool_timeout = env ? atoi (env) : HANDLE_POOL_DEFAULT_TIMEOUT;
+        }
+
+        resource_init ();
+
+        {
+            const gchar *env;
+
+            buffer_cache_mutex = g_mutex_new ();
+
+            env = g_getenv ("OMX_BUFFER_CACHE");
+            if (env)
+                buffer_cache_path = g_strdup (env);
+            else
+                buffer_cache_path = g_build_filename (g_get_user_cache_dir (),
+                                                      "gst-openmax", "buffers", NULL);
+        }
+
         initialized = TRUE;
     }
 }
@@ -155,6 +635,32 @@ g_omx_deinit (void)
 {
     if (initialized)
     {
+        GOmxHandle *handle;
+
+        if (handle_pool_reaper)
+        {
+            g_mutex_lock (handle_pool_mutex);
+            handle_pool_quit = TRUE;
+            g_cond_signal (handle_pool_cond);
+            g_mutex_unlock (handle_pool_mutex);
+
+            g_thread_join (handle_pool_reaper);
+            handle_pool_reaper = NULL;
+        }
+
+        /* the handles need their implementation, so free them first: */
+        while ((handle = g_queue_pop_head (handle_pool)))
+            handle_destroy (handle);
+
+        g_queue_free (handle_pool);
+        g_cond_free (handle_pool_cond);
+        g_mutex_free (handle_pool_mutex);
+
+        resource_manager_free (resource_manager);
+
+        g_free (buffer_cache_path);
+        g_mutex_free (buffer_cache_mutex);
+
         g_hash_table_destroy (implementations);
         g_mutex_free (imp_mutex);
         initialized = FALSE;
@@ -30,6 +30,8 @@
 #include <OMX_TI_Video.h> /* for OMX_TI_VIDEO_CODINGTYPE enumeration including VP6 and VP7 formats*/
 
 #include <async_queue.h>
+#include <ring_queue.h>
+#include <resource_manager.h>
 #include <sem.h>
 
 G_BEGIN_DECLS
@@ -41,11 +43,16 @@ G_BEGIN_DECLS
 typedef struct GOmxCore GOmxCore;
 typedef struct GOmxPort GOmxPort;
 typedef struct GOmxImp GOmxImp;
+typedef struct GOmxHandle GOmxHandle;
 typedef struct GOmxSymbolTable GOmxSymbolTable;
+typedef struct GOmxBufferPool GOmxBufferPool;
+typedef struct GOmxConvert GOmxConvert;
 
 
 #include "gstomx_core.h"
 #include "gstomx_port.h"
+#include "gstomx_buffer_pool.h"
+#include "gstomx_convert.h"
 
 
 /* Structures. */
@@ -59,6 +66,10 @@ struct GOmxSymbolTable
                                  OMX_PTR data,
                                  OMX_CALLBACKTYPE *callbacks);
     OMX_ERRORTYPE (*free_handle) (OMX_HANDLETYPE handle);
+    OMX_ERRORTYPE (*setup_tunnel) (OMX_HANDLETYPE output,
+                                   OMX_U32 output_port,
+                                   OMX_HANDLETYPE input,
+                                   OMX_U32 input_port); /**< optional, might be NULL */
 };
 
 struct GOmxImp
@@ -69,14 +80,41 @@ struct GOmxImp
     GMutex *mutex;
 };
 
+/**
+ * A component handle, and the app_data given to OMX_GetHandle() for it.
+ * Idle handles can be kept in the handle pool and later reused by another
+ * GOmxCore, so the callbacks find the core through this rather than having
+ * it as app_data.
+ */
+struct GOmxHandle
+{
+    OMX_HANDLETYPE omx_handle;
+    GOmxCore *core;         /**< current user, NULL while in the pool */
+    GOmxImp *imp;           /**< the pool holds a client_count on it */
+    gchar *key;             /**< library/component/role */
+    GTimeVal idle_since;
+};
+
 /* Functions. */
 
 void g_omx_init (void);
 void g_omx_deinit (void);
+void g_omx_preload (GList *library_names);
+
+ResourceSession * g_omx_request_resource (const gchar *name, guint64 cost, gint priority);
+void g_omx_release_resource (ResourceSession *session);
+
+gboolean g_omx_buffer_cache_lookup (const gchar *key, guint *num_input, guint *num_output);
+void g_omx_buffer_cache_store (const gchar *key, guint num_input, guint num_output);
 
 GOmxImp * g_omx_request_imp (const gchar *name);
 void g_omx_release_imp (GOmxImp *imp);
 
+GOmxHandle * g_omx_handle_new (GOmxImp *imp, const gchar *key);
+void g_omx_handle_free (GOmxHandle *handle);
+GOmxHandle * g_omx_handle_pool_take (const gchar *key);
+gboolean g_omx_handle_pool_put (GOmxHandle *handle);
+
 const char * g_omx_error_to_str (OMX_ERRORTYPE omx_error);
 OMX_COLOR_FORMATTYPE g_omx_fourcc_to_colorformat (guint32 fourcc);
 guint32 g_omx_colorformat_to_fourcc (OMX_COLOR_FORMATTYPE eColorFormat);
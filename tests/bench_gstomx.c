@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Throughput and latency of omx_dummy on top of libomxil-mock.so, for a
+ * matrix of buffer sizes, OMX buffer counts and buffer modes.  A summary
+ * goes to stderr, and the results as JSON to the file given as argument
+ * (or stdout), to keep track of regressions across releases.
+ *
+ * The mock doesn't do any processing by default, so what's measured is the
+ * overhead of the plugin; see tests/mock/mock.c to add a processing cost.
+ */
+
+#include <gst/check/gstcheck.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#define BUFFER_COUNT 0x400
+#define FRAME_DURATION GST_MSECOND
+
+static const guint buffer_sizes[] = { 0x400, 0x1000, 0x10000 };
+static const guint buffer_counts[] = { 2, 4, 8 };
+
+/* the modes of setup_ports() in gstomx_base_filter.c */
+static const gchar *modes[][2] = {
+    { "copy", "OMX_SHARE_HACK_OFF" },
+    { "share", "OMX_SHARE_HACK_ON" },
+    { "allocate", "OMX_ALLOCATE_ON" },
+};
+
+typedef struct BenchResult BenchResult;
+
+struct BenchResult
+{
+    guint buffer_size;
+    guint buffer_count;
+    const gchar *mode;
+    gdouble fps;
+    gdouble overhead;       /**< wall time per buffer, in us */
+    gdouble cpu;            /**< CPU time per buffer, in us */
+    gdouble p50;
+    gdouble p99;
+};
+
+static GstStaticPadTemplate sinktemplate =
+GST_STATIC_PAD_TEMPLATE ("sink",
+                         GST_PAD_SINK,
+                         GST_PAD_ALWAYS,
+                         GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate srctemplate =
+GST_STATIC_PAD_TEMPLATE ("src",
+                         GST_PAD_SRC,
+                         GST_PAD_ALWAYS,
+                         GST_STATIC_CAPS_ANY);
+
+static GMutex *eos_mutex;
+static GCond *eos_cond;
+static gboolean eos_arrived;
+
+static gint64 push_time[BUFFER_COUNT];
+static gint64 latency[BUFFER_COUNT];
+static guint latency_count;
+
+static inline gint64
+now (void)
+{
+    GTimeVal tv;
+
+    g_get_current_time (&tv);
+
+    return (gint64) tv.tv_sec * G_USEC_PER_SEC + tv.tv_usec;
+}
+
+static inline gint64
+cpu_time (void)
+{
+    struct rusage usage;
+
+    getrusage (RUSAGE_SELF, &usage);
+
+    return (gint64) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * G_USEC_PER_SEC +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static GstFlowReturn
+bench_sink_chain (GstPad *pad,
+                  GstBuffer *buf)
+{
+    GstClockTime ts = GST_BUFFER_TIMESTAMP (buf);
+
+    /* a big input buffer comes out in several pieces, with the same
+     * timestamp; the latency is up to the first one */
+    if (GST_CLOCK_TIME_IS_VALID (ts))
+    {
+        guint i = ts / FRAME_DURATION;
+
+        if (i < BUFFER_COUNT && !latency[i])
+        {
+            latency[i] = MAX (now () - push_time[i], 1);
+            latency_count++;
+        }
+    }
+
+    gst_buffer_unref (buf);
+
+    return GST_FLOW_OK;
+}
+
+static gboolean
+bench_sink_event (GstPad *pad,
+                  GstEvent *event)
+{
+    if (GST_EVENT_TYPE (event) == GST_EVENT_EOS)
+    {
+        g_mutex_lock (eos_mutex);
+        eos_arrived = TRUE;
+        g_cond_signal (eos_cond);
+        g_mutex_unlock (eos_mutex);
+    }
+
+    return gst_pad_event_default (pad, event);
+}
+
+static gint
+compare_latency (gconstpointer a,
+                 gconstpointer b)
+{
+    gint64 x = *(const gint64 *) a, y = *(const gint64 *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static gdouble
+percentile (guint p)
+{
+    guint i;
+
+    if (!latency_count)
+        return 0;
+
+    i = MIN ((latency_count * p + 99) / 100, latency_count) - 1;
+
+    return latency[i];
+}
+
+static void
+run (BenchResult *result)
+{
+    GstElement *filter;
+    GstPad *mysrcpad, *mysinkpad;
+    gint64 start, cpu_start, wall;
+    guint i, j;
+
+    for (i = 0; i < G_N_ELEMENTS (modes); i++)
+        g_unsetenv (modes[i][1]);
+
+    for (i = 0; i < G_N_ELEMENTS (modes); i++)
+    {
+        if (!strcmp (modes[i][0], result->mode))
+            g_setenv (modes[i][1], "1", TRUE);
+    }
+
+    memset (push_time, 0, sizeof (push_time));
+    memset (latency, 0, sizeof (latency));
+    latency_count = 0;
+    eos_arrived = FALSE;
+
+    filter = gst_check_setup_element ("omx_dummy");
+    mysrcpad = gst_check_setup_src_pad (filter, &srctemplate, NULL);
+    mysinkpad = gst_check_setup_sink_pad (filter, &sinktemplate, NULL);
+
+    gst_pad_set_chain_function (mysinkpad, bench_sink_chain);
+    gst_pad_set_event_function (mysinkpad, bench_sink_event);
+
+    gst_pad_set_active (mysrcpad, TRUE);
+    gst_pad_set_active (mysinkpad, TRUE);
+
+    g_object_set (G_OBJECT (filter),
+                  "library-name", "libomxil-mock.so",
+                  "input-buffers", result->buffer_count,
+                  "output-buffers", result->buffer_count,
+                  NULL);
+
+    if (gst_element_set_state (filter, GST_STATE_PLAYING) != GST_STATE_CHANGE_SUCCESS)
+        g_error ("can't start omx_dummy");
+
+    start = now ();
+    cpu_start = cpu_time ();
+
+    for (i = 0; i < BUFFER_COUNT; i++)
+    {
+        GstBuffer *inbuffer;
+
+        inbuffer = gst_buffer_new_and_alloc (result->buffer_size);
+        GST_BUFFER_TIMESTAMP (inbuffer) = i * FRAME_DURATION;
+        GST_BUFFER_DURATION (inbuffer) = FRAME_DURATION;
+
+        push_time[i] = now ();
+        if (gst_pad_push (mysrcpad, inbuffer) != GST_FLOW_OK)
+            g_error ("flow error at buffer %u", i);
+    }
+
+    gst_pad_push_event (mysrcpad, gst_event_new_eos ());
+
+    g_mutex_lock (eos_mutex);
+    while (!eos_arrived)
+        g_cond_wait (eos_cond, eos_mutex);
+    g_mutex_unlock (eos_mutex);
+
+    wall = MAX (now () - start, 1);
+
+    result->fps = (gdouble) BUFFER_COUNT * G_USEC_PER_SEC / wall;
+    result->overhead = (gdouble) wall / BUFFER_COUNT;
+    result->cpu = (gdouble) (cpu_time () - cpu_start) / BUFFER_COUNT;
+
+    /* the ones that never came out (if any) are at the end: */
+    for (i = 0, j = 0; i < BUFFER_COUNT; i++)
+    {
+        if (latency[i])
+            latency[j++] = latency[i];
+    }
+    qsort (latency, latency_count, sizeof (latency[0]), compare_latency);
+
+    result->p50 = percentile (50);
+    result->p99 = percentile (99);
+
+    gst_element_set_state (filter, GST_STATE_NULL);
+
+    gst_pad_set_active (mysrcpad, FALSE);
+    gst_pad_set_active (mysinkpad, FALSE);
+    gst_check_teardown_src_pad (filter);
+    gst_check_teardown_sink_pad (filter);
+    gst_check_teardown_element (filter);
+}
+
+static void
+print_json (FILE *file,
+            BenchResult *results,
+            guint n)
+{
+    guint i;
+
+    fprintf (file, "{\n  \"buffers\": %d,\n  \"results\": [\n", BUFFER_COUNT);
+
+    for (i = 0; i < n; i++)
+    {
+        BenchResult *r = &results[i];
+
+        fprintf (file, "    { \"buffer_size\": %u, \"buffer_count\": %u, \"mode\": \"%s\", "
+                 "\"fps\": %.1f, \"overhead_us\": %.2f, \"cpu_us\": %.2f, "
+                 "\"latency_p50_us\": %.0f, \"latency_p99_us\": %.0f }%s\n",
+                 r->buffer_size, r->buffer_count, r->mode,
+                 r->fps, r->overhead, r->cpu, r->p50, r->p99,
+                 i + 1 < n ? "," : "");
+    }
+
+    fprintf (file, "  ]\n}\n");
+}
+
+int
+main (int argc,
+      char **argv)
+{
+    BenchResult *results;
+    FILE *file = stdout;
+    guint n = 0, i, j, k;
+
+    gst_check_init (&argc, &argv);
+
+    eos_mutex = g_mutex_new ();
+    eos_cond = g_cond_new ();
+
+    results = g_new0 (BenchResult, G_N_ELEMENTS (buffer_sizes) *
+                      G_N_ELEMENTS (buffer_counts) * G_N_ELEMENTS (modes));
+
+    fprintf (stderr, "%8s %6s %-8s %10s %10s %10s %8s %8s\n",
+             "size", "count", "mode", "fps", "wall/buf", "cpu/buf", "p50", "p99");
+
+    for (i = 0; i < G_N_ELEMENTS (buffer_sizes); i++)
+    {
+        for (j = 0; j < G_N_ELEMENTS (buffer_counts); j++)
+        {
+            for (k = 0; k < G_N_ELEMENTS (modes); k++)
+            {
+                BenchResult *r = &results[n++];
+
+                r->buffer_size = buffer_sizes[i];
+                r->buffer_count = buffer_counts[j];
+                r->mode = modes[k][0];
+
+                run (r);
+
+                fprintf (stderr, "%8u %6u %-8s %10.1f %8.2fus %8.2fus %6.0fus %6.0fus\n",
+                         r->buffer_size, r->buffer_count, r->mode,
+                         r->fps, r->overhead, r->cpu, r->p50, r->p99);
+            }
+        }
+    }
+
+    if (argc > 1)
+    {
+        file = fopen (argv[1], "w");
+        if (!file)
+        {
+            g_warning ("can't open %s", argv[1]);
+            return 1;
+        }
+    }
+
+    print_json (file, results, n);
+
+    if (file != stdout)
+        fclose (file);
+
+    g_free (results);
+    g_cond_free (eos_cond);
+    g_mutex_free (eos_mutex);
+
+    return 0;
+}
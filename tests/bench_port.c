@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * The fixed cost the port layer adds to every buffer: g_omx_port_send()
+ * and g_omx_port_recv() driven directly, on top of libomxil-mock.so with
+ * no processing cost, for each way of setting up the buffers.  The time
+ * spent waiting for a buffer (GOmxPortStats::blocked) is left out, so
+ * what remains is our own overhead.  A summary goes to stderr, and the
+ * results as JSON to the file given as argument (or stdout).
+ */
+
+#include "gstomx.h"
+#include "gstomx_core.h"
+#include "gstomx_port.h"
+#include "test_object.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define BUFFER_COUNT 0x10000
+#define BUFFER_SIZE 0x100
+#define NUM_BUFFERS 4
+
+GST_DEBUG_CATEGORY (gstomx_debug);
+GST_DEBUG_CATEGORY (gstomx_ppm);
+
+typedef struct BenchMode BenchMode;
+typedef struct BenchResult BenchResult;
+
+struct BenchMode
+{
+    const gchar *name;
+    gboolean omx_allocate;
+    gboolean share_buffer;
+};
+
+struct BenchResult
+{
+    const BenchMode *mode;
+    gdouble send;           /**< ns per g_omx_port_send() */
+    gdouble recv;           /**< ns per g_omx_port_recv() */
+    gdouble total;          /**< ns per buffer, waits included */
+};
+
+static const BenchMode modes[] = {
+    { "omx_allocate", TRUE, FALSE },
+    { "use_buffer", FALSE, FALSE },
+    { "share_buffer", FALSE, TRUE },
+};
+
+static inline gint64
+now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return (gint64) ts.tv_sec * GST_SECOND + ts.tv_nsec;
+}
+
+/*
+ * The benchmark.
+ */
+
+typedef struct BenchData BenchData;
+
+struct BenchData
+{
+    GOmxPort *out_port;
+    gint64 time;
+    guint count;
+};
+
+static gpointer
+recv_thread (gpointer data)
+{
+    BenchData *bench = data;
+
+    while (TRUE)
+    {
+        gpointer obj;
+        gint64 start;
+
+        start = now ();
+        obj = g_omx_port_recv (bench->out_port);
+        bench->time += now () - start;
+
+        if (!obj)
+            break;
+
+        if (GST_IS_EVENT (obj))
+        {
+            gst_event_unref (obj);
+            break;
+        }
+
+        gst_buffer_unref (obj);
+        bench->count++;
+    }
+
+    return NULL;
+}
+
+static void
+setup_port (GOmxPort *port,
+            const BenchMode *mode)
+{
+    OMX_PARAM_PORTDEFINITIONTYPE param;
+
+    G_OMX_PORT_GET_DEFINITION (port, &param);
+    g_omx_port_setup (port, &param);
+    g_omx_port_set_num_buffers (port, NUM_BUFFERS);
+
+    port->omx_allocate = mode->omx_allocate;
+    port->share_buffer = mode->share_buffer;
+}
+
+static void
+run (BenchResult *result)
+{
+    GstObject *object;
+    GOmxCore *core;
+    GOmxPort *in_port, *out_port;
+    GstBuffer *buf;
+    GstEvent *eos;
+    GThread *thread;
+    BenchData bench = { NULL, 0, 0 };
+    gint64 start, send_time = 0;
+    guint i;
+
+    object = test_object_new (result->mode->name);
+
+    core = g_omx_core_new (object, G_OBJECT_GET_CLASS (object));
+    g_object_set (object,
+                  "library-name", "libomxil-mock.so",
+                  "component-name", "OMX.mock.bench",
+                  NULL);
+
+    g_omx_core_init (core);
+    if (!core->omx_handle)
+        g_error ("can't load libomxil-mock.so");
+
+    in_port = g_omx_core_get_port (core, "in", 0);
+    out_port = g_omx_core_get_port (core, "out", 1);
+
+    setup_port (in_port, result->mode);
+    setup_port (out_port, result->mode);
+
+    g_omx_core_prepare (core);
+    g_omx_core_start (core);
+
+    bench.out_port = out_port;
+    thread = g_thread_create (recv_thread, &bench, TRUE, NULL);
+
+    buf = gst_buffer_new_and_alloc (BUFFER_SIZE);
+    memset (GST_BUFFER_DATA (buf), 0, BUFFER_SIZE);
+
+    start = now ();
+
+    for (i = 0; i < BUFFER_COUNT; i++)
+    {
+        gint64 t = now ();
+
+        GST_BUFFER_TIMESTAMP (buf) = i * GST_MSECOND;
+        if (g_omx_port_send (in_port, buf) < 0)
+            g_error ("can't send buffer %u", i);
+
+        send_time += now () - t;
+    }
+
+    eos = gst_event_new_eos ();
+    g_omx_port_send (in_port, eos);
+    gst_event_unref (eos);
+
+    g_thread_join (thread);
+
+    result->total = (gdouble) (now () - start) / BUFFER_COUNT;
+    result->send = (gdouble) (send_time - (gint64) g_omx_port_get_blocked (in_port) * GST_USECOND) / BUFFER_COUNT;
+    result->recv = (gdouble) (bench.time - (gint64) g_omx_port_get_blocked (out_port) * GST_USECOND) /
+                   MAX (bench.count, 1);
+
+    gst_buffer_unref (buf);
+
+    g_omx_port_finish (in_port);
+    g_omx_port_finish (out_port);
+
+    g_omx_core_stop (core);
+    g_omx_core_unload (core);
+    g_omx_core_deinit (core);
+    g_omx_core_free (core);
+
+    gst_object_unref (object);
+}
+
+int
+main (int argc,
+      char **argv)
+{
+    BenchResult results[G_N_ELEMENTS (modes)];
+    FILE *file = stdout;
+    guint i;
+
+    gst_init (&argc, &argv);
+
+    GST_DEBUG_CATEGORY_INIT (gstomx_debug, "omx", 0, "gst-openmax");
+    GST_DEBUG_CATEGORY_INIT (gstomx_util_debug, "omx_util", 0, "gst-openmax utility");
+    GST_DEBUG_CATEGORY_INIT (gstomx_ppm, "omx_ppm", 0, "gst-openmax performance");
+
+    fprintf (stderr, "%-14s %10s %10s %10s\n", "mode", "send", "recv", "total");
+
+    for (i = 0; i < G_N_ELEMENTS (modes); i++)
+    {
+        BenchResult *r = &results[i];
+
+        r->mode = &modes[i];
+        run (r);
+
+        fprintf (stderr, "%-14s %8.0fns %8.0fns %8.0fns\n",
+                 r->mode->name, r->send, r->recv, r->total);
+    }
+
+    if (argc > 1)
+    {
+        file = fopen (argv[1], "w");
+        if (!file)
+        {
+            g_warning ("can't open %s", argv[1]);
+            return 1;
+        }
+    }
+
+    fprintf (file, "{\n  \"buffers\": %d,\n  \"buffer_size\": %d,\n  \"results\": [\n",
+             BUFFER_COUNT, BUFFER_SIZE);
+
+    for (i = 0; i < G_N_ELEMENTS (modes); i++)
+    {
+        BenchResult *r = &results[i];
+
+        fprintf (file, "    { \"mode\": \"%s\", \"send_ns\": %.0f, \"recv_ns\": %.0f, "
+                 "\"total_ns\": %.0f }%s\n",
+                 r->mode->name, r->send, r->recv, r->total,
+                 i + 1 < G_N_ELEMENTS (modes) ? "," : "");
+    }
+
+    fprintf (file, "  ]\n}\n");
+
+    if (file != stdout)
+        fclose (file);
+
+    return 0;
+}
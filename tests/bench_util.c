@@ -0,0 +1,389 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Timings of the primitives under every buffer exchange: AsyncQueue, its
+ * lock-free replacement RingQueue, and GSem.  For each queue, ops/sec for
+ * 1:1, N:1 and 1:N producer/consumer patterns, and for each primitive the
+ * wakeup latency, measured as half of a ping-pong round trip between two
+ * threads.  A summary goes to stderr, and the results as JSON to the file
+ * given as argument (or stdout).
+ */
+
+#include "async_queue.h"
+#include "ring_queue.h"
+#include "sem.h"
+
+#include <stdio.h>
+#include <string.h> /* For memset */
+#include <unistd.h> /* For sysconf */
+
+#define ITEM_COUNT 0x40000
+#define PINGPONG_COUNT 0x4000
+#define RING_CAPACITY 64
+#define MAX_THREADS 4
+
+typedef struct QueueOps QueueOps;
+typedef struct BenchData BenchData;
+typedef struct BenchResult BenchResult;
+
+struct QueueOps
+{
+    const gchar *name;
+    gpointer (*new) (void);
+    void (*free) (gpointer queue);
+    void (*push) (gpointer queue, gpointer data);
+    gpointer (*pop) (gpointer queue);
+};
+
+struct BenchData
+{
+    const QueueOps *ops;
+    gpointer queue;
+    gpointer reply;
+    guint count;
+};
+
+struct BenchResult
+{
+    const gchar *primitive;
+    const gchar *pattern;
+    guint producers;
+    guint consumers;
+    gdouble ops;            /**< per second */
+    gdouble latency;        /**< in us */
+};
+
+static gint end_marker;
+
+static inline gint64
+now (void)
+{
+    GTimeVal tv;
+
+    g_get_current_time (&tv);
+
+    return (gint64) tv.tv_sec * G_USEC_PER_SEC + tv.tv_usec;
+}
+
+static gpointer
+async_new (void)
+{
+    return async_queue_new ();
+}
+
+static gpointer
+async_pop (gpointer queue)
+{
+    return async_queue_pop_full (queue, TRUE, FALSE);
+}
+
+static gpointer
+ring_new (void)
+{
+    return ring_queue_new (RING_CAPACITY);
+}
+
+/* the ports never fill their queue, but the producers here easily outrun
+ * the consumers, which run in other threads, so wait for room:
+ */
+static void
+ring_push (gpointer queue,
+           gpointer data)
+{
+    while (!ring_queue_push (queue, data))
+        g_thread_yield ();
+}
+
+static gpointer
+ring_pop (gpointer queue)
+{
+    return ring_queue_pop_full (queue, TRUE, FALSE);
+}
+
+static const QueueOps queues[] = {
+    { "async_queue", async_new, (void (*) (gpointer)) async_queue_free,
+      (void (*) (gpointer, gpointer)) async_queue_push, async_pop },
+    { "ring_queue", ring_new, (void (*) (gpointer)) ring_queue_free,
+      ring_push, ring_pop },
+};
+
+/*
+ * Throughput.
+ */
+
+static gpointer
+producer (gpointer data)
+{
+    BenchData *bench = data;
+    guint i;
+
+    for (i = 0; i < bench->count; i++)
+        bench->ops->push (bench->queue, GUINT_TO_POINTER (i + 1));
+
+    return NULL;
+}
+
+static gpointer
+consumer (gpointer data)
+{
+    BenchData *bench = data;
+
+    while (bench->ops->pop (bench->queue) != &end_marker)
+        ;
+
+    return NULL;
+}
+
+static void
+run_throughput (const QueueOps *ops,
+                BenchResult *result)
+{
+    GThread *producers[MAX_THREADS], *consumers[MAX_THREADS];
+    BenchData bench;
+    gint64 start;
+    guint i;
+
+    bench.ops = ops;
+    bench.queue = ops->new ();
+    bench.count = ITEM_COUNT / result->producers;
+
+    start = now ();
+
+    for (i = 0; i < result->consumers; i++)
+        consumers[i] = g_thread_create (consumer, &bench, TRUE, NULL);
+    for (i = 0; i < result->producers; i++)
+        producers[i] = g_thread_create (producer, &bench, TRUE, NULL);
+
+    for (i = 0; i < result->producers; i++)
+        g_thread_join (producers[i]);
+
+    /* one for each consumer, after all the items: */
+    for (i = 0; i < result->consumers; i++)
+        ops->push (bench.queue, &end_marker);
+
+    for (i = 0; i < result->consumers; i++)
+        g_thread_join (consumers[i]);
+
+    result->ops = (gdouble) bench.count * result->producers * G_USEC_PER_SEC /
+                  MAX (now () - start, 1);
+
+    ops->free (bench.queue);
+}
+
+/*
+ * Wakeup latency.
+ */
+
+static gpointer
+queue_echo (gpointer data)
+{
+    BenchData *bench = data;
+    guint i;
+
+    for (i = 0; i < bench->count; i++)
+        bench->ops->push (bench->reply, bench->ops->pop (bench->queue));
+
+    return NULL;
+}
+
+static void
+run_queue_latency (const QueueOps *ops,
+                   BenchResult *result)
+{
+    GThread *thread;
+    BenchData bench;
+    gint64 start;
+    guint i;
+
+    bench.ops = ops;
+    bench.queue = ops->new ();
+    bench.reply = ops->new ();
+    bench.count = PINGPONG_COUNT;
+
+    thread = g_thread_create (queue_echo, &bench, TRUE, NULL);
+
+    start = now ();
+
+    for (i = 0; i < bench.count; i++)
+    {
+        ops->push (bench.queue, GUINT_TO_POINTER (i + 1));
+        ops->pop (bench.reply);
+    }
+
+    result->latency = (gdouble) (now () - start) / bench.count / 2;
+    result->ops = G_USEC_PER_SEC / MAX (result->latency, 0.001);
+
+    g_thread_join (thread);
+
+    ops->free (bench.reply);
+    ops->free (bench.queue);
+}
+
+static gpointer
+sem_echo (gpointer data)
+{
+    BenchData *bench = data;
+    guint i;
+
+    for (i = 0; i < bench->count; i++)
+    {
+        g_sem_down (bench->queue);
+        g_sem_up (bench->reply);
+    }
+
+    return NULL;
+}
+
+static void
+run_sem_latency (BenchResult *result)
+{
+    GThread *thread;
+    BenchData bench;
+    gint64 start;
+    guint i;
+
+    bench.queue = g_sem_new ();
+    bench.reply = g_sem_new ();
+    bench.count = PINGPONG_COUNT;
+
+    thread = g_thread_create (sem_echo, &bench, TRUE, NULL);
+
+    start = now ();
+
+    for (i = 0; i < bench.count; i++)
+    {
+        g_sem_up (bench.queue);
+        g_sem_down (bench.reply);
+    }
+
+    result->latency = (gdouble) (now () - start) / bench.count / 2;
+    result->ops = G_USEC_PER_SEC / MAX (result->latency, 0.001);
+
+    g_thread_join (thread);
+
+    g_sem_free (bench.reply);
+    g_sem_free (bench.queue);
+}
+
+static void
+print_result (FILE *file,
+              BenchResult *r,
+              gboolean last)
+{
+    fprintf (file, "    { \"primitive\": \"%s\", \"pattern\": \"%s\", "
+             "\"producers\": %u, \"consumers\": %u, \"ops_per_sec\": %.0f",
+             r->primitive, r->pattern, r->producers, r->consumers, r->ops);
+
+    if (r->latency)
+        fprintf (file, ", \"latency_us\": %.2f", r->latency);
+
+    fprintf (file, " }%s\n", last ? "" : ",");
+}
+
+int
+main (int argc,
+      char **argv)
+{
+    BenchResult results[G_N_ELEMENTS (queues) * 4 + 1];
+    FILE *file = stdout;
+    glong cpus;
+    guint threads, n = 0, i;
+
+    if (!g_thread_supported ())
+        g_thread_init (NULL);
+
+    cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    threads = CLAMP (cpus, 2, MAX_THREADS);
+
+    memset (results, 0, sizeof (results));
+
+    fprintf (stderr, "%-12s %-8s %12s %10s\n", "primitive", "pattern", "ops/sec", "latency");
+
+    for (i = 0; i < G_N_ELEMENTS (queues); i++)
+    {
+        const QueueOps *ops = &queues[i];
+        BenchResult *r;
+
+        r = &results[n++];
+        r->primitive = ops->name;
+        r->pattern = "1:1";
+        r->producers = r->consumers = 1;
+        run_throughput (ops, r);
+
+        r = &results[n++];
+        r->primitive = ops->name;
+        r->pattern = "N:1";
+        r->producers = threads;
+        r->consumers = 1;
+        run_throughput (ops, r);
+
+        r = &results[n++];
+        r->primitive = ops->name;
+        r->pattern = "1:N";
+        r->producers = 1;
+        r->consumers = threads;
+        run_throughput (ops, r);
+
+        r = &results[n++];
+        r->primitive = ops->name;
+        r->pattern = "pingpong";
+        r->producers = r->consumers = 1;
+        run_queue_latency (ops, r);
+    }
+
+    {
+        BenchResult *r = &results[n++];
+
+        r->primitive = "sem";
+        r->pattern = "pingpong";
+        r->producers = r->consumers = 1;
+        run_sem_latency (r);
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        BenchResult *r = &results[i];
+
+        fprintf (stderr, "%-12s %-8s %12.0f", r->primitive, r->pattern, r->ops);
+        if (r->latency)
+            fprintf (stderr, " %8.2fus", r->latency);
+        fprintf (stderr, "\n");
+    }
+
+    if (argc > 1)
+    {
+        file = fopen (argv[1], "w");
+        if (!file)
+        {
+            g_warning ("can't open %s", argv[1]);
+            return 1;
+        }
+    }
+
+    fprintf (file, "{\n  \"cpus\": %ld,\n  \"items\": %d,\n  \"results\": [\n", cpus, ITEM_COUNT);
+    for (i = 0; i < n; i++)
+        print_result (file, &results[i], i + 1 == n);
+    fprintf (file, "  ]\n}\n");
+
+    if (file != stdout)
+        fclose (file);
+
+    return 0;
+}
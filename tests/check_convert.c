@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <check.h>
+#include <string.h>
+
+#include "gstomx.h"
+#include "gstomx_convert.h"
+
+GST_DEBUG_CATEGORY (gstomx_debug);
+
+/* odd sizes, so the plain C tail of the rows is tested too: */
+#define WIDTH 67
+#define HEIGHT 21
+#define STRIDE 96
+#define SLICE 24
+
+static guint8 *
+new_frame (guint size, guint32 seed)
+{
+    GRand *rand = g_rand_new_with_seed (seed);
+    guint8 *data = g_malloc (size);
+    guint i;
+
+    for (i = 0; i < size; i++)
+        data[i] = g_rand_int_range (rand, 0, 256);
+
+    g_rand_free (rand);
+
+    return data;
+}
+
+static void
+check_planes (const guint8 *a, const guint8 *b,
+              gint stride, gint width, gint height,
+              const gchar *what)
+{
+    gint i;
+
+    for (i = 0; i < height; i++)
+    {
+        fail_if (memcmp (a + i * stride, b + i * stride, width) != 0,
+                 "%s: row %d differs", what, i);
+    }
+}
+
+/* what the kernels must compute, saturation to 16 bits included */
+static guint8
+ref_clamp (gint value)
+{
+    value = CLAMP (value, G_MININT16, G_MAXINT16) >> 6;
+    return CLAMP (value, 0, 255);
+}
+
+START_TEST (test_convert_supported)
+{
+    fail_unless (g_omx_convert_supported (GST_VIDEO_FORMAT_NV12, GST_VIDEO_FORMAT_I420));
+    fail_unless (g_omx_convert_supported (GST_VIDEO_FORMAT_NV12, GST_VIDEO_FORMAT_UYVY));
+    fail_unless (g_omx_convert_supported (GST_VIDEO_FORMAT_NV12, GST_VIDEO_FORMAT_BGRx));
+    fail_unless (g_omx_convert_supported (GST_VIDEO_FORMAT_YUY2, GST_VIDEO_FORMAT_NV12));
+    fail_if (g_omx_convert_supported (GST_VIDEO_FORMAT_BGRx, GST_VIDEO_FORMAT_NV12));
+    fail_if (g_omx_convert_supported (GST_VIDEO_FORMAT_I420, GST_VIDEO_FORMAT_YUY2));
+    fail_unless (g_omx_convert_supported (GST_VIDEO_FORMAT_NV12, GST_VIDEO_FORMAT_NV12));
+    fail_if (g_omx_convert_supported (GST_VIDEO_FORMAT_AYUV, GST_VIDEO_FORMAT_AYUV));
+}
+END_TEST
+
+/* NV12 -> @format -> NV12 must give back the original picture */
+static void
+check_round_trip (GstVideoFormat format)
+{
+    GOmxConvert *to, *from;
+    guint8 *src, *tmp, *dest;
+
+    to = g_omx_convert_new (GST_VIDEO_FORMAT_NV12, STRIDE, SLICE,
+                            format, 0, 0, WIDTH, HEIGHT);
+    from = g_omx_convert_new (format, 0, 0,
+                              GST_VIDEO_FORMAT_NV12, STRIDE, SLICE, WIDTH, HEIGHT);
+    fail_if (!to || !from, "conversion not supported");
+    fail_if (to->in.size != STRIDE * (SLICE + (HEIGHT + 1) / 2));
+    fail_if (to->out.size != from->in.size);
+
+    src = new_frame (to->in.size, format);
+    tmp = g_malloc (to->out.size);
+    dest = g_malloc0 (from->out.size);
+
+    g_omx_convert_run (to, tmp, src, 0);
+    g_omx_convert_run (from, dest, tmp, 0);
+
+    check_planes (src, dest, STRIDE, WIDTH, HEIGHT, "luma");
+    check_planes (src + STRIDE * SLICE, dest + STRIDE * SLICE,
+                  STRIDE, WIDTH + 1, (HEIGHT + 1) / 2, "chroma");
+
+    g_free (src);
+    g_free (tmp);
+    g_free (dest);
+    g_omx_convert_unref (to);
+    g_omx_convert_unref (from);
+}
+
+START_TEST (test_convert_i420)
+{
+    check_round_trip (GST_VIDEO_FORMAT_I420);
+}
+END_TEST
+
+START_TEST (test_convert_packed)
+{
+    check_round_trip (GST_VIDEO_FORMAT_YUY2);
+    check_round_trip (GST_VIDEO_FORMAT_UYVY);
+}
+END_TEST
+
+START_TEST (test_convert_rgb)
+{
+    static const struct
+    {
+        GstVideoFormat format;
+        gint r, g, b, a;
+    } formats[] = {
+        { GST_VIDEO_FORMAT_BGRx, 2, 1, 0, 3 },
+        { GST_VIDEO_FORMAT_RGBA, 0, 1, 2, 3 },
+        { GST_VIDEO_FORMAT_xRGB, 1, 2, 3, 0 },
+        { GST_VIDEO_FORMAT_ABGR, 3, 2, 1, 0 },
+    };
+    guint f;
+
+    for (f = 0; f < G_N_ELEMENTS (formats); f++)
+    {
+        GOmxConvert *convert;
+        guint8 *src, *dest;
+        gint x, y;
+
+        convert = g_omx_convert_new (GST_VIDEO_FORMAT_NV12, STRIDE, SLICE,
+                                     formats[f].format, 0, 0, WIDTH, HEIGHT);
+        fail_if (!convert, "conversion not supported");
+        fail_if (convert->out.stride[0] != WIDTH * 4);
+
+        src = new_frame (convert->in.size, f);
+        dest = g_malloc (convert->out.size);
+
+        g_omx_convert_run (convert, dest, src, 0);
+
+        for (y = 0; y < HEIGHT; y++)
+        {
+            for (x = 0; x < WIDTH; x++)
+            {
+                const guint8 *uv = src + STRIDE * SLICE + (y / 2) * STRIDE + (x & ~1);
+                const guint8 *p = dest + y * convert->out.stride[0] + 4 * x;
+                gint c = 74 * (src[y * STRIDE + x] - 16);
+                gint d = uv[0] - 128;
+                gint e = uv[1] - 128;
+
+                fail_if (p[formats[f].r] != ref_clamp (c + 102 * e) ||
+                         p[formats[f].g] != ref_clamp (c - 25 * d - 52 * e) ||
+                         p[formats[f].b] != ref_clamp (c + 129 * d) ||
+                         p[formats[f].a] != 0xff,
+                         "format %d: wrong pixel at %d,%d", formats[f].format, x, y);
+            }
+        }
+
+        g_free (src);
+        g_free (dest);
+        g_omx_convert_unref (convert);
+    }
+}
+END_TEST
+
+START_TEST (test_convert_crop)
+{
+    GOmxConvert *convert;
+    guint8 *src, *dest;
+    gint top = 3, left = 5;
+    gint x, y;
+
+    convert = g_omx_convert_new (GST_VIDEO_FORMAT_NV12, STRIDE, SLICE,
+                                 GST_VIDEO_FORMAT_I420, 0, 0, WIDTH, HEIGHT - top);
+    fail_if (!convert, "conversion not supported");
+
+    src = new_frame (STRIDE * (SLICE + SLICE / 2), 0);
+    dest = g_malloc (convert->out.size);
+
+    g_omx_convert_run (convert, dest, src, top * STRIDE + left);
+
+    for (y = 0; y < HEIGHT - top; y++)
+    {
+        fail_if (memcmp (dest + y * convert->out.stride[0],
+                         src + (top + y) * STRIDE + left, WIDTH) != 0,
+                 "luma row %d differs", y);
+    }
+
+    for (x = 0; x < (WIDTH + 1) / 2; x++)
+    {
+        const guint8 *uv = src + STRIDE * SLICE + (top / 2) * STRIDE + (left & ~1);
+
+        fail_if (dest[convert->out.offset[1] + x] != uv[2 * x]);
+        fail_if (dest[convert->out.offset[2] + x] != uv[2 * x + 1]);
+    }
+
+    g_free (src);
+    g_free (dest);
+    g_omx_convert_unref (convert);
+}
+END_TEST
+
+/* stride repacking, with the frame split in bands done in parallel */
+START_TEST (test_convert_repack)
+{
+    static const struct
+    {
+        GstVideoFormat format;
+        gint bpp;   /* of the first plane */
+    } formats[] = {
+        { GST_VIDEO_FORMAT_NV12, 1 },
+        { GST_VIDEO_FORMAT_I420, 1 },
+        { GST_VIDEO_FORMAT_UYVY, 2 },
+        { GST_VIDEO_FORMAT_BGRx, 4 },
+    };
+    gint height = 301;
+    guint f;
+
+    g_setenv ("OMX_CONVERT_THREADS", "3", TRUE);
+    g_setenv ("OMX_CONVERT_NT_SIZE", "1", TRUE);
+
+    for (f = 0; f < G_N_ELEMENTS (formats); f++)
+    {
+        GOmxConvert *to, *from;
+        guint8 *src, *tmp, *dest;
+        gint stride = 4 * STRIDE;
+
+        to = g_omx_convert_new (formats[f].format, stride, height + 7,
+                                formats[f].format, 0, 0, WIDTH, height);
+        from = g_omx_convert_new (formats[f].format, 0, 0,
+                                  formats[f].format, stride, height + 7, WIDTH, height);
+        fail_if (!to || !from, "repacking not supported");
+        fail_if (to->n_bands != 3);
+        fail_if (to->out.stride[0] >= stride);
+
+        src = new_frame (to->in.size, f);
+        tmp = g_malloc (to->out.size);
+        dest = g_malloc0 (from->out.size);
+
+        g_omx_convert_run (to, tmp, src, 0);
+        g_omx_convert_run (from, dest, tmp, 0);
+
+        check_planes (src, dest, stride, WIDTH * formats[f].bpp, height, "plane 0");
+        if (formats[f].format == GST_VIDEO_FORMAT_NV12)
+        {
+            check_planes (src + to->in.offset[1], dest + from->out.offset[1],
+                          stride, WIDTH + 1, (height + 1) / 2, "plane 1");
+        }
+        else if (formats[f].format == GST_VIDEO_FORMAT_I420)
+        {
+            check_planes (src + to->in.offset[1], dest + from->out.offset[1],
+                          stride / 2, (WIDTH + 1) / 2, (height + 1) / 2, "plane 1");
+            check_planes (src + to->in.offset[2], dest + from->out.offset[2],
+                          stride / 2, (WIDTH + 1) / 2, (height + 1) / 2, "plane 2");
+        }
+
+        g_free (src);
+        g_free (tmp);
+        g_free (dest);
+        g_omx_convert_unref (to);
+        g_omx_convert_unref (from);
+    }
+
+    g_unsetenv ("OMX_CONVERT_THREADS");
+    g_unsetenv ("OMX_CONVERT_NT_SIZE");
+}
+END_TEST
+
+static Suite *
+util_suite (void)
+{
+    Suite *s = suite_create ("convert");
+    TCase *tc_core = tcase_create ("Core");
+
+    gst_init (NULL, NULL);
+    GST_DEBUG_CATEGORY_INIT (gstomx_debug, "omx", 0, "gst-openmax");
+
+    tcase_add_test (tc_core, test_convert_supported);
+    tcase_add_test (tc_core, test_convert_i420);
+    tcase_add_test (tc_core, test_convert_packed);
+    tcase_add_test (tc_core, test_convert_rgb);
+    tcase_add_test (tc_core, test_convert_crop);
+    tcase_add_test (tc_core, test_convert_repack);
+    suite_add_tcase (s, tc_core);
+
+    return s;
+}
+
+int
+main (void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = util_suite ();
+    sr = srunner_create (s);
+    srunner_run_all (sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+
+    return (number_failed == 0) ? 0 : 1;
+}
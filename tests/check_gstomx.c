@@ -195,6 +195,176 @@ helper (gboolean flush)
     g_cond_free (eos_cond);
 }
 
+static gboolean src_blocked;
+
+static void
+pad_blocked_cb (GstPad *pad,
+                gboolean blocked,
+                gpointer data)
+{
+    g_mutex_lock (eos_mutex);
+    src_blocked = blocked;
+    g_cond_signal (eos_cond);
+    g_mutex_unlock (eos_mutex);
+}
+
+static GstBuffer *
+tunnel_buffer (guint i,
+               GstCaps *caps)
+{
+    GstBuffer *buffer;
+
+    buffer = gst_buffer_new_and_alloc (BUFFER_SIZE);
+    GST_BUFFER_DATA (buffer)[0] = i;
+    gst_buffer_set_caps (buffer, caps);
+
+    return buffer;
+}
+
+static gpointer
+push_thread (gpointer data)
+{
+    GstPad *pad = data;
+
+    return GINT_TO_POINTER (gst_pad_push (pad, tunnel_buffer (0, GST_PAD_CAPS (pad))));
+}
+
+/*
+ * Two omx_dummy on top of libomxil-mock.so, with OMX_TUNNEL_ON: the data
+ * goes from one component to the other through the tunnel, and only the
+ * timing of it between the elements.  With @block, the first push between
+ * them, which lets the downstream one start its way to Idle, stalls like
+ * in a prerolling sink, and the upstream one must still change state
+ * meanwhile.
+ */
+static void
+tunnel_helper (gboolean block)
+{
+    GstElement *upstream, *downstream;
+    GstBus *bus;
+    GstPad *mysrcpad, *mysinkpad, *srcpad;
+    GstCaps *caps;
+    GList *cur;
+    guint i = 0;
+
+    g_setenv ("OMX_TUNNEL_ON", "1", TRUE);
+    upstream = gst_check_setup_element ("omx_dummy");
+    downstream = gst_check_setup_element ("omx_dummy");
+    g_unsetenv ("OMX_TUNNEL_ON");
+
+    g_object_set (G_OBJECT (upstream), "library-name", "libomxil-mock.so", NULL);
+    g_object_set (G_OBJECT (downstream), "library-name", "libomxil-mock.so", NULL);
+
+    fail_unless (gst_element_link (upstream, downstream));
+
+    mysrcpad = gst_check_setup_src_pad (upstream, &srctemplate, NULL);
+    mysinkpad = gst_check_setup_sink_pad (downstream, &sinktemplate, NULL);
+
+    gst_pad_set_active (mysrcpad, TRUE);
+    gst_pad_set_active (mysinkpad, TRUE);
+
+    gst_pad_set_event_function (mysinkpad, test_sink_event);
+
+    eos_mutex = g_mutex_new ();
+    eos_cond = g_cond_new ();
+    eos_arrived = FALSE;
+    src_blocked = FALSE;
+
+    bus = gst_bus_new ();
+    gst_element_set_bus (upstream, bus);
+    gst_element_set_bus (downstream, bus);
+
+    fail_unless_equals_int (gst_element_set_state (downstream, GST_STATE_PLAYING),
+                            GST_STATE_CHANGE_SUCCESS);
+    fail_unless_equals_int (gst_element_set_state (upstream, GST_STATE_PLAYING),
+                            GST_STATE_CHANGE_SUCCESS);
+
+    /* omx_dummy has no caps of its own, and the tunnel is only set up
+     * with some */
+    caps = gst_caps_new_simple ("audio/x-raw-int", NULL);
+    gst_pad_set_caps (mysrcpad, caps);
+    srcpad = gst_element_get_static_pad (upstream, "src");
+    fail_unless (gst_pad_set_caps (srcpad, caps));
+
+    if (block)
+    {
+        GThread *thread;
+
+        gst_pad_set_blocked_async (srcpad, TRUE, pad_blocked_cb, NULL);
+        thread = g_thread_create (push_thread, mysrcpad, TRUE, NULL);
+
+        g_mutex_lock (eos_mutex);
+        while (!src_blocked)
+            g_cond_wait (eos_cond, eos_mutex);
+        g_mutex_unlock (eos_mutex);
+
+        fail_unless_equals_int (gst_element_set_state (upstream, GST_STATE_PAUSED),
+                                GST_STATE_CHANGE_SUCCESS);
+        fail_unless_equals_int (gst_element_set_state (upstream, GST_STATE_PLAYING),
+                                GST_STATE_CHANGE_SUCCESS);
+
+        gst_pad_set_blocked (srcpad, FALSE);
+
+        fail_unless_equals_int (GPOINTER_TO_INT (g_thread_join (thread)), GST_FLOW_OK);
+        i++;
+    }
+
+    for (; i < BUFFER_COUNT; i++)
+        fail_unless (gst_pad_push (mysrcpad, tunnel_buffer (i, caps)) == GST_FLOW_OK);
+
+    gst_pad_push_event (mysrcpad, gst_event_new_eos ());
+
+    g_mutex_lock (eos_mutex);
+    while (!eos_arrived)
+        g_cond_wait (eos_cond, eos_mutex);
+    g_mutex_unlock (eos_mutex);
+
+    /* all of it, in order, out of the downstream component: */
+    for (cur = buffers, i = 0; cur; cur = g_list_next (cur), i++)
+        fail_unless (GST_BUFFER_DATA (cur->data)[0] == i);
+    fail_unless_equals_int (i, BUFFER_COUNT);
+
+    fail_if (gst_bus_poll (bus, GST_MESSAGE_ERROR, 0));
+
+    /* cleanup, downstream first as in a pipeline */
+    gst_caps_unref (caps);
+    gst_object_unref (srcpad);
+    gst_check_drop_buffers ();
+
+    fail_unless_equals_int (gst_element_set_state (downstream, GST_STATE_NULL),
+                            GST_STATE_CHANGE_SUCCESS);
+    fail_unless_equals_int (gst_element_set_state (upstream, GST_STATE_NULL),
+                            GST_STATE_CHANGE_SUCCESS);
+
+    gst_bus_set_flushing (bus, TRUE);
+    gst_element_set_bus (upstream, NULL);
+    gst_element_set_bus (downstream, NULL);
+    gst_object_unref (GST_OBJECT (bus));
+
+    gst_pad_set_active (mysrcpad, FALSE);
+    gst_pad_set_active (mysinkpad, FALSE);
+    gst_check_teardown_src_pad (upstream);
+    gst_check_teardown_sink_pad (downstream);
+    gst_element_unlink (upstream, downstream);
+    gst_check_teardown_element (upstream);
+    gst_check_teardown_element (downstream);
+
+    g_mutex_free (eos_mutex);
+    g_cond_free (eos_cond);
+}
+
+GST_START_TEST (test_tunnel)
+{
+    tunnel_helper (FALSE);
+}
+GST_END_TEST
+
+GST_START_TEST (test_tunnel_blocked)
+{
+    tunnel_helper (TRUE);
+}
+GST_END_TEST
+
 GST_START_TEST (test_flush)
 {
     helper (TRUE);
@@ -216,6 +386,8 @@ gstomx_suite (void)
     tcase_set_timeout (tc_chain, 10);
     tcase_add_test (tc_chain, test_basic);
     tcase_add_test (tc_chain, test_flush);
+    tcase_add_test (tc_chain, test_tunnel);
+    tcase_add_test (tc_chain, test_tunnel_blocked);
     suite_add_tcase (s, tc_chain);
 
     return s;
@@ -0,0 +1,634 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <check.h>
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "gstomx.h"
+#include "gstomx_core.h"
+#include "gstomx_port.h"
+#include "gstomx_convert.h"
+#include "test_object.h"
+
+#include <glib.h>
+#include <dlfcn.h>
+#include <string.h> /* For memset */
+
+#define BUFFERS 4
+
+GST_DEBUG_CATEGORY (gstomx_debug);
+GST_DEBUG_CATEGORY (gstomx_ppm);
+
+static const char *lib_name;
+static void *dl_handle;
+static OMX_ERRORTYPE (*init) (void);
+static OMX_ERRORTYPE (*deinit) (void);
+static OMX_ERRORTYPE (*get_handle) (OMX_HANDLETYPE *handle,
+                                    OMX_STRING name,
+                                    OMX_PTR data,
+                                    OMX_CALLBACKTYPE *callbacks);
+static OMX_ERRORTYPE (*free_handle) (OMX_HANDLETYPE handle);
+
+typedef struct CustomData CustomData;
+
+struct CustomData
+{
+    OMX_HANDLETYPE omx_handle;
+    OMX_STATETYPE omx_state;
+    GCond *condition;
+    GMutex *mutex;
+    OMX_BUFFERHEADERTYPE *buffers[2][BUFFERS];
+    guint empty_done;
+    guint fill_done;
+    guint flushed;
+    guint settings_changed;
+    OMX_ERRORTYPE error;
+};
+
+static CustomData *
+custom_data_new (void)
+{
+    CustomData *custom_data;
+    custom_data = g_new0 (CustomData, 1);
+    custom_data->condition = g_cond_new ();
+    custom_data->mutex = g_mutex_new ();
+    return custom_data;
+}
+
+static void
+custom_data_free (CustomData *custom_data)
+{
+    g_mutex_free (custom_data->mutex);
+    g_cond_free (custom_data->condition);
+    g_free (custom_data);
+}
+
+static OMX_ERRORTYPE
+EventHandler (OMX_HANDLETYPE omx_handle,
+              OMX_PTR app_data,
+              OMX_EVENTTYPE event,
+              OMX_U32 data_1,
+              OMX_U32 data_2,
+              OMX_PTR event_data)
+{
+    CustomData *core = app_data;
+
+    g_mutex_lock (core->mutex);
+
+    switch (event)
+    {
+        case OMX_EventCmdComplete:
+            if (data_1 == OMX_CommandStateSet)
+                core->omx_state = data_2;
+            else if (data_1 == OMX_CommandFlush)
+                core->flushed++;
+            break;
+        case OMX_EventPortSettingsChanged:
+            core->settings_changed++;
+            break;
+        case OMX_EventError:
+            core->error = data_1;
+            break;
+        default:
+            break;
+    }
+
+    g_cond_broadcast (core->condition);
+    g_mutex_unlock (core->mutex);
+
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+EmptyBufferDone (OMX_HANDLETYPE omx_handle,
+                 OMX_PTR app_data,
+                 OMX_BUFFERHEADERTYPE *omx_buffer)
+{
+    CustomData *core = app_data;
+
+    g_mutex_lock (core->mutex);
+    core->empty_done++;
+    g_cond_broadcast (core->condition);
+    g_mutex_unlock (core->mutex);
+
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+FillBufferDone (OMX_HANDLETYPE omx_handle,
+                OMX_PTR app_data,
+                OMX_BUFFERHEADERTYPE *omx_buffer)
+{
+    CustomData *core = app_data;
+
+    g_mutex_lock (core->mutex);
+    if (omx_buffer->nFilledLen)
+        core->fill_done++;
+    g_cond_broadcast (core->condition);
+    g_mutex_unlock (core->mutex);
+
+    return OMX_ErrorNone;
+}
+
+static OMX_CALLBACKTYPE callbacks = { EventHandler, EmptyBufferDone, FillBufferDone };
+
+static inline void
+wait_for (CustomData *core,
+          guint *value,
+          guint count)
+{
+    g_mutex_lock (core->mutex);
+    while (*value < count)
+        g_cond_wait (core->condition, core->mutex);
+    g_mutex_unlock (core->mutex);
+}
+
+static inline void
+change_state (CustomData *core,
+              OMX_STATETYPE state)
+{
+    fail_if (OMX_SendCommand (core->omx_handle, OMX_CommandStateSet, state, NULL) != OMX_ErrorNone);
+
+    g_mutex_lock (core->mutex);
+    while (core->omx_state != state)
+        g_cond_wait (core->condition, core->mutex);
+    g_mutex_unlock (core->mutex);
+}
+
+/* get a component to Executing, with all its buffers allocated */
+static CustomData *
+setup (const gchar *name)
+{
+    CustomData *core;
+    OMX_PARAM_PORTDEFINITIONTYPE param;
+    guint i, j;
+
+    core = custom_data_new ();
+
+    fail_if (init () != OMX_ErrorNone);
+    fail_if (get_handle (&core->omx_handle, (OMX_STRING) name, core, &callbacks) != OMX_ErrorNone);
+
+    for (i = 0; i < 2; i++)
+    {
+        memset (&param, 0, sizeof (param));
+        param.nSize = sizeof (param);
+        param.nVersion.nVersion = 1;
+        param.nPortIndex = i;
+        fail_if (OMX_GetParameter (core->omx_handle, OMX_IndexParamPortDefinition, &param) != OMX_ErrorNone);
+        fail_if (param.nBufferCountActual != BUFFERS);
+
+        for (j = 0; j < BUFFERS; j++)
+        {
+            fail_if (OMX_AllocateBuffer (core->omx_handle, &core->buffers[i][j],
+                                         i, NULL, param.nBufferSize) != OMX_ErrorNone);
+        }
+    }
+
+    change_state (core, OMX_StateIdle);
+    change_state (core, OMX_StateExecuting);
+
+    return core;
+}
+
+static void
+teardown (CustomData *core)
+{
+    guint i, j;
+
+    change_state (core, OMX_StateIdle);
+
+    for (i = 0; i < 2; i++)
+        for (j = 0; j < BUFFERS; j++)
+            fail_if (OMX_FreeBuffer (core->omx_handle, i, core->buffers[i][j]) != OMX_ErrorNone);
+
+    change_state (core, OMX_StateLoaded);
+
+    fail_if (free_handle (core->omx_handle) != OMX_ErrorNone);
+    fail_if (deinit () != OMX_ErrorNone);
+
+    custom_data_free (core);
+}
+
+static inline void
+empty_buffer (CustomData *core,
+              OMX_BUFFERHEADERTYPE *buffer)
+{
+    buffer->nFilledLen = 100;
+    buffer->nOffset = 0;
+    fail_if (OMX_EmptyThisBuffer (core->omx_handle, buffer) != OMX_ErrorNone);
+}
+
+START_TEST (test_decode)
+{
+    CustomData *core;
+    guint i;
+
+    g_setenv ("OMX_MOCK_SETTINGS_CHANGED", "2", TRUE);
+
+    core = setup ("OMX.mock.video.decoder");
+
+    for (i = 0; i < BUFFERS; i++)
+    {
+        fail_if (OMX_FillThisBuffer (core->omx_handle, core->buffers[1][i]) != OMX_ErrorNone);
+        empty_buffer (core, core->buffers[0][i]);
+    }
+
+    wait_for (core, &core->empty_done, BUFFERS);
+    wait_for (core, &core->fill_done, BUFFERS);
+    fail_if (core->settings_changed != 1);
+
+    teardown (core);
+
+    g_unsetenv ("OMX_MOCK_SETTINGS_CHANGED");
+}
+END_TEST
+
+START_TEST (test_flush)
+{
+    CustomData *core;
+    guint i;
+
+    core = setup ("OMX.mock.video.decoder");
+
+    /* no output buffers, so nothing gets processed: */
+    for (i = 0; i < BUFFERS; i++)
+        empty_buffer (core, core->buffers[0][i]);
+
+    fail_if (OMX_SendCommand (core->omx_handle, OMX_CommandFlush, OMX_ALL, NULL) != OMX_ErrorNone);
+
+    wait_for (core, &core->flushed, 2);
+    fail_if (core->empty_done != BUFFERS);
+    fail_if (core->fill_done != 0);
+
+    teardown (core);
+}
+END_TEST
+
+START_TEST (test_error)
+{
+    CustomData *core;
+    guint i;
+
+    g_setenv ("OMX_MOCK_ERROR_AFTER", "2", TRUE);
+
+    core = setup ("OMX.mock.video.encoder");
+
+    for (i = 0; i < BUFFERS; i++)
+        fail_if (OMX_FillThisBuffer (core->omx_handle, core->buffers[1][i]) != OMX_ErrorNone);
+
+    empty_buffer (core, core->buffers[0][0]);
+    empty_buffer (core, core->buffers[0][1]);
+
+    g_mutex_lock (core->mutex);
+    while (core->error == OMX_ErrorNone)
+        g_cond_wait (core->condition, core->mutex);
+    g_mutex_unlock (core->mutex);
+
+    fail_if (core->error != OMX_ErrorHardware);
+    fail_if (OMX_EmptyThisBuffer (core->omx_handle, core->buffers[0][2]) == OMX_ErrorNone);
+
+    teardown (core);
+
+    g_unsetenv ("OMX_MOCK_ERROR_AFTER");
+}
+END_TEST
+
+/*
+ * The port layer on top of the mock.
+ */
+
+static GOmxCore *
+core_new (const gchar *name)
+{
+    GstObject *object;
+    GOmxCore *core;
+
+    object = test_object_new (name);
+
+    core = g_omx_core_new (object, G_OBJECT_GET_CLASS (object));
+    g_object_set (object,
+                  "library-name", lib_name,
+                  "component-name", name,
+                  NULL);
+
+    g_omx_core_init (core);
+    fail_if (!core->omx_handle);
+
+    return core;
+}
+
+static void
+core_free (GOmxCore *core)
+{
+    GstObject *object = core->object;
+
+    g_omx_core_deinit (core);
+    g_omx_core_free (core);
+
+    gst_object_unref (object);
+}
+
+static GOmxPort *
+get_port (GOmxCore *core,
+          const gchar *name,
+          guint index,
+          gboolean omx_allocate)
+{
+    OMX_PARAM_PORTDEFINITIONTYPE param;
+    GOmxPort *port;
+
+    port = g_omx_core_get_port (core, name, index);
+
+    G_OMX_PORT_GET_DEFINITION (port, &param);
+    g_omx_port_setup (port, &param);
+    port->omx_allocate = omx_allocate;
+
+    return port;
+}
+
+/* what the sink pad of the downstream element gets, up to EOS: */
+static gpointer
+forward_thread (gpointer data)
+{
+    GOmxPort **ports = data;
+    gpointer obj;
+
+    while ((obj = g_omx_port_recv (ports[0])))
+    {
+        gboolean eos = GST_IS_EVENT (obj);
+
+        fail_if (g_omx_port_send (ports[1], obj) < 0);
+        gst_mini_object_unref (obj);
+
+        if (eos)
+            break;
+    }
+
+    return NULL;
+}
+
+START_TEST (test_import)
+{
+    GOmxCore *decoder, *sink;
+    GOmxPort *in_port, *out_port, *sink_port;
+    GOmxPort *ports[2];
+    GThread *thread;
+    GstBuffer *buf;
+    GstEvent *eos;
+    guint i;
+
+    decoder = core_new ("OMX.mock.video.decoder");
+    sink = core_new ("OMX.mock.video.sink");
+
+    in_port = get_port (decoder, "in", 0, TRUE);
+    out_port = get_port (decoder, "out", 1, FALSE);
+    sink_port = get_port (sink, "in", 0, FALSE);
+
+    g_omx_core_prepare (decoder);
+    g_omx_core_start (decoder);
+
+    /* like the elements do, once upstream has its buffers: */
+    fail_unless (g_omx_port_import (sink_port, out_port));
+
+    g_omx_core_prepare (sink);
+    g_omx_core_start (sink);
+
+    fail_unless (sink_port->num_imported == out_port->num_buffers);
+
+    ports[0] = out_port;
+    ports[1] = sink_port;
+    thread = g_thread_create (forward_thread, ports, TRUE, NULL);
+
+    for (i = 0; i < BUFFERS * 4; i++)
+    {
+        buf = gst_buffer_new_and_alloc (0x1000);
+        memset (GST_BUFFER_DATA (buf), 0, 0x1000);
+        GST_BUFFER_TIMESTAMP (buf) = i * GST_MSECOND;
+        fail_if (g_omx_port_send (in_port, buf) < 0);
+        gst_buffer_unref (buf);
+    }
+
+    eos = gst_event_new_eos ();
+    g_omx_port_send (in_port, eos);
+    gst_event_unref (eos);
+
+    g_thread_join (thread);
+
+    for (i = 0; i < 100; i++)
+    {
+        if (g_atomic_int_get (&sink_port->stats.ebd) == g_atomic_int_get (&sink_port->stats.etb))
+            break;
+        g_usleep (10000);
+    }
+
+    fail_unless (g_atomic_int_get (&sink_port->stats.zero_copies) > 0);
+
+    /* the mock fails a FillThisBuffer on memory the sink still reads, see
+     * NOTE ABOUT SHARED MEMORY in mock.c:
+     */
+    fail_unless (decoder->omx_error == OMX_ErrorNone);
+    fail_unless (sink->omx_error == OMX_ErrorNone);
+
+    /* upstream goes first, the sink keeps its memory until it's done: */
+    g_omx_port_finish (in_port);
+    g_omx_port_finish (out_port);
+    g_omx_core_stop (decoder);
+    g_omx_core_unload (decoder);
+
+    fail_unless (g_atomic_int_get (&out_port->n_importers) == 1);
+
+    g_omx_port_finish (sink_port);
+    g_omx_core_stop (sink);
+    g_omx_core_unload (sink);
+
+    fail_unless (g_atomic_int_get (&out_port->n_importers) == 0);
+    fail_unless (!sink_port->imported_arena);
+
+    core_free (sink);
+    core_free (decoder);
+}
+END_TEST
+
+#define WIDTH 320
+#define HEIGHT 240
+
+static guint n_allocs;
+
+static GOmxConvert *
+convert_new (GstVideoFormat format)
+{
+    return g_omx_convert_new (GST_VIDEO_FORMAT_NV12, 0, 0, format, 0, 0, WIDTH, HEIGHT);
+}
+
+/* downstream renegotiating from its pad-alloc, which goes through
+ * setcaps, where the element installs a conversion for the new caps:
+ */
+static GstBuffer *
+renegotiate_alloc (GOmxPort *port,
+                   gint len)
+{
+    if (++n_allocs == BUFFERS)
+        g_omx_port_set_convert (port, convert_new (GST_VIDEO_FORMAT_YUY2));
+
+    return NULL;
+}
+
+static gpointer
+recv_thread (gpointer data)
+{
+    GOmxPort *port = data;
+    GList *sizes = NULL;
+    gpointer obj;
+
+    while ((obj = g_omx_port_recv (port)) && GST_IS_BUFFER (obj))
+    {
+        sizes = g_list_append (sizes, GUINT_TO_POINTER (GST_BUFFER_SIZE (obj)));
+        gst_buffer_unref (obj);
+    }
+
+    if (obj)
+        gst_mini_object_unref (obj);
+
+    return sizes;
+}
+
+START_TEST (test_renegotiate)
+{
+    GOmxCore *decoder;
+    GOmxPort *in_port, *out_port;
+    GThread *thread;
+    GstBuffer *buf;
+    GstEvent *eos;
+    GList *sizes, *l;
+    guint i;
+
+    g_setenv ("OMX_MOCK_WIDTH", G_STRINGIFY (WIDTH), TRUE);
+    g_setenv ("OMX_MOCK_HEIGHT", G_STRINGIFY (HEIGHT), TRUE);
+
+    decoder = core_new ("OMX.mock.video.decoder");
+
+    in_port = get_port (decoder, "in", 0, TRUE);
+    out_port = get_port (decoder, "out", 1, TRUE);
+
+    g_omx_port_set_convert (out_port, convert_new (GST_VIDEO_FORMAT_I420));
+
+    g_omx_core_prepare (decoder);
+    g_omx_core_start (decoder);
+
+    n_allocs = 0;
+    out_port->buffer_alloc = renegotiate_alloc;
+
+    thread = g_thread_create (recv_thread, out_port, TRUE, NULL);
+
+    for (i = 0; i < BUFFERS * 2; i++)
+    {
+        buf = gst_buffer_new_and_alloc (0x1000);
+        memset (GST_BUFFER_DATA (buf), 0, 0x1000);
+        fail_if (g_omx_port_send (in_port, buf) < 0);
+        gst_buffer_unref (buf);
+    }
+
+    eos = gst_event_new_eos ();
+    g_omx_port_send (in_port, eos);
+    gst_event_unref (eos);
+
+    /* this used to deadlock, with the port lock held while allocating: */
+    sizes = g_thread_join (thread);
+
+    fail_unless (g_list_length (sizes) == BUFFERS * 2);
+
+    /* the frame being allocated already goes out the new way: */
+    for (l = sizes, i = 1; l; l = l->next, i++)
+    {
+        guint size = GPOINTER_TO_UINT (l->data);
+
+        if (i < BUFFERS)
+            fail_unless (size == WIDTH * HEIGHT * 3 / 2, "frame %u: %u bytes", i, size);
+        else
+            fail_unless (size == WIDTH * HEIGHT * 2, "frame %u: %u bytes", i, size);
+    }
+
+    g_list_free (sizes);
+
+    g_omx_port_finish (in_port);
+    g_omx_port_finish (out_port);
+    g_omx_core_stop (decoder);
+    g_omx_core_unload (decoder);
+
+    core_free (decoder);
+
+    g_unsetenv ("OMX_MOCK_WIDTH");
+    g_unsetenv ("OMX_MOCK_HEIGHT");
+}
+END_TEST
+
+static Suite *
+util_suite (void)
+{
+    Suite *s = suite_create ("mock");
+    TCase *tc_chain = tcase_create ("general");
+
+    lib_name = "libomxil-mock.so";
+
+    gst_init (NULL, NULL);
+
+    GST_DEBUG_CATEGORY_INIT (gstomx_debug, "omx", 0, "gst-openmax");
+    GST_DEBUG_CATEGORY_INIT (gstomx_util_debug, "omx_util", 0, "gst-openmax utility");
+    GST_DEBUG_CATEGORY_INIT (gstomx_ppm, "omx_ppm", 0, "gst-openmax performance");
+
+    g_setenv ("OMX_MOCK_BUFFERS", G_STRINGIFY (BUFFERS), TRUE);
+
+    {
+        dl_handle = dlopen (lib_name, RTLD_LAZY);
+        /* outside of any test, so fail_if() can't report it: */
+        if (!dl_handle)
+            g_error ("can't load %s: %s", lib_name, dlerror ());
+
+        init = dlsym (dl_handle, "OMX_Init");
+        deinit = dlsym (dl_handle, "OMX_Deinit");
+        get_handle = dlsym (dl_handle, "OMX_GetHandle");
+        free_handle = dlsym (dl_handle, "OMX_FreeHandle");
+    }
+
+    tcase_add_test (tc_chain, test_decode);
+    tcase_add_test (tc_chain, test_flush);
+    tcase_add_test (tc_chain, test_error);
+    tcase_add_test (tc_chain, test_import);
+    tcase_add_test (tc_chain, test_renegotiate);
+    suite_add_tcase (s, tc_chain);
+
+    return s;
+}
+
+int
+main (void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = util_suite ();
+    sr = srunner_create (s);
+    srunner_run_all (sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+
+    return (number_failed == 0) ? 0 : 1;
+}
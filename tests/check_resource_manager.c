@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <check.h>
+#include <string.h>
+#include "resource_manager.h"
+
+#define NAME "OMX.TEST.DECODER"
+#define CAPACITY 100
+#define TIMEOUT 5000
+
+START_TEST (test_resource_manager_unlimited)
+{
+    ResourceManager *manager;
+    ResourceSession *a, *b;
+    guint sessions;
+
+    manager = resource_manager_new ();
+
+    a = resource_manager_acquire (manager, NAME, 1000, 0, 0);
+    b = resource_manager_acquire (manager, NAME, 1000, 0, 0);
+    fail_if (!a || !b,
+             "Acquire failed");
+    fail_if (resource_manager_get_usage (manager, NAME, NULL, &sessions) != 2000,
+             "Wrong usage");
+    fail_if (sessions != 2,
+             "Wrong sessions");
+
+    resource_manager_release (manager, a);
+    resource_manager_release (manager, b);
+    fail_if (resource_manager_get_usage (manager, NAME, NULL, &sessions) != 0,
+             "Wrong usage");
+
+    resource_manager_free (manager);
+}
+END_TEST
+
+START_TEST (test_resource_manager_reject)
+{
+    ResourceManager *manager;
+    ResourceSession *a, *b;
+    guint64 capacity;
+
+    manager = resource_manager_new ();
+    resource_manager_set_capacity (manager, NAME, CAPACITY);
+
+    fail_if (resource_manager_acquire (manager, NAME, CAPACITY + 1, 0, TIMEOUT) != NULL,
+             "Admitted more than the capacity");
+
+    a = resource_manager_acquire (manager, NAME, 60, 0, 0);
+    fail_if (!a,
+             "Acquire failed");
+    b = resource_manager_acquire (manager, NAME, 60, 0, 0);
+    fail_if (b != NULL,
+             "Admitted over capacity");
+    b = resource_manager_acquire (manager, NAME, 40, 0, 0);
+    fail_if (!b,
+             "Acquire failed");
+    fail_if (resource_manager_get_usage (manager, NAME, &capacity, NULL) != CAPACITY,
+             "Wrong usage");
+    fail_if (capacity != CAPACITY,
+             "Wrong capacity");
+
+    /* short timeout */
+    fail_if (resource_manager_acquire (manager, NAME, 10, 0, 10) != NULL,
+             "Admitted over capacity");
+
+    resource_manager_release (manager, a);
+    resource_manager_release (manager, b);
+    resource_manager_free (manager);
+}
+END_TEST
+
+typedef struct
+{
+    ResourceManager *manager;
+    gint priority;
+    gchar tag;      /**< what goes in order once served */
+    GMutex *mutex;
+    GString *order;
+} Waiter;
+
+static gpointer
+acquire_func (gpointer data)
+{
+    Waiter *waiter = data;
+    ResourceSession *session;
+
+    session = resource_manager_acquire (waiter->manager, NAME, CAPACITY, waiter->priority, TIMEOUT);
+
+    if (session)
+    {
+        g_mutex_lock (waiter->mutex);
+        g_string_append_c (waiter->order, waiter->tag);
+        g_mutex_unlock (waiter->mutex);
+
+        resource_manager_release (waiter->manager, session);
+    }
+
+    return session;
+}
+
+static void
+wait_for_waiters (ResourceManager *manager,
+                  guint n)
+{
+    Resource *resource;
+
+    while (TRUE)
+    {
+        g_mutex_lock (manager->mutex);
+        resource = g_hash_table_lookup (manager->resources, NAME);
+        if (g_list_length (resource->waiters) == n)
+        {
+            g_mutex_unlock (manager->mutex);
+            return;
+        }
+        g_mutex_unlock (manager->mutex);
+        g_usleep (1000);
+    }
+}
+
+/* queue up waiters of @priorities one after the other, while the whole
+ * capacity is taken, and return the order they are served in, by tag
+ * ('a' for the first one, and so on)
+ */
+static gchar *
+serve_waiters (const gint *priorities,
+               guint n)
+{
+    ResourceManager *manager;
+    ResourceSession *session;
+    Waiter *waiters;
+    GThread **threads;
+    GMutex *mutex;
+    GString *order;
+    guint i;
+
+    manager = resource_manager_new ();
+    resource_manager_set_capacity (manager, NAME, CAPACITY);
+
+    waiters = g_new0 (Waiter, n);
+    threads = g_new0 (GThread *, n);
+    mutex = g_mutex_new ();
+    order = g_string_new (NULL);
+
+    session = resource_manager_acquire (manager, NAME, CAPACITY, 0, 0);
+    fail_if (!session,
+             "Acquire failed");
+
+    for (i = 0; i < n; i++)
+    {
+        waiters[i].manager = manager;
+        waiters[i].priority = priorities[i];
+        waiters[i].tag = 'a' + i;
+        waiters[i].mutex = mutex;
+        waiters[i].order = order;
+        threads[i] = g_thread_create (acquire_func, &waiters[i], TRUE, NULL);
+        wait_for_waiters (manager, i + 1);
+    }
+
+    resource_manager_release (manager, session);
+
+    for (i = 0; i < n; i++)
+    {
+        fail_if (!g_thread_join (threads[i]),
+                 "Acquire timed out");
+    }
+
+    fail_if (resource_manager_get_usage (manager, NAME, NULL, NULL) != 0,
+             "Wrong usage");
+
+    g_mutex_free (mutex);
+    g_free (threads);
+    g_free (waiters);
+    resource_manager_free (manager);
+
+    return g_string_free (order, FALSE);
+}
+
+START_TEST (test_resource_manager_priority)
+{
+    /* in increasing priority, the extremes included: */
+    const gint priorities[] = { G_MININT, 1, 2, G_MAXINT };
+    gchar *order;
+
+    order = serve_waiters (priorities, G_N_ELEMENTS (priorities));
+    fail_if (strcmp (order, "dcba") != 0,
+             "Wrong order: %s", order);
+    g_free (order);
+}
+END_TEST
+
+START_TEST (test_resource_manager_fifo)
+{
+    /* the same priority is served first come, first served: */
+    const gint priorities[] = { 1, 1, 2, 1, 2 };
+    gchar *order;
+
+    order = serve_waiters (priorities, G_N_ELEMENTS (priorities));
+    fail_if (strcmp (order, "ceabd") != 0,
+             "Wrong order: %s", order);
+    g_free (order);
+}
+END_TEST
+
+Suite *
+util_suite (void)
+{
+    Suite *s = suite_create ("util");
+
+    if (!g_thread_supported ())
+        g_thread_init (NULL);
+
+    /* Core test case */
+    TCase *tc_core = tcase_create ("Core");
+    tcase_add_test (tc_core, test_resource_manager_unlimited);
+    tcase_add_test (tc_core, test_resource_manager_reject);
+    tcase_add_test (tc_core, test_resource_manager_priority);
+    tcase_add_test (tc_core, test_resource_manager_fifo);
+    suite_add_tcase (s, tc_core);
+
+    return s;
+}
+
+int
+main (void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = util_suite ();
+    sr = srunner_create (s);
+    srunner_run_all (sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+
+    return (number_failed == 0) ? 0 : 1;
+}
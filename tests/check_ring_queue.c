@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <check.h>
+#include "ring_queue.h"
+
+#define PROCESS_COUNT 0x1000
+#define DISABLE_AT PROCESS_COUNT / 2
+#define SMALL_SIZE 8
+#define N_THREADS 4
+
+START_TEST (test_ring_queue_create)
+{
+    RingQueue *queue;
+    queue = ring_queue_new (SMALL_SIZE);
+    fail_if (!queue,
+             "Construction failed");
+    fail_if (queue->capacity < SMALL_SIZE,
+             "Wrong capacity");
+    fail_if (ring_queue_length (queue) != 0,
+             "Not empty");
+    ring_queue_free (queue);
+}
+END_TEST
+
+START_TEST (test_ring_queue_pop)
+{
+    RingQueue *queue;
+    gpointer foo;
+    gpointer tmp;
+    queue = ring_queue_new (SMALL_SIZE);
+    foo = GINT_TO_POINTER (1);
+    ring_queue_push (queue, foo);
+    fail_if (!ring_queue_exist (queue, foo),
+             "Exist failed");
+    tmp = ring_queue_pop (queue);
+    fail_if (tmp != foo,
+             "Pop failed");
+    fail_if (ring_queue_exist (queue, foo),
+             "Exist failed");
+    tmp = ring_queue_pop_full (queue, FALSE, FALSE);
+    fail_if (tmp != NULL,
+             "Pop from empty queue failed");
+    ring_queue_free (queue);
+}
+END_TEST
+
+START_TEST (test_ring_queue_process)
+{
+    RingQueue *queue;
+    gpointer foo;
+    guint i;
+
+    queue = ring_queue_new (PROCESS_COUNT);
+
+    foo = GINT_TO_POINTER (1);
+    for (i = 0; i < PROCESS_COUNT; i++, foo++)
+    {
+        ring_queue_push (queue, foo);
+    }
+    fail_if (ring_queue_length (queue) != PROCESS_COUNT,
+             "Wrong length");
+    foo = GINT_TO_POINTER (1);
+    for (i = 0; i < PROCESS_COUNT; i++, foo++)
+    {
+        gpointer tmp;
+        tmp = ring_queue_pop (queue);
+        fail_if (tmp != foo,
+                 "Pop failed");
+    }
+
+    ring_queue_free (queue);
+}
+END_TEST
+
+START_TEST (test_ring_queue_reserve)
+{
+    RingQueue *queue;
+
+    queue = ring_queue_new (SMALL_SIZE);
+
+    fail_if (!ring_queue_reserve (queue, SMALL_SIZE * 4),
+             "Reserve failed");
+    fail_if (queue->capacity < SMALL_SIZE * 4,
+             "Wrong capacity");
+
+    ring_queue_push (queue, GINT_TO_POINTER (1));
+    fail_if (ring_queue_reserve (queue, SMALL_SIZE * 8),
+             "Reserve on non empty queue should fail");
+
+    ring_queue_flush (queue);
+    fail_if (ring_queue_length (queue) != 0,
+             "Flush failed");
+    fail_if (!ring_queue_reserve (queue, SMALL_SIZE * 8),
+             "Reserve failed");
+
+    ring_queue_free (queue);
+}
+END_TEST
+
+START_TEST (test_ring_queue_full)
+{
+    RingQueue *queue;
+    guint i;
+
+    queue = ring_queue_new (SMALL_SIZE);
+
+    for (i = 0; i < queue->capacity; i++)
+    {
+        fail_if (!ring_queue_push (queue, GINT_TO_POINTER (i + 1)),
+                 "Push failed");
+    }
+    fail_if (ring_queue_push (queue, GINT_TO_POINTER (i + 1)),
+             "Push on full queue should fail");
+    fail_if (ring_queue_length (queue) != queue->capacity,
+             "Wrong length");
+
+    fail_if (ring_queue_pop (queue) != GINT_TO_POINTER (1),
+             "Pop failed");
+    fail_if (!ring_queue_push (queue, GINT_TO_POINTER (i + 1)),
+             "Push failed");
+
+    ring_queue_free (queue);
+}
+END_TEST
+
+static gpointer
+push_func (gpointer data)
+{
+    RingQueue *queue;
+    gpointer foo;
+    guint i;
+
+    queue = data;
+    foo = GINT_TO_POINTER (1);
+    for (i = 0; i < PROCESS_COUNT; i++, foo++)
+    {
+        /* the queue is smaller than what we push, wait for the poppers: */
+        while (!ring_queue_push (queue, foo))
+            g_thread_yield ();
+    }
+
+    return NULL;
+}
+
+static gpointer
+pop_func (gpointer data)
+{
+    RingQueue *queue;
+    gpointer foo;
+    guint i;
+
+    queue = data;
+    foo = GINT_TO_POINTER (1);
+    for (i = 0; i < PROCESS_COUNT; i++, foo++)
+    {
+        gpointer tmp;
+        tmp = ring_queue_pop (queue);
+        fail_if (tmp != foo,
+                 "Pop failed");
+    }
+
+    return NULL;
+}
+
+/* the queue is much smaller than what goes through it, so this also
+ * exercises the wrap around and the full queue case */
+START_TEST (test_ring_queue_threads)
+{
+    RingQueue *queue;
+    GThread *push_thread;
+    GThread *pop_thread;
+
+    queue = ring_queue_new (SMALL_SIZE);
+
+    pop_thread = g_thread_create (pop_func, queue, TRUE, NULL);
+    push_thread = g_thread_create (push_func, queue, TRUE, NULL);
+
+    g_thread_join (pop_thread);
+    g_thread_join (push_thread);
+
+    ring_queue_free (queue);
+}
+END_TEST
+
+static gpointer
+pop_count_func (gpointer data)
+{
+    RingQueue *queue;
+    guint i;
+    gulong sum = 0;
+
+    queue = data;
+    for (i = 0; i < PROCESS_COUNT; i++)
+    {
+        gpointer tmp;
+        tmp = ring_queue_pop (queue);
+        fail_if (!tmp,
+                 "Pop failed");
+        sum += GPOINTER_TO_UINT (tmp);
+    }
+
+    return GUINT_TO_POINTER (sum);
+}
+
+START_TEST (test_ring_queue_threads_multi)
+{
+    RingQueue *queue;
+    GThread *push_threads[N_THREADS];
+    GThread *pop_threads[N_THREADS];
+    gulong sum = 0;
+    guint i;
+
+    queue = ring_queue_new (SMALL_SIZE);
+
+    for (i = 0; i < N_THREADS; i++)
+    {
+        pop_threads[i] = g_thread_create (pop_count_func, queue, TRUE, NULL);
+        push_threads[i] = g_thread_create (push_func, queue, TRUE, NULL);
+    }
+
+    for (i = 0; i < N_THREADS; i++)
+    {
+        sum += GPOINTER_TO_UINT (g_thread_join (pop_threads[i]));
+        g_thread_join (push_threads[i]);
+    }
+
+    /* every element pushed is popped exactly once */
+    fail_if (sum != N_THREADS * (PROCESS_COUNT * (PROCESS_COUNT + 1) / 2),
+             "Elements lost or duplicated");
+    fail_if (ring_queue_length (queue) != 0,
+             "Not empty");
+
+    ring_queue_free (queue);
+}
+END_TEST
+
+static gpointer
+push_and_disable_func (gpointer data)
+{
+    RingQueue *queue;
+    gpointer foo;
+    guint i;
+
+    queue = data;
+    foo = GINT_TO_POINTER (1);
+    for (i = 0; i < DISABLE_AT; i++, foo++)
+    {
+        ring_queue_push (queue, foo);
+    }
+
+    ring_queue_disable (queue);
+
+    return NULL;
+}
+
+static gpointer
+pop_with_disable_func (gpointer data)
+{
+    RingQueue *queue;
+    gpointer foo;
+    guint i;
+    guint count = 0;
+
+    queue = data;
+    foo = GINT_TO_POINTER (1);
+    for (i = 0; i < PROCESS_COUNT; i++, foo++)
+    {
+        gpointer tmp;
+        tmp = ring_queue_pop (queue);
+        if (!tmp)
+            continue;
+        count++;
+        fail_if (tmp != foo,
+                 "Pop failed");
+    }
+
+    return GINT_TO_POINTER (count);
+}
+
+START_TEST (test_ring_queue_disable_simple)
+{
+    RingQueue *queue;
+    GThread *pop_thread;
+    guint count;
+
+    queue = ring_queue_new (SMALL_SIZE);
+
+    pop_thread = g_thread_create (pop_with_disable_func, queue, TRUE, NULL);
+
+    ring_queue_disable (queue);
+
+    count = GPOINTER_TO_INT (g_thread_join (pop_thread));
+
+    fail_if (count != 0,
+             "Disable failed");
+
+    ring_queue_free (queue);
+}
+END_TEST
+
+START_TEST (test_ring_queue_enable)
+{
+    RingQueue *queue;
+    GThread *push_thread;
+    GThread *pop_thread;
+    guint count;
+
+    queue = ring_queue_new (PROCESS_COUNT);
+
+    pop_thread = g_thread_create (pop_with_disable_func, queue, TRUE, NULL);
+
+    ring_queue_disable (queue);
+
+    count = GPOINTER_TO_INT (g_thread_join (pop_thread));
+
+    fail_if (count != 0,
+             "Disable failed");
+
+    ring_queue_enable (queue);
+
+    pop_thread = g_thread_create (pop_with_disable_func, queue, TRUE, NULL);
+    push_thread = g_thread_create (push_and_disable_func, queue, TRUE, NULL);
+
+    count = GPOINTER_TO_INT (g_thread_join (pop_thread));
+    g_thread_join (push_thread);
+
+    fail_if (count > DISABLE_AT,
+             "Disable failed");
+
+    /* forced pops still drain a disabled queue */
+    while (ring_queue_pop_full (queue, FALSE, TRUE))
+        count++;
+
+    fail_if (count != DISABLE_AT,
+             "Elements lost");
+
+    ring_queue_free (queue);
+}
+END_TEST
+
+Suite *
+util_suite (void)
+{
+    Suite *s = suite_create ("util");
+
+    if (!g_thread_supported ())
+        g_thread_init (NULL);
+
+    /* Core test case */
+    TCase *tc_core = tcase_create ("Core");
+    tcase_add_test (tc_core, test_ring_queue_create);
+    tcase_add_test (tc_core, test_ring_queue_pop);
+    tcase_add_test (tc_core, test_ring_queue_process);
+    tcase_add_test (tc_core, test_ring_queue_reserve);
+    tcase_add_test (tc_core, test_ring_queue_full);
+    tcase_add_test (tc_core, test_ring_queue_threads);
+    tcase_add_test (tc_core, test_ring_queue_threads_multi);
+    tcase_add_test (tc_core, test_ring_queue_disable_simple);
+    tcase_add_test (tc_core, test_ring_queue_enable);
+    suite_add_tcase (s, tc_core);
+
+    return s;
+}
+
+int
+main (void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = util_suite ();
+    sr = srunner_create (s);
+    srunner_run_all (sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+
+    return (number_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,1312 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * A stand-in OpenMAX IL library, to run the plugin (and benchmark it) on
+ * machines without the hardware.  The kind of component is picked from its
+ * name:
+ *
+ *   "...decoder..."  compressed video in, NV12 out
+ *   "...encoder..."  NV12 in, compressed video out
+ *   "...camera..."   NV12 out (port 1) at a fixed frame rate, no input
+ *   "...sink..."     NV12 in (port 0), no output
+ *   anything else    audio passthrough, like tests/standalone
+ *
+ * and it is configured with environment variables, read in OMX_Init():
+ *
+ *   OMX_MOCK_PROCESS_TIME     us of processing per buffer (0)
+ *   OMX_MOCK_KB_TIME          us of processing per KiB of input (0)
+ *   OMX_MOCK_FRAME_INTERVAL   us between camera frames (33333)
+ *   OMX_MOCK_BUFFERS          nBufferCountMin/Actual of each port (4)
+ *   OMX_MOCK_WIDTH/HEIGHT     video resolution (320x240)
+ *   OMX_MOCK_RATIO            encoder compression ratio (20)
+ *   OMX_MOCK_SETTINGS_CHANGED send OMX_EventPortSettingsChanged after
+ *                             this many output buffers (0 = never)
+ *   OMX_MOCK_READONLY         keep a reference on each output buffer until
+ *                             the next one, like a decoder keeping reference
+ *                             frames (TI READONLY/refcount semantics)
+ *   OMX_MOCK_ERROR_AFTER      fail with OMX_ErrorHardware after this many
+ *                             input buffers (0 = never)
+ *
+ * Components can be tunneled with OMX_SetupTunnel, see NOTE ABOUT TUNNELS
+ * below, and the same memory can be given to several of them, see NOTE
+ * ABOUT SHARED MEMORY.
+ */
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include <glib.h>
+
+#include <stdlib.h> /* For calloc, free, atoi */
+#include <string.h> /* For memcpy, strstr */
+
+#ifdef USE_OMXTICORE
+#  include <OMX_TI_Common.h>
+#  include <OMX_TI_Core.h>
+#  define MOCK_BUFFERFLAG_READONLY  OMX_TI_BUFFERFLAG_READONLY
+#  define MOCK_EVENT_REFCOUNT       OMX_TI_EventBufferRefCount
+#else
+/* only acted upon by a plugin built with the TI core */
+#  define MOCK_BUFFERFLAG_READONLY  0x00000200
+#  define MOCK_EVENT_REFCOUNT       ((OMX_EVENTTYPE) 0x7F000001)
+#endif
+
+typedef enum MockKind MockKind;
+typedef struct MockConfig MockConfig;
+typedef struct MockComponent MockComponent;
+typedef struct MockPort MockPort;
+
+enum MockKind
+{
+    MOCK_FILTER,
+    MOCK_DECODER,
+    MOCK_ENCODER,
+    MOCK_CAMERA,
+    MOCK_SINK
+};
+
+struct MockConfig
+{
+    gulong process_time;
+    gulong kb_time;
+    gulong frame_interval;
+    guint buffers;
+    guint width;
+    guint height;
+    guint ratio;
+    guint settings_changed;
+    gboolean readonly;
+    guint error_after;
+};
+
+struct MockPort
+{
+    OMX_PARAM_PORTDEFINITIONTYPE def;
+    GQueue *queue;          /**< buffers given to us, not yet processed */
+    guint allocated;        /**< buffer headers currently allocated */
+    gboolean tunneled;
+    MockComponent *peer;    /**< of a tunnel, NULL once it's gone */
+    GList *tunnel_buffers;  /**< of the output port, the supplier */
+};
+
+struct MockComponent
+{
+    OMX_COMPONENTTYPE *omx;
+    MockKind kind;
+    OMX_STATETYPE state;
+    OMX_CALLBACKTYPE callbacks;
+    OMX_PTR app_data;
+    MockPort ports[2];
+
+    GMutex *mutex;
+    GCond *cond;
+    GThread *thread;
+    gboolean quit;
+    gboolean busy;          /**< processing buffers out of the queues */
+    gboolean failed;
+
+    guint n_in;
+    guint n_out;
+    OMX_BUFFERHEADERTYPE *referenced;   /**< with OMX_MOCK_READONLY */
+};
+
+static MockConfig config;
+
+/* the tunnel links between components, see NOTE ABOUT TUNNELS; never
+ * taken with the mutex of a component held
+ */
+G_LOCK_DEFINE_STATIC (tunnel);
+
+/* see NOTE ABOUT SHARED MEMORY */
+G_LOCK_DEFINE_STATIC (reading);
+static GHashTable *reading;
+
+static guint
+env_uint (const gchar *name,
+          guint def)
+{
+    const gchar *env = g_getenv (name);
+    return env ? (guint) atoi (env) : def;
+}
+
+OMX_ERRORTYPE
+OMX_Init (void)
+{
+    if (!g_thread_supported ())
+    {
+        g_thread_init (NULL);
+    }
+
+    config.process_time = env_uint ("OMX_MOCK_PROCESS_TIME", 0);
+    config.kb_time = env_uint ("OMX_MOCK_KB_TIME", 0);
+    config.frame_interval = env_uint ("OMX_MOCK_FRAME_INTERVAL", 33333);
+    config.buffers = MAX (env_uint ("OMX_MOCK_BUFFERS", 4), 1);
+    config.width = env_uint ("OMX_MOCK_WIDTH", 320);
+    config.height = env_uint ("OMX_MOCK_HEIGHT", 240);
+    config.ratio = MAX (env_uint ("OMX_MOCK_RATIO", 20), 1);
+    config.settings_changed = env_uint ("OMX_MOCK_SETTINGS_CHANGED", 0);
+    config.readonly = env_uint ("OMX_MOCK_READONLY", 0);
+    config.error_after = env_uint ("OMX_MOCK_ERROR_AFTER", 0);
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE
+OMX_Deinit (void)
+{
+    return OMX_ErrorNone;
+}
+
+/*
+ * Ports.
+ */
+
+static void
+update_buffer_size (OMX_PARAM_PORTDEFINITIONTYPE *def)
+{
+    OMX_VIDEO_PORTDEFINITIONTYPE *video = &def->format.video;
+
+    if (def->eDomain != OMX_PortDomainVideo)
+        return;
+
+    if (video->eCompressionFormat == OMX_VIDEO_CodingUnused)
+    {
+        video->nStride = MAX ((guint) video->nStride, video->nFrameWidth);
+        video->nSliceHeight = MAX (video->nSliceHeight, video->nFrameHeight);
+        def->nBufferSize = video->nStride * video->nSliceHeight * 3 / 2;
+    }
+    else
+    {
+        def->nBufferSize = MAX (video->nFrameWidth * video->nFrameHeight / 2, 0x1000);
+    }
+}
+
+static void
+port_init (MockPort *port,
+           guint index,
+           MockKind kind)
+{
+    OMX_PARAM_PORTDEFINITIONTYPE *def = &port->def;
+    gboolean raw;
+
+    def->nSize = sizeof (OMX_PARAM_PORTDEFINITIONTYPE);
+    def->nVersion.nVersion = 1;
+    def->nPortIndex = index;
+    def->eDir = index == 0 ? OMX_DirInput : OMX_DirOutput;
+    def->nBufferCountActual = config.buffers;
+    def->nBufferCountMin = config.buffers;
+    def->bEnabled = !(kind == MOCK_CAMERA && index == 0) &&
+                    !(kind == MOCK_SINK && index == 1);
+
+    port->queue = g_queue_new ();
+
+    if (kind == MOCK_FILTER)
+    {
+        def->eDomain = OMX_PortDomainAudio;
+        def->nBufferSize = 0x1000;
+        return;
+    }
+
+    /* raw on the decoded side: */
+    raw = (kind == MOCK_DECODER) == (index == 1) || kind == MOCK_CAMERA;
+
+    def->eDomain = OMX_PortDomainVideo;
+    def->format.video.nFrameWidth = config.width;
+    def->format.video.nFrameHeight = config.height;
+    def->format.video.xFramerate = 30 << 16;
+
+    if (raw)
+    {
+        def->format.video.eCompressionFormat = OMX_VIDEO_CodingUnused;
+        def->format.video.eColorFormat = OMX_COLOR_FormatYUV420PackedSemiPlanar;
+    }
+    else
+    {
+        def->format.video.eCompressionFormat = OMX_VIDEO_CodingAVC;
+        def->format.video.eColorFormat = OMX_COLOR_FormatUnused;
+    }
+
+    update_buffer_size (def);
+}
+
+static inline MockPort *
+get_port (MockComponent *mock,
+          OMX_U32 index)
+{
+    return index < 2 ? &mock->ports[index] : NULL;
+}
+
+static inline MockComponent *
+get_mock (OMX_HANDLETYPE handle)
+{
+    return ((OMX_COMPONENTTYPE *) handle)->pComponentPrivate;
+}
+
+/*
+ * Shared memory.
+ *
+ * NOTE ABOUT SHARED MEMORY: the client may register the same memory on
+ * several components, ie. the output buffers of one as the input buffers of
+ * another.  The memory of an input buffer is read until the buffer is given
+ * back, so filling it meanwhile is an error, which is reported like the
+ * hardware would, with OMX_EventError.  The memory being read is counted in
+ * @reading, across all components.
+ */
+
+static void
+reading_add (OMX_BUFFERHEADERTYPE *buffer)
+{
+    gint n;
+
+    G_LOCK (reading);
+    if (!reading)
+        reading = g_hash_table_new (NULL, NULL);
+    n = GPOINTER_TO_INT (g_hash_table_lookup (reading, buffer->pBuffer));
+    g_hash_table_insert (reading, buffer->pBuffer, GINT_TO_POINTER (n + 1));
+    G_UNLOCK (reading);
+}
+
+static void
+reading_remove (OMX_BUFFERHEADERTYPE *buffer)
+{
+    gint n;
+
+    G_LOCK (reading);
+    n = reading ? GPOINTER_TO_INT (g_hash_table_lookup (reading, buffer->pBuffer)) : 0;
+    if (n > 1)
+        g_hash_table_insert (reading, buffer->pBuffer, GINT_TO_POINTER (n - 1));
+    else if (n)
+        g_hash_table_remove (reading, buffer->pBuffer);
+    G_UNLOCK (reading);
+}
+
+static gboolean
+is_reading (OMX_BUFFERHEADERTYPE *buffer)
+{
+    gboolean ret;
+
+    G_LOCK (reading);
+    ret = reading && buffer->pBuffer && g_hash_table_lookup (reading, buffer->pBuffer);
+    G_UNLOCK (reading);
+
+    return ret;
+}
+
+/*
+ * Callbacks.  These are never called with the mutex held, but the
+ * buffer callbacks are called with busy set, so they are not reordered
+ * with a flush.
+ */
+
+static void
+send_event (MockComponent *mock,
+            OMX_EVENTTYPE event,
+            OMX_U32 data_1,
+            OMX_U32 data_2)
+{
+    if (mock->callbacks.EventHandler)
+        mock->callbacks.EventHandler (mock->omx, mock->app_data, event,
+                                      data_1, data_2, NULL);
+}
+
+static void pass_buffer (MockComponent *mock, OMX_U32 index,
+                         OMX_BUFFERHEADERTYPE *buffer);
+
+static void
+buffer_done (MockComponent *mock,
+             OMX_U32 index,
+             OMX_BUFFERHEADERTYPE *buffer)
+{
+    if (mock->ports[index].tunneled)
+    {
+        pass_buffer (mock, index, buffer);
+    }
+    else if (index == 0)
+    {
+        /* the client may fill it as soon as it knows: */
+        reading_remove (buffer);
+        mock->callbacks.EmptyBufferDone (mock->omx, mock->app_data, buffer);
+    }
+    else
+    {
+        mock->callbacks.FillBufferDone (mock->omx, mock->app_data, buffer);
+    }
+}
+
+/* called with the mutex, returns the buffers of port @index, to be given
+ * back without it
+ */
+static GList *
+take_buffers (MockComponent *mock,
+              OMX_U32 index)
+{
+    MockPort *port = get_port (mock, index);
+    GList *list = NULL;
+
+    /* the supplier of a tunnel keeps its buffers: */
+    if (port->tunneled && index == 1)
+        return NULL;
+
+    while (!g_queue_is_empty (port->queue))
+        list = g_list_prepend (list, g_queue_pop_tail (port->queue));
+
+    return list;
+}
+
+static void
+return_buffers (MockComponent *mock,
+                OMX_U32 index,
+                GList *list)
+{
+    GList *l;
+
+    for (l = list; l; l = l->next)
+    {
+        OMX_BUFFERHEADERTYPE *buffer = l->data;
+
+        if (index == 1)
+            buffer->nFilledLen = 0;
+        buffer_done (mock, index, buffer);
+    }
+
+    g_list_free (list);
+}
+
+/* wait for the worker to be done with what it took out of the queues, and
+ * give back everything we hold on @index (or OMX_ALL)
+ */
+static void
+flush_ports (MockComponent *mock,
+             OMX_U32 index)
+{
+    GList *in = NULL, *out = NULL;
+    OMX_BUFFERHEADERTYPE *referenced = NULL;
+
+    g_mutex_lock (mock->mutex);
+
+    while (mock->busy)
+        g_cond_wait (mock->cond, mock->mutex);
+
+    /* keep the worker out meanwhile: */
+    mock->busy = TRUE;
+
+    if (index == 0 || index == OMX_ALL)
+        in = take_buffers (mock, 0);
+
+    if (index == 1 || index == OMX_ALL)
+    {
+        out = take_buffers (mock, 1);
+        referenced = mock->referenced;
+        mock->referenced = NULL;
+    }
+
+    g_mutex_unlock (mock->mutex);
+
+    return_buffers (mock, 0, in);
+    return_buffers (mock, 1, out);
+
+    if (referenced)
+        send_event (mock, MOCK_EVENT_REFCOUNT, (OMX_U32) (gsize) referenced, 0);
+
+    g_mutex_lock (mock->mutex);
+    mock->busy = FALSE;
+    g_cond_broadcast (mock->cond);
+    g_mutex_unlock (mock->mutex);
+}
+
+/*
+ * Processing.
+ */
+
+/* called with the mutex */
+static inline gboolean
+can_process (MockComponent *mock)
+{
+    if (mock->state != OMX_StateExecuting || mock->failed || mock->busy)
+        return FALSE;
+
+    if (mock->kind != MOCK_SINK &&
+        (!mock->ports[1].def.bEnabled || g_queue_is_empty (mock->ports[1].queue)))
+        return FALSE;
+
+    if (mock->kind == MOCK_CAMERA)
+        return TRUE;
+
+    return mock->ports[0].def.bEnabled && !g_queue_is_empty (mock->ports[0].queue);
+}
+
+static void
+process (MockComponent *mock,
+         OMX_BUFFERHEADERTYPE *in,
+         OMX_BUFFERHEADERTYPE *out)
+{
+    gulong cost = config.process_time;
+
+    if (in)
+        cost += config.kb_time * in->nFilledLen / 1024;
+
+    if (cost)
+        g_usleep (cost);
+
+    switch (mock->kind)
+    {
+        case MOCK_FILTER:
+            {
+                OMX_U32 size = MIN (in->nFilledLen, out->nAllocLen);
+                memcpy (out->pBuffer, in->pBuffer + in->nOffset, size);
+                out->nFilledLen = size;
+                in->nOffset += size;
+                in->nFilledLen -= size;
+                break;
+            }
+        case MOCK_DECODER:
+            /* the content doesn't matter, only the cost: */
+            out->nFilledLen = in->nFilledLen ? mock->ports[1].def.nBufferSize : 0;
+            in->nFilledLen = 0;
+            break;
+        case MOCK_ENCODER:
+            out->nFilledLen = in->nFilledLen ? MAX (in->nFilledLen / config.ratio, 1) : 0;
+            out->nFilledLen = MIN (out->nFilledLen, out->nAllocLen);
+            in->nFilledLen = 0;
+            break;
+        case MOCK_CAMERA:
+            out->nFilledLen = mock->ports[1].def.nBufferSize;
+            out->nTimeStamp = (OMX_TICKS) mock->n_out * config.frame_interval;
+            out->nFlags = 0;
+            return;
+        case MOCK_SINK:
+            in->nFilledLen = 0;
+            return;
+    }
+
+    out->nOffset = 0;
+    out->nTimeStamp = in->nTimeStamp;
+    out->nFlags = in->nFlags;
+}
+
+static gpointer
+worker_thread (gpointer data)
+{
+    MockComponent *mock = data;
+
+    g_mutex_lock (mock->mutex);
+
+    while (!mock->quit)
+    {
+        OMX_BUFFERHEADERTYPE *in = NULL, *out = NULL, *release = NULL;
+        gboolean settings_changed = FALSE, error = FALSE;
+
+        if (!can_process (mock))
+        {
+            g_cond_wait (mock->cond, mock->mutex);
+            continue;
+        }
+
+        mock->busy = TRUE;
+        if (mock->kind != MOCK_CAMERA)
+            in = g_queue_pop_head (mock->ports[0].queue);
+        if (mock->kind != MOCK_SINK)
+            out = g_queue_pop_head (mock->ports[1].queue);
+
+        g_mutex_unlock (mock->mutex);
+
+        if (mock->kind == MOCK_CAMERA)
+            g_usleep (config.frame_interval);
+
+        process (mock, in, out);
+
+        if (in)
+            mock->n_in++;
+        if (out && out->nFilledLen)
+            mock->n_out++;
+
+        if (config.readonly && out && out->nFilledLen)
+        {
+            out->nFlags |= MOCK_BUFFERFLAG_READONLY;
+            release = mock->referenced;
+            mock->referenced = out;
+        }
+
+        if (config.settings_changed && mock->n_out == config.settings_changed)
+        {
+            OMX_PARAM_PORTDEFINITIONTYPE *def = &mock->ports[1].def;
+
+            g_mutex_lock (mock->mutex);
+            def->format.video.nFrameHeight += 16;
+            update_buffer_size (def);
+            g_mutex_unlock (mock->mutex);
+            settings_changed = TRUE;
+        }
+
+        if (config.error_after && mock->n_in == config.error_after)
+            error = TRUE;
+
+        if (out)
+            buffer_done (mock, 1, out);
+        if (release)
+            send_event (mock, MOCK_EVENT_REFCOUNT, (OMX_U32) (gsize) release, 0);
+
+        /* keep it until it has all been consumed: */
+        if (in)
+        {
+            if (in->nFilledLen)
+            {
+                g_mutex_lock (mock->mutex);
+                g_queue_push_head (mock->ports[0].queue, in);
+                g_mutex_unlock (mock->mutex);
+            }
+            else
+            {
+                in->nOffset = 0;
+                buffer_done (mock, 0, in);
+            }
+        }
+
+        if (settings_changed)
+            send_event (mock, OMX_EventPortSettingsChanged, 1, 0);
+
+        g_mutex_lock (mock->mutex);
+
+        if (error)
+            mock->failed = TRUE;
+
+        mock->busy = FALSE;
+        g_cond_broadcast (mock->cond);
+
+        if (error)
+        {
+            g_mutex_unlock (mock->mutex);
+            send_event (mock, OMX_EventError, OMX_ErrorHardware, 0);
+            g_mutex_lock (mock->mutex);
+        }
+    }
+
+    g_mutex_unlock (mock->mutex);
+
+    return NULL;
+}
+
+/*
+ * Tunnels.
+ *
+ * NOTE ABOUT TUNNELS: the output port is always the supplier.  It allocates
+ * the buffers on its way from Loaded to Idle, and both sides use the same
+ * headers: each one passes the buffers it is done with to the queue of the
+ * other one, instead of giving them back to the client.  They are freed
+ * once both components are back in Loaded, or with the last of the two
+ * handles.  Unlike real components, neither transition waits for the peer.
+ */
+
+static gboolean
+is_loaded (MockComponent *mock)
+{
+    gboolean ret;
+
+    /* one that is gone doesn't hold anything up */
+    if (!mock)
+        return TRUE;
+
+    g_mutex_lock (mock->mutex);
+    ret = mock->state == OMX_StateLoaded;
+    g_mutex_unlock (mock->mutex);
+
+    return ret;
+}
+
+static void
+clear_queue (MockComponent *mock,
+             OMX_U32 index)
+{
+    if (!mock)
+        return;
+
+    g_mutex_lock (mock->mutex);
+    while (!g_queue_is_empty (mock->ports[index].queue))
+        g_queue_pop_head (mock->ports[index].queue);
+    g_mutex_unlock (mock->mutex);
+}
+
+static void
+free_tunnel_buffers (GList **list)
+{
+    g_list_foreach (*list, (GFunc) free, NULL);
+    g_list_free (*list);
+    *list = NULL;
+}
+
+static void
+pass_buffer (MockComponent *mock,
+             OMX_U32 index,
+             OMX_BUFFERHEADERTYPE *buffer)
+{
+    MockComponent *peer;
+
+    G_LOCK (tunnel);
+
+    /* with the peer gone, the buffer just stays with the supplier: */
+    peer = mock->ports[index].peer;
+    if (peer)
+    {
+        g_mutex_lock (peer->mutex);
+        g_queue_push_tail (peer->ports[1 - index].queue, buffer);
+        g_cond_broadcast (peer->cond);
+        g_mutex_unlock (peer->mutex);
+    }
+
+    G_UNLOCK (tunnel);
+}
+
+/* on the way from Loaded to Idle, as the supplier */
+static void
+tunnel_allocate (MockComponent *mock)
+{
+    MockPort *port = &mock->ports[1];
+    MockComponent *peer;
+    OMX_U32 count, size;
+    guint i;
+
+    G_LOCK (tunnel);
+
+    /* unless the peer still has the ones from before: */
+    if (!port->tunneled || port->tunnel_buffers)
+        goto leave;
+
+    g_mutex_lock (mock->mutex);
+    count = port->def.nBufferCountActual;
+    size = port->def.nBufferSize;
+    g_mutex_unlock (mock->mutex);
+
+    peer = port->peer;
+    if (peer)
+    {
+        g_mutex_lock (peer->mutex);
+        count = MAX (count, peer->ports[0].def.nBufferCountActual);
+        size = MAX (size, peer->ports[0].def.nBufferSize);
+        g_mutex_unlock (peer->mutex);
+    }
+
+    g_mutex_lock (mock->mutex);
+
+    for (i = 0; i < count; i++)
+    {
+        OMX_BUFFERHEADERTYPE *header;
+
+        header = calloc (1, sizeof (OMX_BUFFERHEADERTYPE) + size);
+        header->nSize = sizeof (OMX_BUFFERHEADERTYPE);
+        header->nVersion.nVersion = 1;
+        header->pBuffer = (OMX_U8 *) (header + 1);
+        header->nAllocLen = size;
+        header->nInputPortIndex = 0;
+        header->nOutputPortIndex = 1;
+
+        port->tunnel_buffers = g_list_prepend (port->tunnel_buffers, header);
+        g_queue_push_tail (port->queue, header);
+    }
+
+    g_mutex_unlock (mock->mutex);
+
+leave:
+    G_UNLOCK (tunnel);
+}
+
+/* back in Loaded, with the worker stopped */
+static void
+tunnel_unload (MockComponent *mock)
+{
+    MockComponent *supplier, *peer;
+    GList **list;
+
+    G_LOCK (tunnel);
+
+    if (mock->ports[1].tunneled)
+    {
+        supplier = mock;
+        peer = mock->ports[1].peer;
+    }
+    else if (mock->ports[0].tunneled)
+    {
+        supplier = mock->ports[0].peer;
+        peer = mock;
+    }
+    else
+    {
+        goto leave;
+    }
+
+    /* the peer takes over the buffers when the supplier goes away: */
+    list = supplier ? &supplier->ports[1].tunnel_buffers : &peer->ports[0].tunnel_buffers;
+
+    if (*list && is_loaded (supplier) && is_loaded (peer))
+    {
+        clear_queue (supplier, 1);
+        clear_queue (peer, 0);
+        free_tunnel_buffers (list);
+    }
+
+leave:
+    G_UNLOCK (tunnel);
+}
+
+/* from OMX_FreeHandle, with the worker stopped */
+static void
+tunnel_free (MockComponent *mock)
+{
+    MockComponent *peer;
+
+    G_LOCK (tunnel);
+
+    peer = mock->ports[1].peer;
+    if (peer)
+    {
+        /* it may still be using them: */
+        peer->ports[0].peer = NULL;
+        peer->ports[0].tunnel_buffers = mock->ports[1].tunnel_buffers;
+        mock->ports[1].tunnel_buffers = NULL;
+    }
+
+    peer = mock->ports[0].peer;
+    if (peer)
+        peer->ports[1].peer = NULL;
+
+    free_tunnel_buffers (&mock->ports[0].tunnel_buffers);
+    free_tunnel_buffers (&mock->ports[1].tunnel_buffers);
+
+    G_UNLOCK (tunnel);
+}
+
+/*
+ * Component methods.
+ */
+
+static OMX_ERRORTYPE
+comp_GetComponentVersion (OMX_HANDLETYPE handle,
+                          OMX_STRING name,
+                          OMX_VERSIONTYPE *component_version,
+                          OMX_VERSIONTYPE *spec_version,
+                          OMX_UUIDTYPE *uuid)
+{
+    component_version->nVersion = 1;
+    spec_version->s.nVersionMajor = 1;
+    spec_version->s.nVersionMinor = 1;
+    spec_version->s.nRevision = 0;
+    spec_version->s.nStep = 0;
+
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+comp_GetState (OMX_HANDLETYPE handle,
+               OMX_STATETYPE *state)
+{
+    MockComponent *mock = get_mock (handle);
+
+    g_mutex_lock (mock->mutex);
+    *state = mock->state;
+    g_mutex_unlock (mock->mutex);
+
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+comp_GetParameter (OMX_HANDLETYPE handle,
+                   OMX_INDEXTYPE index,
+                   OMX_PTR param)
+{
+    MockComponent *mock = get_mock (handle);
+
+    switch (index)
+    {
+        case OMX_IndexParamPortDefinition:
+            {
+                OMX_PARAM_PORTDEFINITIONTYPE *def = param;
+                MockPort *port = get_port (mock, def->nPortIndex);
+
+                if (!port)
+                    return OMX_ErrorBadPortIndex;
+
+                g_mutex_lock (mock->mutex);
+                memcpy (def, &port->def, MIN (def->nSize, port->def.nSize));
+                g_mutex_unlock (mock->mutex);
+                break;
+            }
+        case OMX_IndexParamCompBufferSupplier:
+            {
+                OMX_PARAM_BUFFERSUPPLIERTYPE *supplier = param;
+
+                if (!get_port (mock, supplier->nPortIndex))
+                    return OMX_ErrorBadPortIndex;
+
+                /* see NOTE ABOUT TUNNELS */
+                supplier->eBufferSupplier = OMX_BufferSupplyOutput;
+                break;
+            }
+        default:
+            return OMX_ErrorUnsupportedIndex;
+    }
+
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+comp_SetParameter (OMX_HANDLETYPE handle,
+                   OMX_INDEXTYPE index,
+                   OMX_PTR param)
+{
+    MockComponent *mock = get_mock (handle);
+
+    switch (index)
+    {
+        case OMX_IndexParamPortDefinition:
+            {
+                OMX_PARAM_PORTDEFINITIONTYPE *def = param;
+                MockPort *port = get_port (mock, def->nPortIndex);
+                OMX_ERRORTYPE ret = OMX_ErrorNone;
+
+                if (!port)
+                    return OMX_ErrorBadPortIndex;
+
+                g_mutex_lock (mock->mutex);
+
+                if (def->nBufferCountActual < port->def.nBufferCountMin)
+                {
+                    ret = OMX_ErrorBadParameter;
+                }
+                else
+                {
+                    /* the read-only fields stay: */
+                    port->def.nBufferCountActual = def->nBufferCountActual;
+                    if (port->def.eDomain == OMX_PortDomainVideo)
+                    {
+                        port->def.format.video = def->format.video;
+                        update_buffer_size (&port->def);
+                    }
+                    port->def.nBufferSize = MAX (port->def.nBufferSize, def->nBufferSize);
+                }
+
+                g_mutex_unlock (mock->mutex);
+
+                return ret;
+            }
+        default:
+            /* roles, codec settings, etc: */
+            break;
+    }
+
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+comp_GetConfig (OMX_HANDLETYPE handle,
+                OMX_INDEXTYPE index,
+                OMX_PTR config)
+{
+    return OMX_ErrorUnsupportedIndex;
+}
+
+static OMX_ERRORTYPE
+comp_SetConfig (OMX_HANDLETYPE handle,
+                OMX_INDEXTYPE index,
+                OMX_PTR config)
+{
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+comp_GetExtensionIndex (OMX_HANDLETYPE handle,
+                        OMX_STRING name,
+                        OMX_INDEXTYPE *index)
+{
+    return OMX_ErrorUnsupportedIndex;
+}
+
+static void
+set_state (MockComponent *mock,
+           OMX_STATETYPE state)
+{
+    OMX_STATETYPE old_state;
+
+    g_mutex_lock (mock->mutex);
+    old_state = mock->state;
+    g_mutex_unlock (mock->mutex);
+
+    /* leaving Executing or Pause, give back all the buffers: */
+    if (state == OMX_StateIdle && old_state != OMX_StateLoaded)
+        flush_ports (mock, OMX_ALL);
+
+    if (state == OMX_StateIdle && old_state == OMX_StateLoaded)
+        tunnel_allocate (mock);
+
+    g_mutex_lock (mock->mutex);
+
+    if (old_state == OMX_StateLoaded && state == OMX_StateIdle)
+    {
+        mock->quit = FALSE;
+        mock->thread = g_thread_create (worker_thread, mock, TRUE, NULL);
+    }
+
+    mock->state = state;
+    g_cond_broadcast (mock->cond);
+
+    g_mutex_unlock (mock->mutex);
+
+    if (state == OMX_StateLoaded && mock->thread)
+    {
+        g_mutex_lock (mock->mutex);
+        mock->quit = TRUE;
+        g_cond_broadcast (mock->cond);
+        g_mutex_unlock (mock->mutex);
+
+        g_thread_join (mock->thread);
+        mock->thread = NULL;
+    }
+
+    if (state == OMX_StateLoaded)
+        tunnel_unload (mock);
+
+    send_event (mock, OMX_EventCmdComplete, OMX_CommandStateSet, state);
+}
+
+static void
+set_port_enabled (MockComponent *mock,
+                  OMX_U32 index,
+                  gboolean enabled)
+{
+    guint i;
+
+    for (i = 0; i < 2; i++)
+    {
+        if (index != i && index != OMX_ALL)
+            continue;
+
+        if (!enabled)
+            flush_ports (mock, i);
+
+        g_mutex_lock (mock->mutex);
+        mock->ports[i].def.bEnabled = enabled;
+        g_cond_broadcast (mock->cond);
+        g_mutex_unlock (mock->mutex);
+
+        send_event (mock, OMX_EventCmdComplete,
+                    enabled ? OMX_CommandPortEnable : OMX_CommandPortDisable, i);
+    }
+}
+
+static OMX_ERRORTYPE
+comp_SendCommand (OMX_HANDLETYPE handle,
+                  OMX_COMMANDTYPE command,
+                  OMX_U32 param_1,
+                  OMX_PTR data)
+{
+    MockComponent *mock = get_mock (handle);
+
+    switch (command)
+    {
+        case OMX_CommandStateSet:
+            set_state (mock, param_1);
+            break;
+        case OMX_CommandFlush:
+            {
+                guint i;
+
+                flush_ports (mock, param_1);
+
+                /* one completion per port, even for OMX_ALL: */
+                for (i = 0; i < 2; i++)
+                {
+                    if (param_1 == i || param_1 == OMX_ALL)
+                        send_event (mock, OMX_EventCmdComplete, OMX_CommandFlush, i);
+                }
+            }
+            break;
+        case OMX_CommandPortDisable:
+            set_port_enabled (mock, param_1, FALSE);
+            break;
+        case OMX_CommandPortEnable:
+            set_port_enabled (mock, param_1, TRUE);
+            break;
+        default:
+            return OMX_ErrorNotImplemented;
+    }
+
+    return OMX_ErrorNone;
+}
+
+static OMX_BUFFERHEADERTYPE *
+buffer_new (MockComponent *mock,
+            OMX_U32 index,
+            OMX_PTR data,
+            OMX_U32 size,
+            OMX_U8 *buffer)
+{
+    OMX_BUFFERHEADERTYPE *header;
+
+    /* when we allocate the memory, it goes along with the header: */
+    header = calloc (1, sizeof (OMX_BUFFERHEADERTYPE) + (buffer ? 0 : size));
+    header->nSize = sizeof (OMX_BUFFERHEADERTYPE);
+    header->nVersion.nVersion = 1;
+    header->pBuffer = buffer ? buffer : (OMX_U8 *) (header + 1);
+    header->nAllocLen = size;
+    header->pAppPrivate = data;
+    header->nInputPortIndex = index;
+    header->nOutputPortIndex = index;
+
+    g_mutex_lock (mock->mutex);
+    mock->ports[index].allocated++;
+    g_mutex_unlock (mock->mutex);
+
+    return header;
+}
+
+static OMX_ERRORTYPE
+comp_UseBuffer (OMX_HANDLETYPE handle,
+                OMX_BUFFERHEADERTYPE **buffer_header,
+                OMX_U32 index,
+                OMX_PTR data,
+                OMX_U32 size,
+                OMX_U8 *buffer)
+{
+    if (index > 1)
+        return OMX_ErrorBadPortIndex;
+
+    *buffer_header = buffer_new (get_mock (handle), index, data, size, buffer);
+
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+comp_AllocateBuffer (OMX_HANDLETYPE handle,
+                     OMX_BUFFERHEADERTYPE **buffer_header,
+                     OMX_U32 index,
+                     OMX_PTR data,
+                     OMX_U32 size)
+{
+    if (index > 1)
+        return OMX_ErrorBadPortIndex;
+
+    *buffer_header = buffer_new (get_mock (handle), index, data, size, NULL);
+
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+comp_FreeBuffer (OMX_HANDLETYPE handle,
+                 OMX_U32 index,
+                 OMX_BUFFERHEADERTYPE *buffer_header)
+{
+    MockComponent *mock = get_mock (handle);
+
+    if (index > 1)
+        return OMX_ErrorBadPortIndex;
+
+    g_mutex_lock (mock->mutex);
+    mock->ports[index].allocated--;
+    /* the client takes back the memory of what it never got back: */
+    if (index == 0 && g_queue_find (mock->ports[0].queue, buffer_header))
+    {
+        g_queue_remove (mock->ports[0].queue, buffer_header);
+        reading_remove (buffer_header);
+    }
+    g_mutex_unlock (mock->mutex);
+
+    free (buffer_header);
+
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+queue_buffer (MockComponent *mock,
+              OMX_U32 index,
+              OMX_BUFFERHEADERTYPE *buffer_header)
+{
+    OMX_ERRORTYPE ret = OMX_ErrorNone;
+
+    g_mutex_lock (mock->mutex);
+
+    if (mock->failed)
+    {
+        ret = OMX_ErrorHardware;
+    }
+    else if (mock->state != OMX_StateExecuting && mock->state != OMX_StatePause &&
+             mock->state != OMX_StateIdle)
+    {
+        ret = OMX_ErrorIncorrectStateOperation;
+    }
+    else
+    {
+        if (index == 0)
+            reading_add (buffer_header);
+        g_queue_push_tail (mock->ports[index].queue, buffer_header);
+        g_cond_broadcast (mock->cond);
+    }
+
+    g_mutex_unlock (mock->mutex);
+
+    return ret;
+}
+
+static OMX_ERRORTYPE
+comp_EmptyThisBuffer (OMX_HANDLETYPE handle,
+                      OMX_BUFFERHEADERTYPE *buffer_header)
+{
+    return queue_buffer (get_mock (handle), 0, buffer_header);
+}
+
+static OMX_ERRORTYPE
+comp_FillThisBuffer (OMX_HANDLETYPE handle,
+                     OMX_BUFFERHEADERTYPE *buffer_header)
+{
+    MockComponent *mock = get_mock (handle);
+
+    /* see NOTE ABOUT SHARED MEMORY: */
+    if (is_reading (buffer_header))
+    {
+        send_event (mock, OMX_EventError, OMX_ErrorIncorrectStateOperation, 1);
+        return OMX_ErrorIncorrectStateOperation;
+    }
+
+    /* not referenced any more, if it was: */
+    buffer_header->nFlags &= ~MOCK_BUFFERFLAG_READONLY;
+
+    return queue_buffer (mock, 1, buffer_header);
+}
+
+OMX_ERRORTYPE
+OMX_GetHandle (OMX_HANDLETYPE *handle,
+               OMX_STRING component_name,
+               OMX_PTR data,
+               OMX_CALLBACKTYPE *callbacks)
+{
+    OMX_COMPONENTTYPE *comp;
+    MockComponent *mock;
+
+    comp = calloc (1, sizeof (OMX_COMPONENTTYPE));
+    comp->nSize = sizeof (OMX_COMPONENTTYPE);
+    comp->nVersion.nVersion = 1;
+
+    comp->GetComponentVersion = comp_GetComponentVersion;
+    comp->GetState = comp_GetState;
+    comp->GetParameter = comp_GetParameter;
+    comp->SetParameter = comp_SetParameter;
+    comp->GetConfig = comp_GetConfig;
+    comp->SetConfig = comp_SetConfig;
+    comp->GetExtensionIndex = comp_GetExtensionIndex;
+    comp->SendCommand = comp_SendCommand;
+    comp->UseBuffer = comp_UseBuffer;
+    comp->AllocateBuffer = comp_AllocateBuffer;
+    comp->FreeBuffer = comp_FreeBuffer;
+    comp->EmptyThisBuffer = comp_EmptyThisBuffer;
+    comp->FillThisBuffer = comp_FillThisBuffer;
+
+    mock = calloc (1, sizeof (MockComponent));
+    mock->omx = comp;
+    mock->state = OMX_StateLoaded;
+    if (callbacks)
+        mock->callbacks = *callbacks;
+    mock->app_data = data;
+    mock->mutex = g_mutex_new ();
+    mock->cond = g_cond_new ();
+
+    if (strstr (component_name, "decoder"))
+        mock->kind = MOCK_DECODER;
+    else if (strstr (component_name, "encoder"))
+        mock->kind = MOCK_ENCODER;
+    else if (strstr (component_name, "camera"))
+        mock->kind = MOCK_CAMERA;
+    else if (strstr (component_name, "sink"))
+        mock->kind = MOCK_SINK;
+    else
+        mock->kind = MOCK_FILTER;
+
+    port_init (&mock->ports[0], 0, mock->kind);
+    port_init (&mock->ports[1], 1, mock->kind);
+
+    comp->pComponentPrivate = mock;
+
+    *handle = comp;
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE
+OMX_FreeHandle (OMX_HANDLETYPE handle)
+{
+    MockComponent *mock = get_mock (handle);
+
+    if (mock->thread)
+    {
+        g_mutex_lock (mock->mutex);
+        mock->quit = TRUE;
+        g_cond_broadcast (mock->cond);
+        g_mutex_unlock (mock->mutex);
+
+        g_thread_join (mock->thread);
+    }
+
+    tunnel_free (mock);
+
+    g_queue_free (mock->ports[0].queue);
+    g_queue_free (mock->ports[1].queue);
+    g_cond_free (mock->cond);
+    g_mutex_free (mock->mutex);
+    free (mock);
+    free (handle);
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE
+OMX_SetupTunnel (OMX_HANDLETYPE output,
+                 OMX_U32 output_index,
+                 OMX_HANDLETYPE input,
+                 OMX_U32 input_index)
+{
+    MockComponent *out = output ? get_mock (output) : NULL;
+    MockComponent *in = input ? get_mock (input) : NULL;
+
+    if ((out && output_index != 1) || (in && input_index != 0))
+        return OMX_ErrorBadPortIndex;
+
+    if (!is_loaded (out) || !is_loaded (in))
+        return OMX_ErrorIncorrectStateOperation;
+
+    G_LOCK (tunnel);
+
+    /* a NULL side tears down the tunnel of the other one, on both ends: */
+    if (out && out->ports[1].peer)
+        out->ports[1].peer->ports[0].peer = NULL;
+    if (in && in->ports[0].peer)
+        in->ports[0].peer->ports[1].peer = NULL;
+
+    if (out)
+    {
+        out->ports[1].tunneled = in != NULL;
+        out->ports[1].peer = in;
+    }
+
+    if (in)
+    {
+        in->ports[0].tunneled = out != NULL;
+        in->ports[0].peer = out;
+    }
+
+    G_UNLOCK (tunnel);
+
+    return OMX_ErrorNone;
+}
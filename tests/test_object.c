@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "test_object.h"
+
+typedef struct TestObject TestObject;
+typedef struct TestObjectClass TestObjectClass;
+
+struct TestObject
+{
+    GstObject parent;
+    gchar *library_name;
+    gchar *component_name;
+    gchar *component_role;
+};
+
+struct TestObjectClass
+{
+    GstObjectClass parent_class;
+};
+
+enum
+{
+    ARG_0,
+    ARG_COMPONENT_ROLE,
+    ARG_COMPONENT_NAME,
+    ARG_LIBRARY_NAME,
+};
+
+G_DEFINE_TYPE (TestObject, test_object, GST_TYPE_OBJECT);
+
+static gchar **
+get_string (TestObject *self,
+            guint prop_id)
+{
+    switch (prop_id)
+    {
+        case ARG_COMPONENT_ROLE:
+            return &self->component_role;
+        case ARG_COMPONENT_NAME:
+            return &self->component_name;
+        default:
+            return &self->library_name;
+    }
+}
+
+static void
+set_property (GObject *obj,
+              guint prop_id,
+              const GValue *value,
+              GParamSpec *pspec)
+{
+    gchar **str = get_string ((TestObject *) obj, prop_id);
+
+    g_free (*str);
+    *str = g_value_dup_string (value);
+}
+
+static void
+get_property (GObject *obj,
+              guint prop_id,
+              GValue *value,
+              GParamSpec *pspec)
+{
+    g_value_set_string (value, *get_string ((TestObject *) obj, prop_id));
+}
+
+static void
+finalize (GObject *obj)
+{
+    TestObject *self = (TestObject *) obj;
+
+    g_free (self->library_name);
+    g_free (self->component_name);
+    g_free (self->component_role);
+
+    G_OBJECT_CLASS (test_object_parent_class)->finalize (obj);
+}
+
+static void
+test_object_class_init (TestObjectClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+    gobject_class->set_property = set_property;
+    gobject_class->get_property = get_property;
+    gobject_class->finalize = finalize;
+
+    g_object_class_install_property (gobject_class, ARG_COMPONENT_ROLE,
+                                     g_param_spec_string ("component-role", "Component role",
+                                                          "Role of the OpenMAX IL component",
+                                                          NULL, G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, ARG_COMPONENT_NAME,
+                                     g_param_spec_string ("component-name", "Component name",
+                                                          "Name of the OpenMAX IL component to use",
+                                                          NULL, G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, ARG_LIBRARY_NAME,
+                                     g_param_spec_string ("library-name", "Library name",
+                                                          "Name of the OpenMAX IL implementation library to use",
+                                                          NULL, G_PARAM_READWRITE));
+}
+
+static void
+test_object_init (TestObject *self)
+{
+}
+
+GstObject *
+test_object_new (const gchar *name)
+{
+    GstObject *object;
+
+    object = g_object_new (test_object_get_type (), NULL);
+    gst_object_set_name (object, name);
+
+    return object;
+}
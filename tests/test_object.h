@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef TEST_OBJECT_H
+#define TEST_OBJECT_H
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/**
+ * A minimal object to drive a GOmxCore without any element around it,
+ * with the "library-name", "component-name" and "component-role"
+ * properties the core expects.  Shared by the programs of tests/ which use
+ * the port layer directly.
+ */
+GstObject * test_object_new (const gchar *name);
+
+G_END_DECLS
+
+#endif /* TEST_OBJECT_H */
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "resource_manager.h"
+
+/* NOTE ABOUT PRIORITIES:
+ *
+ * Waiters are served strictly in order: a request which fits is still held
+ * back while a request ahead of it (of higher, or same but older, priority)
+ * is waiting.  Otherwise a stream of small requests could starve a big
+ * one forever.
+ */
+
+static Resource *
+get_resource (ResourceManager *manager,
+              const gchar *name)
+{
+    Resource *resource;
+
+    resource = g_hash_table_lookup (manager->resources, name);
+
+    if (!resource)
+    {
+        resource = g_new0 (Resource, 1);
+        resource->name = g_strdup (name);
+        g_hash_table_insert (manager->resources, resource->name, resource);
+    }
+
+    return resource;
+}
+
+static void
+resource_free (Resource *resource)
+{
+    g_list_free (resource->waiters);
+    g_free (resource->name);
+    g_free (resource);
+}
+
+/* queue @session behind all the waiters of higher or same priority, see
+ * NOTE ABOUT PRIORITIES
+ */
+static GList *
+insert_waiter (GList *waiters,
+               ResourceSession *session)
+{
+    GList *l;
+
+    for (l = waiters; l; l = l->next)
+    {
+        const ResourceSession *waiter = l->data;
+
+        if (waiter->priority < session->priority)
+            break;
+    }
+
+    return g_list_insert_before (waiters, l, session);
+}
+
+static inline gboolean
+fits (Resource *resource,
+      guint64 cost)
+{
+    return resource->capacity == 0 || resource->used + cost <= resource->capacity;
+}
+
+ResourceManager *
+resource_manager_new (void)
+{
+    ResourceManager *manager;
+
+    manager = g_new0 (ResourceManager, 1);
+    manager->resources = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                NULL, (GDestroyNotify) resource_free);
+    manager->mutex = g_mutex_new ();
+    manager->condition = g_cond_new ();
+
+    return manager;
+}
+
+void
+resource_manager_free (ResourceManager *manager)
+{
+    g_hash_table_destroy (manager->resources);
+    g_mutex_free (manager->mutex);
+    g_cond_free (manager->condition);
+    g_free (manager);
+}
+
+void
+resource_manager_set_capacity (ResourceManager *manager,
+                               const gchar *name,
+                               guint64 capacity)
+{
+    g_mutex_lock (manager->mutex);
+    get_resource (manager, name)->capacity = capacity;
+    g_cond_broadcast (manager->condition);
+    g_mutex_unlock (manager->mutex);
+}
+
+/**
+ * Reserve @cost of resource @name.  If it is not available right away,
+ * wait up to @timeout ms for it (0 means don't wait).
+ *
+ * Returns the session to release once done, or NULL if the request was
+ * rejected.
+ */
+ResourceSession *
+resource_manager_acquire (ResourceManager *manager,
+                          const gchar *name,
+                          guint64 cost,
+                          gint priority,
+                          guint timeout)
+{
+    ResourceSession *session;
+    Resource *resource;
+    GTimeVal tv;
+
+    session = g_new0 (ResourceSession, 1);
+    session->cost = cost;
+    session->priority = priority;
+
+    g_mutex_lock (manager->mutex);
+
+    resource = get_resource (manager, name);
+    session->resource = resource;
+
+    /* could never fit: */
+    if (resource->capacity && cost > resource->capacity)
+        goto reject;
+
+    if (!resource->waiters && fits (resource, cost))
+        goto admit;
+
+    if (!timeout)
+        goto reject;
+
+    g_get_current_time (&tv);
+    g_time_val_add (&tv, (glong) timeout * 1000);
+
+    resource->waiters = insert_waiter (resource->waiters, session);
+
+    while (resource->waiters->data != session || !fits (resource, cost))
+    {
+        if (!g_cond_timed_wait (manager->condition, manager->mutex, &tv))
+        {
+            resource->waiters = g_list_remove (resource->waiters, session);
+            /* whoever was queued behind us might fit now: */
+            g_cond_broadcast (manager->condition);
+            goto reject;
+        }
+    }
+
+    resource->waiters = g_list_remove (resource->waiters, session);
+    g_cond_broadcast (manager->condition);
+
+admit:
+    resource->used += cost;
+    resource->sessions++;
+    g_mutex_unlock (manager->mutex);
+    return session;
+
+reject:
+    g_mutex_unlock (manager->mutex);
+    g_free (session);
+    return NULL;
+}
+
+void
+resource_manager_release (ResourceManager *manager,
+                          ResourceSession *session)
+{
+    Resource *resource = session->resource;
+
+    g_mutex_lock (manager->mutex);
+    resource->used -= session->cost;
+    resource->sessions--;
+    g_cond_broadcast (manager->condition);
+    g_mutex_unlock (manager->mutex);
+
+    g_free (session);
+}
+
+/**
+ * Returns how much of resource @name is in use, and optionally its
+ * capacity and number of sessions.
+ */
+guint64
+resource_manager_get_usage (ResourceManager *manager,
+                            const gchar *name,
+                            guint64 *capacity,
+                            guint *sessions)
+{
+    Resource *resource;
+    guint64 used;
+
+    g_mutex_lock (manager->mutex);
+
+    resource = get_resource (manager, name);
+    used = resource->used;
+
+    if (capacity)
+        *capacity = resource->capacity;
+    if (sessions)
+        *sessions = resource->sessions;
+
+    g_mutex_unlock (manager->mutex);
+
+    return used;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef RESOURCE_MANAGER_H
+#define RESOURCE_MANAGER_H
+
+#include <glib.h>
+
+typedef struct ResourceManager ResourceManager;
+typedef struct Resource Resource;
+typedef struct ResourceSession ResourceSession;
+
+/**
+ * Admission control for shared hardware.
+ *
+ * Each resource (ie. an OMX component name) has a capacity, in whatever
+ * unit its users agree on (macroblocks per second for video codecs), and
+ * sessions reserve part of it for as long as they run.  Requests which do
+ * not fit wait, highest priority first, until enough capacity is released
+ * or they time out.
+ */
+struct ResourceManager
+{
+    GHashTable *resources; /**< name -> Resource */
+    GMutex *mutex;
+    GCond *condition;
+};
+
+struct Resource
+{
+    gchar *name;
+    guint64 capacity;   /**< 0 means unlimited */
+    guint64 used;
+    guint sessions;
+    GList *waiters;     /**< queued requests, by decreasing priority, then arrival */
+};
+
+struct ResourceSession
+{
+    Resource *resource;
+    guint64 cost;
+    gint priority;
+};
+
+ResourceManager *resource_manager_new (void);
+void resource_manager_free (ResourceManager *manager);
+void resource_manager_set_capacity (ResourceManager *manager, const gchar *name, guint64 capacity);
+ResourceSession *resource_manager_acquire (ResourceManager *manager, const gchar *name, guint64 cost, gint priority, guint timeout);
+void resource_manager_release (ResourceManager *manager, ResourceSession *session);
+guint64 resource_manager_get_usage (ResourceManager *manager, const gchar *name, guint64 *capacity, guint *sessions);
+
+#endif /* RESOURCE_MANAGER_H */
@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <glib.h>
+
+#include "ring_queue.h"
+
+/* NOTE ABOUT CONCURRENCY:
+ *
+ * The OMX port queues are not strictly single producer / single consumer:
+ * buffers can be pushed from the component's callback thread(s) and from
+ * the streaming thread (g_omx_port_start_buffers), and popped from the
+ * streaming thread as well as from flush/free paths.  So this is a bounded
+ * multi-producer/multi-consumer ring where every slot carries a sequence
+ * number telling whether it is ready to be written or read for a given
+ * lap around the ring.
+ *
+ * Positions are free running counters; they are only compared through
+ * their (wrapping) difference.
+ */
+
+#define MIN_CAPACITY 2
+
+static guint
+round_capacity (guint capacity)
+{
+    guint n = MIN_CAPACITY;
+
+    while (n < capacity)
+        n <<= 1;
+
+    return n;
+}
+
+static void
+init_slots (RingQueue *queue,
+            guint capacity)
+{
+    guint i;
+
+    queue->capacity = round_capacity (capacity);
+    queue->mask = queue->capacity - 1;
+    queue->slots = g_new0 (RingQueueSlot, queue->capacity);
+
+    for (i = 0; i < queue->capacity; i++)
+        queue->slots[i].sequence = i;
+
+    queue->head = 0;
+    queue->tail = 0;
+}
+
+static gboolean
+try_push (RingQueue *queue,
+          gpointer data)
+{
+    RingQueueSlot *slot;
+    guint pos;
+
+    pos = g_atomic_int_get (&queue->tail);
+
+    while (TRUE)
+    {
+        gint diff;
+
+        slot = &queue->slots[pos & queue->mask];
+        diff = (gint) ((guint) g_atomic_int_get (&slot->sequence) - pos);
+
+        if (diff == 0)
+        {
+            if (g_atomic_int_compare_and_exchange (&queue->tail, pos, pos + 1))
+                break;
+        }
+        else if (diff < 0)
+        {
+            /* full */
+            return FALSE;
+        }
+
+        pos = g_atomic_int_get (&queue->tail);
+    }
+
+    slot->data = data;
+    g_atomic_int_set (&slot->sequence, pos + 1);
+
+    return TRUE;
+}
+
+static gpointer
+try_pop (RingQueue *queue)
+{
+    RingQueueSlot *slot;
+    gpointer data;
+    guint pos;
+
+    pos = g_atomic_int_get (&queue->head);
+
+    while (TRUE)
+    {
+        gint diff;
+
+        slot = &queue->slots[pos & queue->mask];
+        diff = (gint) ((guint) g_atomic_int_get (&slot->sequence) - (pos + 1));
+
+        if (diff == 0)
+        {
+            if (g_atomic_int_compare_and_exchange (&queue->head, pos, pos + 1))
+                break;
+        }
+        else if (diff < 0)
+        {
+            /* empty */
+            return NULL;
+        }
+
+        pos = g_atomic_int_get (&queue->head);
+    }
+
+    data = slot->data;
+    g_atomic_int_set (&slot->sequence, pos + queue->capacity);
+
+    return data;
+}
+
+RingQueue *
+ring_queue_new (guint capacity)
+{
+    RingQueue *queue;
+
+    queue = g_slice_new0 (RingQueue);
+
+    init_slots (queue, capacity);
+
+    queue->condition = g_cond_new ();
+    queue->mutex = g_mutex_new ();
+    queue->enabled = TRUE;
+
+    return queue;
+}
+
+void
+ring_queue_free (RingQueue *queue)
+{
+    g_cond_free (queue->condition);
+    g_mutex_free (queue->mutex);
+
+    g_free (queue->slots);
+    g_slice_free (RingQueue, queue);
+}
+
+/**
+ * Make sure the queue can hold at least @capacity elements.  This is the
+ * only operation that is not thread safe: it must only be called while
+ * nobody else is using the queue (ie. before the buffers are handed to the
+ * OMX component), and it fails if the queue is not empty.
+ */
+gboolean
+ring_queue_reserve (RingQueue *queue,
+                    guint capacity)
+{
+    if (capacity <= queue->capacity)
+        return TRUE;
+
+    if (ring_queue_length (queue) != 0)
+        return FALSE;
+
+    g_mutex_lock (queue->mutex);
+    g_free (queue->slots);
+    init_slots (queue, capacity);
+    g_mutex_unlock (queue->mutex);
+
+    return TRUE;
+}
+
+/**
+ * Push @data, waking up a consumer if one is waiting.  Returns FALSE if the
+ * queue is full: nobody would ever make room for @data if the caller kept
+ * trying from the thread the consumer is waiting for, so it is up to the
+ * caller to size the queue so that this never happens.
+ */
+gboolean
+ring_queue_push (RingQueue *queue,
+                 gpointer data)
+{
+    if (G_UNLIKELY (!try_push (queue, data)))
+        return FALSE;
+
+    /* only wake up if somebody is actually sleeping; the waiter registers
+     * itself before checking the queue a last time, so either it sees the
+     * element we just pushed, or we see it waiting */
+    if (g_atomic_int_get (&queue->waiters) > 0)
+    {
+        g_mutex_lock (queue->mutex);
+        g_cond_signal (queue->condition);
+        g_mutex_unlock (queue->mutex);
+    }
+
+    return TRUE;
+}
+
+gpointer
+ring_queue_pop_full (RingQueue *queue,
+                     gboolean wait,
+                     gboolean force)
+{
+    gpointer data;
+
+    if (!force && !g_atomic_int_get (&queue->enabled))
+    {
+        /* g_warning ("not enabled!"); */
+        return NULL;
+    }
+
+    data = try_pop (queue);
+
+    if (data || !wait)
+        return data;
+
+    g_mutex_lock (queue->mutex);
+
+    g_atomic_int_inc (&queue->waiters);
+
+    /* like AsyncQueue, only wait until the next disable, but don't return
+     * early on spurious wakeups or when another consumer was faster */
+    {
+        guint generation = queue->generation;
+
+        data = try_pop (queue);
+
+        while (!data && (force || queue->enabled) &&
+               generation == queue->generation)
+        {
+            g_cond_wait (queue->condition, queue->mutex);
+            data = try_pop (queue);
+        }
+    }
+
+    g_atomic_int_add (&queue->waiters, -1);
+
+    g_mutex_unlock (queue->mutex);
+
+    return data;
+}
+
+gpointer
+ring_queue_pop (RingQueue *queue)
+{
+    return ring_queue_pop_full (queue, TRUE, FALSE);
+}
+
+void
+ring_queue_disable (RingQueue *queue)
+{
+    g_mutex_lock (queue->mutex);
+    g_atomic_int_set (&queue->enabled, FALSE);
+    queue->generation++;
+    g_cond_broadcast (queue->condition);
+    g_mutex_unlock (queue->mutex);
+}
+
+void
+ring_queue_enable (RingQueue *queue)
+{
+    g_mutex_lock (queue->mutex);
+    g_atomic_int_set (&queue->enabled, TRUE);
+    g_mutex_unlock (queue->mutex);
+}
+
+void
+ring_queue_flush (RingQueue *queue)
+{
+    while (try_pop (queue))
+        ;
+}
+
+/**
+ * Check if @data is currently in the queue.  The answer is only meaningful
+ * if no other thread is pushing or popping at the same time.
+ */
+gboolean
+ring_queue_exist (RingQueue *queue,
+                  gpointer data)
+{
+    guint pos, tail;
+
+    tail = g_atomic_int_get (&queue->tail);
+
+    for (pos = g_atomic_int_get (&queue->head); pos != tail; pos++)
+    {
+        if (queue->slots[pos & queue->mask].data == data)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+guint
+ring_queue_length (RingQueue *queue)
+{
+    guint head, tail;
+
+    head = g_atomic_int_get (&queue->head);
+    tail = g_atomic_int_get (&queue->tail);
+
+    return tail - head;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2011 Texas Instruments, Inc - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef RING_QUEUE_H
+#define RING_QUEUE_H
+
+#include <glib.h>
+
+typedef struct RingQueue RingQueue;
+typedef struct RingQueueSlot RingQueueSlot;
+
+struct RingQueueSlot
+{
+    volatile gint sequence;
+    gpointer data;
+};
+
+/**
+ * Fixed capacity, allocation free replacement for AsyncQueue.
+ *
+ * Push and pop are lock-free; the mutex and condition are only used when
+ * a consumer has to sleep (and by the producer to wake it up), so in the
+ * common case where the queue is not empty no lock is taken at all.
+ */
+struct RingQueue
+{
+    RingQueueSlot *slots;
+    guint capacity;     /**< always a power of two */
+    guint mask;
+
+    volatile gint head; /**< position of the next pop */
+    volatile gint tail; /**< position of the next push */
+
+    volatile gint waiters; /**< consumers sleeping on condition */
+    volatile gint enabled;
+    guint generation;      /**< bumped on every disable, under mutex */
+
+    GMutex *mutex;
+    GCond *condition;
+};
+
+RingQueue *ring_queue_new (guint capacity);
+void ring_queue_free (RingQueue *queue);
+gboolean ring_queue_reserve (RingQueue *queue, guint capacity);
+gboolean ring_queue_push (RingQueue *queue, gpointer data);
+gpointer ring_queue_pop_full (RingQueue *queue, gboolean wait, gboolean force);
+gpointer ring_queue_pop (RingQueue *queue);
+void ring_queue_disable (RingQueue *queue);
+void ring_queue_enable (RingQueue *queue);
+void ring_queue_flush (RingQueue *queue);
+gboolean ring_queue_exist (RingQueue *queue, gpointer data);
+guint ring_queue_length (RingQueue *queue);
+
+#endif /* RING_QUEUE_H */